@@ -8,6 +8,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 #include <borealis.hpp>
 #include "Settings.hpp"
 #include "GameStreamClient.hpp"
@@ -30,6 +31,7 @@ class AddHostTab : public brls::Box
     static void startSearching();
     brls::Event<GSResult<std::vector<Host>>>::Subscription searchSubscription;
     uint64_t searchGeneration = 0;
+    std::vector<Host> searchHosts;
 
     bool searchBoxIpExists(const std::string& ip);
     
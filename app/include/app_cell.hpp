@@ -9,14 +9,21 @@
 
 #include <borealis.hpp>
 #include "GameStreamClient.hpp"
+#include "views/box_art_view.hpp"
 
 using namespace brls;
 
 class AppCell : public Box {
   public:
+    AppCell();
     AppCell(const Host& host, const AppInfo& app, int currentApp);
 
-    BRLS_BIND(Image, image, "image");
+    // Rebinds the cell to another app, used by the recycling app grid
+    void setApp(const Host& host, const AppInfo& app, int currentApp);
+    // Gets the art of a cell about to scroll in ready ahead of time
+    static void prefetchBoxArt(const Host& host, int appId);
+
+    BRLS_BIND(BoxArtView, image, "image");
     BRLS_BIND(Label, title, "title");
     BRLS_BIND(Image, currentAppImage, "current_app_image");
     BRLS_BIND(Image, favoriteAppImage, "favorite_app_image");
@@ -14,6 +14,7 @@
 #include <borealis.hpp>
 #include "GameStreamClient.hpp"
 
+#include <map>
 #include <optional>
 
 using namespace brls;
@@ -34,11 +35,25 @@ class AppListView : public Box {
     LoadingOverlay* loader = nullptr;
     void blockInput(bool block);
 
+    AppInfoList apps;
+    int currentGame = 0;
+
+    // What each cell showed after the last showApps(), by app id
+    struct ShownApp {
+        size_t index;
+        std::string name;
+        bool favorite;
+    };
+    std::map<int, ShownApp> shownApps;
+    void rememberShownApps();
+
     GridView* gridView;
     BRLS_BIND(Box, container, "container");
 
     void setCurrentApp(const AppInfo& app);
     void terninateApp();
     void updateAppList();
+    void sortApps(AppInfoList& apps, int currentGame);
+    void showApps(const AppInfoList& sortedApps, int currentGame);
     void updateFavoriteAction(AppCell* cell, Host host, const AppInfo& app);
 };
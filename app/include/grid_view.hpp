@@ -8,14 +8,30 @@
 #pragma once
 
 #include <borealis.hpp>
+#include <functional>
 
 using namespace brls;
 
 class GridView : public Box {
   public:
+    using CellFactory = std::function<View*()>;
+    using CellBinder = std::function<void(View* cell, size_t index)>;
+    using Prefetcher = std::function<void(size_t index)>;
+
     GridView();
     GridView(int columns);
 
+    // Virtualized mode: only the rows on screen plus a margin get cells,
+    // which are rebound to other items while scrolling. The prefetcher is
+    // called for items of the rows about to appear.
+    void setItems(size_t count, float cellHeight, CellFactory factory,
+                  CellBinder binder, Prefetcher prefetcher = nullptr);
+    // Changes the item count and rebinds only the listed items that are on
+    // screen, keeping cells, focus and scroll position
+    void updateItems(size_t count, const std::vector<size_t>& changed);
+    void draw(NVGcontext* vg, float x, float y, float width, float height,
+              Style style, FrameContext* ctx) override;
+
     void addView(View* view) override;
     void clearViews(bool free = true) override;
     View* getParentNavigationDecision(View* from, View* newFocus,
@@ -26,8 +42,28 @@ class GridView : public Box {
     int getItemsInRow(int row);
 
   private:
+    Box* createRow();
+    size_t poolSize();
+    void bindRow(Box* row, size_t rowIndex);
+    void updateSpacers();
+    void scrollRowsTo(size_t firstRow);
+    void prefetchAround();
+    bool containsFocus(View* view);
+    size_t countItems();
+
     int columls = 1;
     Box* lastContainer = nullptr;
     View* lastView = nullptr;
     std::vector<View*> children;
+
+    size_t itemCount = 0;
+    size_t totalRows = 0;
+    size_t firstRow = 0;
+    float rowHeight = 0;
+    std::vector<Box*> rows;
+    Box* topSpacer = nullptr;
+    Box* bottomSpacer = nullptr;
+    CellFactory factory;
+    CellBinder binder;
+    Prefetcher prefetcher;
 };
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <HostMonitor.hpp>
 #include <Settings.hpp>
 #include <borealis.hpp>
 #include <cstdint>
@@ -16,6 +17,7 @@ enum HostState { FETCHING, AVAILABLE, UNAVAILABLE };
 class HostTab : public brls::Box {
   public:
     HostTab(const Host& host);
+    ~HostTab() override;
     void reloadHost();
 
     BRLS_BIND(brls::DetailCell, connect, "connect");
@@ -23,8 +25,11 @@ class HostTab : public brls::Box {
     BRLS_BIND(brls::Header, header, "header");
 
   private:
+    void applyStatus(HostStatus status);
+
     Host host;
     HostState state = HostState::FETCHING;
     uint64_t wakeRequestGeneration = 0;
     uint64_t canceledWakeRequestGeneration = 0;
+    brls::Event<HostStatusUpdate>::Subscription statusSubscription;
 };
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <borealis.hpp>
+#include <cstdint>
 #include <map>
 
 enum KeyboardKeys
@@ -29,9 +30,16 @@ struct KeyboardLocale {
     std::map<KeyboardKeys, KeyboardKeys> keyMapper;
 };
 
+// One bit per KeyboardKeys, so states compare a word at a time
 struct KeyboardState {
-    bool keys[_VK_KEY_MAX];
-    KeyboardState() = default;
+    static constexpr int WORDS = (_VK_KEY_MAX + 63) / 64;
+    uint64_t words[WORDS] = {};
+
+    bool pressed(int key) const { return (words[key / 64] >> (key % 64)) & 1; }
+    void set(int key, bool pressed) {
+        const uint64_t bit = uint64_t(1) << (key % 64);
+        pressed ? (words[key / 64] |= bit) : (words[key / 64] &= ~bit);
+    }
 };
 
 class KeyboardView;
@@ -59,17 +67,28 @@ class ButtonView : public brls::Box {
     bool focusJustGained = false;
 
     void applyTitle();
-    KeyboardLocale getCurrentLocale();
+    const KeyboardLocale& getCurrentLocale();
     KeyboardView* keyboardView;
+    // Locale and shift state the label shows, the text is only replaced
+    // when they change
+    int titleLocale = -1;
+    bool titleShifted = false;
 };
 
 class KeyboardView : public brls::Box {
   public:
+    enum Layout { ENGLISH_LAYOUT, NUMPAD_LAYOUT, FULL_LAYOUT, _LAYOUT_MAX };
+
     inline static brls::VoidEvent shiftUpdated;
-    inline static std::vector<KeyboardLocale> getLocales() { return locales; }
+    inline static const std::vector<KeyboardLocale>& getLocales() { return locales; }
 
     explicit KeyboardView(bool focusable);
     ~KeyboardView() override;
+
+    // Keyboards are built once per keyboard type and kept detached between
+    // uses, hand them back with release() instead of deleting them
+    static KeyboardView* acquire(bool focusable);
+    static void release(KeyboardView* keyboard);
     KeyboardState getKeyboardState();
     short getKeyCode(KeyboardKeys key);
 
@@ -81,12 +100,18 @@ class KeyboardView : public brls::Box {
   private:
     int keyboardLangLock = -1;
     bool needFocus = false;
-    void createEnglishLayout();
-    void createNumpadLayout();
-    void createFullLayout();
+    Layout baseLayout = ENGLISH_LAYOUT;
+    Layout currentLayout = _LAYOUT_MAX;
+    // Built on first use, only the current one is attached
+    brls::Box* layouts[_LAYOUT_MAX] = {};
+    void showLayout(Layout layout);
+    void createEnglishLayout(brls::Box* layout);
+    void createNumpadLayout(brls::Box* layout);
+    void createFullLayout(brls::Box* layout);
     static void changeLang(int lang);
     void createLocales();
     inline static std::vector<KeyboardLocale> locales;
+    inline static std::map<std::pair<int, bool>, KeyboardView*> pool;
 
     friend class ButtonView;
 };
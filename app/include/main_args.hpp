@@ -8,9 +8,14 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
 
 void registerDeepLinkHandler();
 
 bool startFromArgs(int argc, char** argv);
 bool startFromUrl(const std::string& url, bool resetActivityStack = true);
+
+// --record-input=<file> records the session input, --replay-input=<file>
+// replays a recording and yields the exit code to quit with
+std::optional<int> runInputHarnessFromArgs(int argc, char** argv);
@@ -14,6 +14,7 @@
 class StreamingInputOverlay : public brls::Box {
   public:
     StreamingInputOverlay(StreamingView* streamView);
+    ~StreamingInputOverlay() override;
 
     void show();
 
@@ -26,6 +27,8 @@ class StreamingInputOverlay : public brls::Box {
   private:
     StreamingView* streamView;
     KeyboardView* keyboard = nullptr;
+    // On-screen keyboard keys as last sent to the host
+    KeyboardState sentKeyboardState;
     bool isKeyboardOpen = false;
     bool hideHints = false;
 
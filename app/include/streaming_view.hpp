@@ -43,11 +43,13 @@ class StreamingView : public brls::Box {
     LoadingOverlay* loader = nullptr;
     Box* keyboardHolder = nullptr;
     KeyboardView* keyboard = nullptr;
+    // On-screen keyboard keys as last sent to the host
+    KeyboardState sentKeyboardState;
     bool blocked = false;
     bool terminated = false;
     bool tempInputLock = false;
     brls::Event<brls::KeyState>::Subscription keysSubscription;
-    int touchScrollCounter = 0;
+    float touchScrollOffset = 0;
     size_t bottombarDelayTask = -1;
     bool m_use_hdr = false;
     TwoFingerScrollGestureRecognizer* scrollTouchRecognizer = nullptr;
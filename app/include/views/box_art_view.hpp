@@ -0,0 +1,30 @@
+//
+//  box_art_view.hpp
+//  Moonlight
+//
+
+#pragma once
+
+#include <Settings.hpp>
+#include <borealis.hpp>
+
+// Draws an app's box art from its tile in the BoxArtManager atlas, so a grid
+// of cells shares a few textures. Decoding happens off the UI thread,
+// uploads are spread across frames.
+class BoxArtView : public brls::View {
+  public:
+    BoxArtView();
+
+    void setApp(const Host& host, int appId);
+    void setImageCornerRadius(float radius);
+
+    void draw(NVGcontext* vg, float x, float y, float width, float height,
+              brls::Style style, brls::FrameContext* ctx) override;
+
+    static brls::View* create();
+
+  private:
+    Host host;
+    int appId = -1;
+    float imageCornerRadius = 12;
+};
@@ -3,10 +3,35 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <algorithm>
+#include <mutex>
 
 std::vector<Host> foundHosts;
+std::mutex foundHostsMutex;
 std::function<void(void)> _callback;
 
+static void merge_found_host(const Host& host) {
+    std::lock_guard<std::mutex> lock(foundHostsMutex);
+    auto it = std::find_if(foundHosts.begin(), foundHosts.end(), [host](const Host& existing) {
+        return hosts_match(existing, host);
+    });
+    if (it == foundHosts.end()) {
+        foundHosts.push_back(host);
+    } else {
+        if (!host.address.empty()) {
+            it->address = host.address;
+        }
+        if (!host.remoteAddress.empty()) {
+            it->remoteAddress = host.remoteAddress;
+        }
+        if (!host.hostname.empty()) {
+            it->hostname = host.hostname;
+        }
+        if (!host.mac.empty()) {
+            it->mac = host.mac;
+        }
+    }
+}
+
 @interface MDNSManager : NSObject <NSNetServiceBrowserDelegate, NSNetServiceDelegate>
 
 - (id) init;
@@ -211,29 +236,25 @@ static NSString* NV_SERVICE_TYPE = @"_nvstream._tcp";
         auto hostName = [service.hostName stringByReplacingOccurrencesOfString:@".local." withString:@""];
 
         host.address = std::string([hostAddress UTF8String]);
-        host.remoteAddress = GameStreamClient::external_address_for_mdns(host.address);
+        host.remoteAddress = GameStreamClient::cached_external_address_for_mdns(host.address);
         host.hostname = std::string([hostName UTF8String]);
-        auto it = std::find_if(foundHosts.begin(), foundHosts.end(), [host](const Host& existing) {
-            return hosts_match(existing, host);
-        });
-        if (it == foundHosts.end()) {
-            foundHosts.push_back(host);
-        } else {
-            if (!host.address.empty()) {
-                it->address = host.address;
-            }
-            if (!host.remoteAddress.empty()) {
-                it->remoteAddress = host.remoteAddress;
-            }
-            if (!host.hostname.empty()) {
-                it->hostname = host.hostname;
-            }
-            if (!host.mac.empty()) {
-                it->mac = host.mac;
-            }
-        }
-
+        merge_found_host(host);
         _callback();
+
+        // Show the host right away, WAN address arrives later
+        if (host.remoteAddress.empty()) {
+            GameStreamClient::resolve_external_address_for_mdns(
+                host.address, [host](const std::string& remoteAddress) {
+                    if (remoteAddress.empty()) {
+                        return;
+                    }
+
+                    Host resolvedHost = host;
+                    resolvedHost.remoteAddress = remoteAddress;
+                    merge_found_host(resolvedHost);
+                    _callback();
+                });
+        }
     });
 }
 
@@ -319,8 +340,14 @@ void *get_in_addr(struct sockaddr *sa) {
 
 void darwin_mdns_start(ServerCallback<std::vector<Host>>& callback) {
     _callback = [callback]() {
-        brls::sync([callback] {
-            callback(GSResult<std::vector<Host>>::success(foundHosts));
+        std::vector<Host> hostsSnapshot;
+        {
+            std::lock_guard<std::mutex> lock(foundHostsMutex);
+            hostsSnapshot = foundHosts;
+        }
+
+        brls::sync([callback, hostsSnapshot] {
+            callback(GSResult<std::vector<Host>>::success(hostsSnapshot));
         });
     };
     [mDNSManager searchForHosts];
@@ -329,5 +356,6 @@ void darwin_mdns_start(ServerCallback<std::vector<Host>>& callback) {
 void darwin_mdns_stop() {
     [mDNSManager stopSearching];
     [mDNSManager forgetHosts];
+    std::lock_guard<std::mutex> lock(foundHostsMutex);
     foundHosts.clear();
 }
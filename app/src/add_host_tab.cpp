@@ -9,6 +9,7 @@
 #include "DiscoverManager.hpp"
 #include "helper.hpp"
 #include "main_tabs_view.hpp"
+#include <algorithm>
 
 #if defined(_WIN32)
 #include <winsock2.h>
@@ -117,7 +118,22 @@ void AddHostTab::fillSearchBox(const GSResult<std::vector<Host>>& hostsRes) {
 void AddHostTab::appendSearchHosts(const std::vector<Host>& hosts) {
     for (const Host& host : hosts) {
         const auto displayAddress = host.preferred_address();
-        if (displayAddress.empty() || searchBoxIpExists(displayAddress))
+        if (displayAddress.empty())
+            continue;
+
+        // Discovery re-publishes hosts once their WAN address is resolved
+        auto found = std::find_if(searchHosts.begin(), searchHosts.end(),
+                                  [displayAddress](const Host& existing) {
+                                      return existing.preferred_address() ==
+                                             displayAddress;
+                                  });
+        if (found != searchHosts.end()) {
+            *found = host;
+        } else {
+            searchHosts.push_back(host);
+        }
+
+        if (searchBoxIpExists(displayAddress))
             continue;
 
         auto hostButton = new brls::DetailCell();
@@ -125,8 +141,15 @@ void AddHostTab::appendSearchHosts(const std::vector<Host>& hosts) {
         hostButton->setDetailText(displayAddress);
         hostButton->setDetailTextColor(
             brls::Application::getTheme()["brls/text_disabled"]);
-        hostButton->registerClickAction([this, host](View* view) {
-            connectHost(host);
+        hostButton->registerClickAction([this, displayAddress](View* view) {
+            auto found = std::find_if(
+                searchHosts.begin(), searchHosts.end(),
+                [displayAddress](const Host& existing) {
+                    return existing.preferred_address() == displayAddress;
+                });
+            if (found != searchHosts.end()) {
+                connectHost(*found);
+            }
             return true;
         });
         searchBox->addView(hostButton);
@@ -153,6 +176,7 @@ void AddHostTab::findHost() {
     stopSearchHost();
     const uint64_t generation = searchGeneration;
     searchBox->clearViews();
+    searchHosts.clear();
     searchHeader->setTitle("add_host/search"_i18n);
     loader->setVisibility(brls::Visibility::VISIBLE);
     ASYNC_RETAIN
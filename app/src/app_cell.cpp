@@ -9,13 +9,31 @@
 #include "BoxArtManager.hpp"
 #include "Settings.hpp"
 #include "streaming_view.hpp"
+#include <set>
 
-AppCell::AppCell(const Host& host, const AppInfo& app, int currentApp) {
+namespace {
+// Downloads already running, scrolling back and forth must not repeat them
+std::set<std::string> boxArtDownloads;
+
+std::string boxArtDownloadKey(const Host& host, int appId) {
+    return host.preferred_address() + "/" + std::to_string(appId);
+}
+}
+
+AppCell::AppCell() {
     this->inflateFromXMLRes("xml/cells/app_cell.xml");
     this->setFavorite(false);
+    title->setTextColor(nvgRGB(255, 255, 255));
+    this->addGestureRecognizer(new TapGestureRecognizer(this));
+}
+
+AppCell::AppCell(const Host& host, const AppInfo& app, int currentApp)
+    : AppCell() {
+    setApp(host, app, currentApp);
+}
 
+void AppCell::setApp(const Host& host, const AppInfo& app, int currentApp) {
     title->setText(app.name);
-    title->setTextColor(nvgRGB(255, 255, 255));
 
     bool isUnactive = currentApp != 0 && currentApp != app.app_id;
     unactiveLayer->setVisibility(isUnactive ? Visibility::VISIBLE
@@ -23,7 +41,6 @@ AppCell::AppCell(const Host& host, const AppInfo& app, int currentApp) {
     currentAppImage->setVisibility(
         currentApp == app.app_id ? Visibility::VISIBLE : Visibility::GONE);
 
-    this->addGestureRecognizer(new TapGestureRecognizer(this));
     this->registerClickAction([host, app](View* view) {
         auto* frame = new AppletFrame(new StreamingView(host, app));
         frame->setBackground(ViewBackground::NONE);
@@ -34,23 +51,30 @@ AppCell::AppCell(const Host& host, const AppInfo& app, int currentApp) {
     });
     this->setActionAvailable(BUTTON_A, !isUnactive);
 
-    if (BoxArtManager::instance().has_boxart(app.app_id))
-        image->setImageFromFile(
-            BoxArtManager::get_texture_path(app.app_id));
-    else {
-        ASYNC_RETAIN
-        GameStreamClient::instance().app_boxart(
-            host, app.app_id, [ASYNC_TOKEN, host, app](auto result) {
-                ASYNC_RELEASE
-
-                if (result.isSuccess()) {
-                    BoxArtManager::instance().set_data(result.value(),
-                                                       app.app_id);
-                    image->setImageFromFile(
-                        BoxArtManager::get_texture_path(app.app_id));
-                }
-            });
+    image->setApp(host, app.app_id);
+    prefetchBoxArt(host, app.app_id);
+}
+
+void AppCell::prefetchBoxArt(const Host& host, int appId) {
+    if (BoxArtManager::instance().has_boxart(host, appId)) {
+        BoxArtManager::instance().request_texture(host, appId);
+        return;
     }
+
+    const auto key = boxArtDownloadKey(host, appId);
+    if (!boxArtDownloads.insert(key).second)
+        return;
+
+    GameStreamClient::instance().app_boxart(
+        host, appId, [host, appId, key](auto result) {
+            boxArtDownloads.erase(key);
+
+            // Decoded on the box art workers, the view picks it up
+            if (result.isSuccess()) {
+                BoxArtManager::instance().set_data(host, appId,
+                                                   result.value());
+            }
+        });
 }
 
 void AppCell::setFavorite(bool favorite) {
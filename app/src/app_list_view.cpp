@@ -6,6 +6,8 @@
 //
 
 #include "app_list_view.hpp"
+#include "BoxArtManager.hpp"
+#include "HostStateCache.hpp"
 #include "helper.hpp"
 #include "main_tabs_view.hpp"
 
@@ -116,18 +118,32 @@ void AppListView::updateAppList() {
 
     loading = true;
 
-    gridView->clearViews();
-    Application::giveFocus(this);
-    loader->setHidden(false);
-    currentApp = std::nullopt;
-    hintView->setVisibility(Visibility::GONE);
-    blockInput(true);
+    // A reload keeps the displayed cells and only updates what changed
+    if (gridView->getChildren().empty()) {
+        Application::giveFocus(this);
+        loader->setHidden(false);
+        currentApp = std::nullopt;
+        hintView->setVisibility(Visibility::GONE);
+        blockInput(true);
 
-    getAppletFrameItem()->title = host.hostname;
-    updateAppletFrameItem();
+        getAppletFrameItem()->title = host.hostname;
+        updateAppletFrameItem();
+
+        // The last known list shows right away, live data is diffed into it.
+        // Input stays blocked, nothing can be launched before connecting.
+        HostSnapshot snapshot;
+        if (HostStateCache::instance().load(host, snapshot) &&
+            snapshot.has_apps && !snapshot.apps.empty()) {
+            const int cachedGame =
+                snapshot.has_server ? snapshot.server.currentGame : 0;
+            sortApps(snapshot.apps, cachedGame);
+            showApps(snapshot.apps, cachedGame);
+            loader->setHidden(true);
+        }
+    }
 
     ASYNC_RETAIN
-    GameStreamClient::instance().connect(
+    GameStreamClient::instance().connect_cached(
         host, [ASYNC_TOKEN](const GSResult<SERVER_DATA>& result) {
             ASYNC_RELEASE
 
@@ -145,35 +161,14 @@ void AppListView::updateAppList() {
                         blockInput(false);
 
                         if (result.isSuccess()) {
+                            std::set<int> appIds;
+                            for (const AppInfo& app : result.value())
+                                appIds.insert(app.app_id);
+                            BoxArtManager::instance().retain_apps(host, appIds);
+
                             AppInfoList sortedApps = result.value();
-                            std::sort(
-                                sortedApps.begin(), sortedApps.end(),
-                                [this, currentGame](const AppInfo& l, const AppInfo& r) {
-                                    int lScore = 0;
-                                    int rScore = 0;
-
-                                    if (l.app_id == currentGame) lScore+=2;
-                                    if (Settings::instance().is_favorite(this->host, l.app_id)) lScore+=1;
-
-                                    if (r.app_id == currentGame) rScore+=2;
-                                    if (Settings::instance().is_favorite(this->host, r.app_id)) rScore+=1;
-
-                                    return lScore > rScore;
-                                });
-
-                            for (const AppInfo& app : sortedApps) {
-                                if (app.app_id == currentGame)
-                                    setCurrentApp(app);
-
-                                auto* cell =
-                                    new AppCell(host, app, currentGame);
-                                cell->setFavorite(
-                                    Settings::instance().is_favorite(
-                                        host, app.app_id));
-                                gridView->addView(cell);
-                                this->updateFavoriteAction(cell, host, app);
-                            }
-                            Application::giveFocus(this);
+                            sortApps(sortedApps, currentGame);
+                            showApps(sortedApps, currentGame);
                         } else {
                             showError(result.error(),
                                       [this] { this->dismiss(); });
@@ -186,6 +181,93 @@ void AppListView::updateAppList() {
         });
 }
 
+void AppListView::sortApps(AppInfoList& apps, int currentGame) {
+    std::stable_sort(
+        apps.begin(), apps.end(),
+        [this, currentGame](const AppInfo& l, const AppInfo& r) {
+            int lScore = 0;
+            int rScore = 0;
+
+            if (l.app_id == currentGame) lScore+=2;
+            if (Settings::instance().is_favorite(this->host, l.app_id)) lScore+=1;
+
+            if (r.app_id == currentGame) rScore+=2;
+            if (Settings::instance().is_favorite(this->host, r.app_id)) rScore+=1;
+
+            return lScore > rScore;
+        });
+}
+
+void AppListView::showApps(const AppInfoList& sortedApps, int currentGame) {
+    currentApp = std::nullopt;
+    for (const AppInfo& app : sortedApps) {
+        if (app.app_id == currentGame)
+            setCurrentApp(app);
+    }
+
+    if (!currentApp.has_value()) {
+        hintView->setVisibility(Visibility::GONE);
+        getAppletFrameItem()->title = host.hostname;
+        updateAppletFrameItem();
+    }
+
+    if (!gridView->getChildren().empty()) {
+        // Every cell shows the running app state, otherwise only cells whose
+        // app moved, got renamed or (un)starred need rebinding
+        std::vector<size_t> changed;
+        const bool currentGameChanged = currentGame != this->currentGame;
+        for (size_t i = 0; i < sortedApps.size(); i++) {
+            const AppInfo& app = sortedApps[i];
+            auto shown = shownApps.find(app.app_id);
+            if (currentGameChanged || shown == shownApps.end() ||
+                shown->second.index != i || shown->second.name != app.name ||
+                shown->second.favorite !=
+                    Settings::instance().is_favorite(host, app.app_id))
+                changed.push_back(i);
+        }
+
+        const bool countChanged = apps.size() != sortedApps.size();
+        this->apps = sortedApps;
+        this->currentGame = currentGame;
+        rememberShownApps();
+
+        brls::Logger::debug("AppListView: {} of {} apps changed",
+                            changed.size(), apps.size());
+        if (!changed.empty() || countChanged)
+            gridView->updateItems(apps.size(), changed);
+        return;
+    }
+
+    this->apps = sortedApps;
+    this->currentGame = currentGame;
+    rememberShownApps();
+
+    // Only the cells on screen exist, they get rebound while scrolling
+    gridView->setItems(
+        apps.size(), 200, [] { return new AppCell(); },
+        [this](View* view, size_t index) {
+            auto* cell = (AppCell*)view;
+            const AppInfo& app = apps[index];
+            cell->setApp(host, app, this->currentGame);
+            cell->setFavorite(
+                Settings::instance().is_favorite(host, app.app_id));
+            this->updateFavoriteAction(cell, host, app);
+        },
+        [this](size_t index) {
+            AppCell::prefetchBoxArt(host, apps[index].app_id);
+        });
+    Application::giveFocus(this);
+}
+
+void AppListView::rememberShownApps() {
+    shownApps.clear();
+    for (size_t i = 0; i < apps.size(); i++) {
+        shownApps[apps[i].app_id] = {
+            i, apps[i].name,
+            Settings::instance().is_favorite(host, apps[i].app_id)};
+    }
+}
+
 void AppListView::setCurrentApp(const AppInfo& app) {
     this->currentApp = app;
     hintView->setVisibility(Visibility::VISIBLE);
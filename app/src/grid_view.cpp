@@ -6,6 +6,16 @@
 //
 
 #include "grid_view.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float CELL_SPACING = 12;
+// Rows kept above and below the screen, focus never reaches the edge
+constexpr size_t ROW_MARGIN = 2;
+// Rows past the kept ones whose items get prefetched
+constexpr size_t PREFETCH_ROWS = 2;
+}
 
 GridView::GridView() : Box(Axis::COLUMN), columls(7) {}
 
@@ -31,6 +41,228 @@ void GridView::clearViews(bool free) {
     children.clear();
     lastContainer = nullptr;
     lastView = nullptr;
+
+    itemCount = 0;
+    totalRows = 0;
+    firstRow = 0;
+    rows.clear();
+    topSpacer = nullptr;
+    bottomSpacer = nullptr;
+    factory = nullptr;
+    binder = nullptr;
+    prefetcher = nullptr;
+}
+
+void GridView::setItems(size_t count, float cellHeight, CellFactory factory,
+                        CellBinder binder, Prefetcher prefetcher) {
+    clearViews();
+
+    itemCount = count;
+    totalRows = (count + columls - 1) / columls;
+    rowHeight = cellHeight + CELL_SPACING;
+    this->factory = std::move(factory);
+    this->binder = std::move(binder);
+    this->prefetcher = std::move(prefetcher);
+
+    topSpacer = new Box(Axis::ROW);
+    Box::addView(topSpacer);
+
+    const size_t pooledRows = poolSize();
+    for (size_t row = 0; row < pooledRows; row++) {
+        Box* container = createRow();
+        Box::addView(container);
+        rows.push_back(container);
+        bindRow(container, row);
+    }
+
+    bottomSpacer = new Box(Axis::ROW);
+    Box::addView(bottomSpacer);
+    updateSpacers();
+    prefetchAround();
+}
+
+void GridView::updateItems(size_t count, const std::vector<size_t>& changed) {
+    if (!topSpacer)
+        return;
+
+    const size_t oldCount = itemCount;
+    const size_t oldFirstRow = firstRow;
+    itemCount = count;
+    totalRows = (count + columls - 1) / columls;
+
+    const size_t pooledRows = poolSize();
+    bool rowsChanged = false;
+    while (rows.size() < pooledRows) {
+        Box* container = createRow();
+        Box::addView(container, rows.size() + 1);
+        rows.push_back(container);
+        rowsChanged = true;
+    }
+    while (rows.size() > pooledRows) {
+        Box* row = rows.back();
+        // An empty grid has nothing left to focus
+        if (containsFocus(row))
+            Application::giveFocus(itemCount > 0 || !hasParent() ? this : getParent());
+        for (View* cell : row->getChildren())
+            children.erase(std::find(children.begin(), children.end(), cell));
+        rows.pop_back();
+        Box::removeView(row);
+    }
+    firstRow = std::min(firstRow, totalRows - rows.size());
+
+    if (firstRow != oldFirstRow || rowsChanged) {
+        for (size_t row = 0; row < rows.size(); row++)
+            bindRow(rows[row], firstRow + row);
+    } else {
+        // Cells past the shorter list only change visibility
+        std::vector<size_t> indices = changed;
+        for (size_t index = std::min(oldCount, count);
+             index < std::max(oldCount, count); index++)
+            indices.push_back(index);
+
+        for (size_t index : indices) {
+            const size_t row = index / columls;
+            if (row < firstRow || row >= firstRow + rows.size())
+                continue;
+
+            View* cell = rows[row - firstRow]->getChildren()[index % columls];
+            if (index < itemCount) {
+                cell->setVisibility(Visibility::VISIBLE);
+                binder(cell, index);
+            } else {
+                cell->setVisibility(Visibility::GONE);
+            }
+        }
+    }
+
+    // The focused cell may be gone now, it can only be in the last row
+    View* focus = Application::getCurrentFocus();
+    if (itemCount > 0 && focus && containsFocus(this) &&
+        focus->getVisibility() != Visibility::VISIBLE) {
+        const size_t lastRow = (itemCount - 1) / columls;
+        Application::giveFocus(
+            rows[lastRow - firstRow]->getChildren()[(itemCount - 1) % columls]);
+    }
+
+    updateSpacers();
+    prefetchAround();
+}
+
+Box* GridView::createRow() {
+    auto* container = new Box(Axis::ROW);
+    container->setHeight(rowHeight);
+    container->setPaddingBottom(CELL_SPACING);
+
+    for (int column = 0; column < columls; column++) {
+        View* cell = factory();
+        if (column + 1 < columls)
+            cell->setMarginRight(CELL_SPACING);
+        container->addView(cell);
+        children.push_back(cell);
+    }
+    return container;
+}
+
+size_t GridView::poolSize() {
+    const auto visibleRows =
+        size_t(std::ceil(Application::contentHeight / rowHeight)) + 1;
+    return std::min(totalRows, visibleRows + 2 * ROW_MARGIN);
+}
+
+void GridView::bindRow(Box* row, size_t rowIndex) {
+    auto& cells = row->getChildren();
+    for (size_t column = 0; column < cells.size(); column++) {
+        const size_t index = rowIndex * columls + column;
+        if (index < itemCount) {
+            cells[column]->setVisibility(Visibility::VISIBLE);
+            binder(cells[column], index);
+        } else {
+            cells[column]->setVisibility(Visibility::GONE);
+        }
+    }
+}
+
+void GridView::updateSpacers() {
+    topSpacer->setHeight(float(firstRow) * rowHeight);
+    bottomSpacer->setHeight(float(totalRows - firstRow - rows.size()) *
+                            rowHeight);
+}
+
+bool GridView::containsFocus(View* view) {
+    for (View* focus = Application::getCurrentFocus(); focus;
+         focus = focus->hasParent() ? focus->getParent() : nullptr) {
+        if (focus == view)
+            return true;
+    }
+    return false;
+}
+
+void GridView::scrollRowsTo(size_t newFirstRow) {
+    // Rows move from one edge to the other and get rebound, the others
+    // keep their cells (and the focus) untouched
+    while (firstRow < newFirstRow) {
+        Box* row = rows.front();
+        if (containsFocus(row))
+            break;
+
+        rows.erase(rows.begin());
+        Box::removeView(row, false);
+        Box::addView(row, rows.size() + 1);
+        rows.push_back(row);
+        firstRow++;
+        bindRow(row, firstRow + rows.size() - 1);
+    }
+
+    while (firstRow > newFirstRow) {
+        Box* row = rows.back();
+        if (containsFocus(row))
+            break;
+
+        rows.pop_back();
+        Box::removeView(row, false);
+        Box::addView(row, 1);
+        rows.insert(rows.begin(), row);
+        firstRow--;
+        bindRow(row, firstRow);
+    }
+
+    updateSpacers();
+}
+
+void GridView::prefetchAround() {
+    if (!prefetcher)
+        return;
+
+    const size_t belowFrom = firstRow + rows.size();
+    const size_t belowTo = std::min(totalRows, belowFrom + PREFETCH_ROWS);
+    for (size_t index = belowFrom * columls;
+         index < std::min(itemCount, belowTo * columls); index++)
+        prefetcher(index);
+
+    const size_t aboveFrom =
+        firstRow > PREFETCH_ROWS ? firstRow - PREFETCH_ROWS : 0;
+    for (size_t index = aboveFrom * columls; index < firstRow * columls;
+         index++)
+        prefetcher(index);
+}
+
+void GridView::draw(NVGcontext* vg, float x, float y, float width,
+                    float height, Style style, FrameContext* ctx) {
+    if (!rows.empty() && rows.size() < totalRows) {
+        // y is where the grid starts on screen, negative once scrolled past
+        const float scrolled = std::max(0.0f, -y);
+        const auto visibleFirst = size_t(scrolled / rowHeight);
+        const auto wantedFirst = std::min(
+            visibleFirst > ROW_MARGIN ? visibleFirst - ROW_MARGIN : 0,
+            totalRows - rows.size());
+
+        if (wantedFirst != firstRow) {
+            scrollRowsTo(wantedFirst);
+            prefetchAround();
+        }
+    }
+
+    Box::draw(vg, x, y, width, height, style, ctx);
 }
 
 View* GridView::getParentNavigationDecision(View* from, View* newFocus,
@@ -84,14 +316,19 @@ int GridView::getItemIndex(View* view) {
     return -1;
 }
 
-int GridView::getRows() { return (int)children.size() / columls; }
+size_t GridView::countItems() {
+    // Virtualized grids keep cells only for the rows on screen
+    return topSpacer ? itemCount : children.size();
+}
+
+int GridView::getRows() {
+    return int((countItems() + columls - 1) / columls);
+}
 
 int GridView::getItemsInRow(int row) {
-    if (getRows() > row - 2)
-        return columls;
-    if (getRows() > row - 1)
-        return (int)children.size() % columls;
-    return 0;
+    if (row < 0 || row >= getRows())
+        return 0;
+    return std::min(columls, int(countItems()) - row * columls);
 }
 
 std::vector<View*>& GridView::getChildren() { return this->children; }
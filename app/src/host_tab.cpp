@@ -6,7 +6,10 @@
 //
 
 #include "host_tab.hpp"
+#include "BoxArtManager.hpp"
 #include "GameStreamClient.hpp"
+#include "HostMonitor.hpp"
+#include "HostStateCache.hpp"
 #include "app_list_view.hpp"
 #include "helper.hpp"
 #include "main_tabs_view.hpp"
@@ -31,6 +34,13 @@ HostTab::HostTab(const Host& host) : host(host) {
     remove->setText("common/remove"_i18n);
     remove->title->setTextColor(RGB(229, 57, 53));
 
+    statusSubscription = HostMonitor::instance().status_event()->subscribe(
+        [this](const HostStatusUpdate& update) {
+            if (hosts_match(update.host, this->host)) {
+                applyStatus(update.status);
+            }
+        });
+
     reloadHost();
 
     registerAction("host/rename"_i18n, ControllerButton::BUTTON_START,
@@ -90,7 +100,10 @@ HostTab::HostTab(const Host& host) : host(host) {
                             }
 
                             if (result.isSuccess()) {
-                                reloadHost();
+                                // The monitor still has the host offline,
+                                // the wake just got serverinfo from it
+                                applyStatus(HostStatus::ONLINE);
+                                HostMonitor::instance().refresh(this->host);
                             } else {
                                 showError("host/wake_up_error"_i18n);
                             }
@@ -108,6 +121,7 @@ HostTab::HostTab(const Host& host) : host(host) {
         auto* dialog = new Dialog("host/remove_message"_i18n);
         dialog->addButton("common/cancel"_i18n, [] {});
         dialog->addButton("common/remove"_i18n, [host] {
+            BoxArtManager::instance().remove_host(host);
             Settings::instance().remove_host(host);
             MainTabs::getInstanse()->refillTabs();
         });
@@ -117,31 +131,65 @@ HostTab::HostTab(const Host& host) : host(host) {
     });
 }
 
+HostTab::~HostTab() {
+    HostMonitor::instance().status_event()->unsubscribe(statusSubscription);
+}
+
 void HostTab::reloadHost() {
-    state = FETCHING;
-    header->setTitle("host/status"_i18n + ": " + "host/fetching"_i18n);
-    header->setSubtitle(host_subtitle(host));
-    connect->setText("host/wait"_i18n);
+    // Paint what the monitor already knows, then ask it for fresh serverinfo
+    const auto status = HostMonitor::instance().status(host);
+    if (status != HostStatus::UNKNOWN) {
+        applyStatus(status);
+        HostMonitor::instance().refresh(host);
+        return;
+    }
+
+    // Until the host answers, show how it was last time, marked as fetching
+    HostSnapshot snapshot;
+    if (HostStateCache::instance().load(host, snapshot) &&
+        snapshot.has_server && snapshot.server.paired) {
+        state = AVAILABLE;
+        header->setTitle("host/status"_i18n + ": " + "host/ready"_i18n + " (" +
+                         "host/fetching"_i18n + ")");
+        header->setSubtitle(snapshot.server.address.empty()
+                                ? host_subtitle(host)
+                                : snapshot.server.address);
+        connect->setText("host/connect"_i18n);
+    } else {
+        state = FETCHING;
+        header->setTitle("host/status"_i18n + ": " + "host/fetching"_i18n);
+        header->setSubtitle(host_subtitle(host));
+        connect->setText("host/wait"_i18n);
+    }
 
     ASYNC_RETAIN
-    GameStreamClient::instance().connect(
+    GameStreamClient::instance().connect_cached(
         host, [ASYNC_TOKEN](const GSResult<SERVER_DATA>& result) {
             ASYNC_RELEASE
-
-            if (result.isSuccess()) {
-                const auto connectedAddress =
-                    GameStreamClient::instance().active_address(this->host);
-                header->setTitle("host/status"_i18n + ": " + "host/ready"_i18n);
-                header->setSubtitle(connectedAddress.empty()
-                                        ? host_subtitle(this->host)
-                                        : connectedAddress);
-                connect->setText("host/connect"_i18n);
-                state = AVAILABLE;
-            } else {
-                header->setTitle("host/status"_i18n + ": " +
-                                 "host/unable"_i18n);
-                connect->setText("host/wake_up"_i18n);
-                state = UNAVAILABLE;
-            }
+            applyStatus(result.isSuccess() ? HostStatus::ONLINE
+                                           : HostStatus::OFFLINE);
         });
 }
+
+void HostTab::applyStatus(HostStatus status) {
+    switch (status) {
+    case HostStatus::ONLINE:
+    case HostStatus::STREAMING: {
+        const auto connectedAddress =
+            GameStreamClient::instance().active_address(host);
+        header->setTitle("host/status"_i18n + ": " + "host/ready"_i18n);
+        header->setSubtitle(connectedAddress.empty() ? host_subtitle(host)
+                                                     : connectedAddress);
+        connect->setText("host/connect"_i18n);
+        state = AVAILABLE;
+        break;
+    }
+    case HostStatus::OFFLINE:
+        header->setTitle("host/status"_i18n + ": " + "host/unable"_i18n);
+        connect->setText("host/wake_up"_i18n);
+        state = UNAVAILABLE;
+        break;
+    case HostStatus::UNKNOWN:
+        break;
+    }
+}
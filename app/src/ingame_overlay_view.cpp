@@ -12,6 +12,7 @@
 #include "helper.hpp"
 #include "ingame_overlay_view.hpp"
 #include "streaming_input_overlay.hpp"
+#include "InputManager.hpp"
 #include "button_selecting_dialog.hpp"
 #include "UpscalingSupport.hpp"
 
@@ -123,6 +124,7 @@ OptionsTab::OptionsTab(StreamingView* streamView) : streamView(streamView) {
                 auto options = Settings::instance().guide_key_options();
                 options.buttons = buttons;
                 Settings::instance().set_guide_key_options(options);
+                MoonlightInputManager::instance().reloadButtonMappingLayout();
                 setupButtonsSelectorCell(guideKeyButtons, buttons);
             });
 
@@ -175,6 +177,7 @@ OptionsTab::OptionsTab(StreamingView* streamView) : streamView(streamView) {
         stream << std::fixed << std::setprecision(1) << int(value * 100);
         rumbleForceHeader->setSubtitle(stream.str() + "%");
         Settings::instance().set_rumble_force(value);
+        MoonlightInputManager::instance().reloadButtonMappingLayout();
     });
     rumbleForceSlider->setProgress(rumbleForceProgress);
 
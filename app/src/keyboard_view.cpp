@@ -135,7 +135,7 @@ void ButtonView::onFocusLost() {
     }
 }
 
-KeyboardLocale ButtonView::getCurrentLocale() {
+const KeyboardLocale& ButtonView::getCurrentLocale() {
     int selectedLang = keyboardView->keyboardLangLock != -1
                            ? keyboardView->keyboardLangLock
                            : Settings::instance().get_keyboard_locale();
@@ -151,14 +151,22 @@ void ButtonView::applyTitle() {
     if (dummy)
         return;
 
+    const KeyboardLocale& selectedLang = getCurrentLocale();
+    const int locale = int(&selectedLang - KeyboardView::getLocales().data());
+    bool shifted = keysState[VK_RSHIFT];
+    // Setting the same text again would still lay the label out
+    if (locale == titleLocale && shifted == titleShifted)
+        return;
+    titleLocale = locale;
+    titleShifted = shifted;
+
     // We need to map only key title, virtual keys are constant (which could be a bug in Sunshine)
     KeyboardKeys mappedKey = key;
-    auto selectedLang = getCurrentLocale();
-    if (selectedLang.keyMapper.contains(key)) {
-        mappedKey = selectedLang.keyMapper[key];
+    auto mapped = selectedLang.keyMapper.find(key);
+    if (mapped != selectedLang.keyMapper.end()) {
+        mappedKey = mapped->second;
     }
 
-    bool shifted = keysState[VK_RSHIFT];
     charLabel->setText(selectedLang.localization[mappedKey][shifted]);
 }
 
@@ -166,6 +174,7 @@ void ButtonView::setKey(KeyboardKeys key) {
 
     this->dummy = false;
     this->key = key;
+    this->titleLocale = -1;
     this->applyTitle();
 
     if (keysState[key])
@@ -244,12 +253,13 @@ KeyboardView::KeyboardView(bool focusable)
 
     switch (Settings::instance().get_keyboard_type()) {
     case COMPACT:
-        createEnglishLayout();
+        baseLayout = ENGLISH_LAYOUT;
         break;
     case FULLSIZED:
-        createFullLayout();
+        baseLayout = FULL_LAYOUT;
         break;
     }
+    showLayout(baseLayout);
 
     addGestureRecognizer(
         new TapGestureRecognizer([](TapGestureStatus status, Sound* sound) {}));
@@ -260,6 +270,70 @@ KeyboardView::KeyboardView(bool focusable)
 KeyboardView::~KeyboardView() {
     if (rumblingActive)
         inputManager->sendRumble(0, 0, 0);
+
+    for (int i = 0; i < _LAYOUT_MAX; i++) {
+        if (i != currentLayout)
+            delete layouts[i];
+    }
+}
+
+KeyboardView* KeyboardView::acquire(bool focusable) {
+    const auto key = std::make_pair(int(Settings::instance().get_keyboard_type()), focusable);
+    KeyboardView*& keyboard = pool[key];
+    if (!keyboard) {
+        keyboard = new KeyboardView(focusable);
+    } else if (keyboard->getParent()) {
+        // Already on screen, a second one is not kept
+        return new KeyboardView(focusable);
+    } else {
+        keyboard->showLayout(keyboard->baseLayout);
+    }
+
+    // Catch up with locale and modifier changes made while detached
+    KeyboardView::shiftUpdated.fire();
+    return keyboard;
+}
+
+void KeyboardView::release(KeyboardView* keyboard) {
+    if (rumblingActive) {
+        inputManager->sendRumble(0, 0, 0);
+        rumblingActive = false;
+    }
+
+    bool pooled = false;
+    for (const auto& [key, view] : pool)
+        pooled |= view == keyboard;
+
+    keyboard->removeFromSuperView(!pooled);
+}
+
+void KeyboardView::showLayout(Layout layout) {
+    keyboardLangLock = layout == FULL_LAYOUT ? -1 : 0;
+    if (layout == currentLayout)
+        return;
+
+    if (currentLayout != _LAYOUT_MAX)
+        removeView(layouts[currentLayout], false);
+
+    if (!layouts[layout]) {
+        Box* box = new Box(Axis::COLUMN);
+        box->setAlignItems(AlignItems::CENTER);
+        switch (layout) {
+        case ENGLISH_LAYOUT:
+            createEnglishLayout(box);
+            break;
+        case NUMPAD_LAYOUT:
+            createNumpadLayout(box);
+            break;
+        default:
+            createFullLayout(box);
+            break;
+        }
+        layouts[layout] = box;
+    }
+
+    addView(layouts[layout]);
+    currentLayout = layout;
 }
 
 void KeyboardView::draw(NVGcontext* vg, float x, float y, float width,
@@ -283,7 +357,7 @@ KeyboardState KeyboardView::getKeyboardState() {
     KeyboardState state{};
 
     for (int i = 0; i < _VK_KEY_MAX; i++)
-        state.keys[i] = keysState[i];
+        state.words[i / 64] |= uint64_t(keysState[i]) << (i % 64);
 
     return state;
 }
@@ -16,12 +16,10 @@ KeyboardKeys ENG_BUTTONS[] = {
     VK_KEY_C, VK_KEY_V, VK_KEY_B, VK_KEY_N, VK_KEY_M,
 };
 
-void KeyboardView::createEnglishLayout() {
-    clearViews();
-    keyboardLangLock = 0;
+void KeyboardView::createEnglishLayout(Box* layout) {
 
     Box* firstRow = new Box(Axis::ROW);
-    addView(firstRow);
+    layout->addView(firstRow);
 
     for (int i = 0; i < 10; i++) {
         ButtonView* button = new ButtonView(this);
@@ -31,7 +29,7 @@ void KeyboardView::createEnglishLayout() {
     }
 
     Box* secondRow = new Box(Axis::ROW);
-    addView(secondRow);
+    layout->addView(secondRow);
 
     for (int i = 10; i < 19; i++) {
         ButtonView* button = new ButtonView(this);
@@ -41,7 +39,7 @@ void KeyboardView::createEnglishLayout() {
     }
 
     Box* thirdRow = new Box(Axis::ROW);
-    addView(thirdRow);
+    layout->addView(thirdRow);
 
     ButtonView* lshiftButton = new ButtonView(this);
     lshiftButton->setKey(VK_RSHIFT);
@@ -67,7 +65,7 @@ void KeyboardView::createEnglishLayout() {
     thirdRow->addView(deleteButton);
 
     Box* fourthRow = new Box(Axis::ROW);
-    addView(fourthRow);
+    layout->addView(fourthRow);
 
     ButtonView* altButton = new ButtonView(this);
     altButton->charLabel->setText("123");
@@ -76,7 +74,7 @@ void KeyboardView::createEnglishLayout() {
     altButton->setWidth(120);
     altButton->event = [this] {
         sync([this] {
-            createNumpadLayout();
+            showLayout(NUMPAD_LAYOUT);
             if (needFocus)
                 Application::giveFocus(this);
         });
@@ -11,9 +11,7 @@
 using namespace brls;
 using namespace brls::literals;
 
-void KeyboardView::createFullLayout() {
-    clearViews();
-    keyboardLangLock = -1;
+void KeyboardView::createFullLayout(Box* layout) {
 
     float menuButtonWidth = 74.0f;
     float baseButtonWidth = 74.0f;
@@ -24,7 +22,7 @@ void KeyboardView::createFullLayout() {
 
     // ROW 1
     Box* row1 = new Box(Axis::ROW);
-    addView(row1);
+    layout->addView(row1);
 
     std::vector<KeyboardKeys> row1Keys = { VK_ESCAPE, VK_F1, VK_F2, VK_F3, VK_F4, VK_F5, VK_F6, VK_F7, VK_F8, VK_F9, VK_F10, VK_F11, VK_F12, VK_DELETE };
 
@@ -41,7 +39,7 @@ void KeyboardView::createFullLayout() {
 
     // ROW 2
     Box* row2 = new Box(Axis::ROW);
-    addView(row2);
+    layout->addView(row2);
 
     std::vector<KeyboardKeys> row2Keys = { VK_OEM_3, VK_KEY_1, VK_KEY_2, VK_KEY_3, VK_KEY_4, VK_KEY_5, VK_KEY_6, VK_KEY_7, VK_KEY_8, VK_KEY_9, VK_KEY_0, VK_OEM_MINUS, VK_OEM_PLUS };
 
@@ -62,7 +60,7 @@ void KeyboardView::createFullLayout() {
 
     // ROW 3
     Box* row3 = new Box(Axis::ROW);
-    addView(row3);
+    layout->addView(row3);
 
     std::vector<KeyboardKeys> row3Keys = { VK_KEY_Q, VK_KEY_W, VK_KEY_E, VK_KEY_R, VK_KEY_T, VK_KEY_Y, VK_KEY_U, VK_KEY_I, VK_KEY_O, VK_KEY_P, VK_OEM_4, VK_OEM_6, VK_OEM_5 };
 
@@ -83,7 +81,7 @@ void KeyboardView::createFullLayout() {
 
     // ROW 4
     Box* row4 = new Box(Axis::ROW);
-    addView(row4);
+    layout->addView(row4);
 
     std::vector<KeyboardKeys> row4Keys = { VK_KEY_A, VK_KEY_S, VK_KEY_D, VK_KEY_F, VK_KEY_G, VK_KEY_H, VK_KEY_J, VK_KEY_K, VK_KEY_L, VK_OEM_1, VK_OEM_7 };
 
@@ -111,7 +109,7 @@ void KeyboardView::createFullLayout() {
 
     // ROW 5
     Box* row5 = new Box(Axis::ROW);
-    addView(row5);
+    layout->addView(row5);
 
     std::vector<KeyboardKeys> row5Keys = { VK_KEY_Z, VK_KEY_X, VK_KEY_C, VK_KEY_V, VK_KEY_B, VK_KEY_N, VK_KEY_M, VK_OEM_COMMA, VK_OEM_PERIOD, VK_OEM_2 };
 
@@ -143,7 +141,7 @@ void KeyboardView::createFullLayout() {
 
     // ROW 6
     Box* row6 = new Box(Axis::ROW);
-    addView(row6);
+    layout->addView(row6);
 
     ButtonView* langButton = new ButtonView(this);
     langButton->charLabel->setText("\ue01d");
@@ -151,12 +149,12 @@ void KeyboardView::createFullLayout() {
     langButton->setMargins(4, 4, 4, 4);
     langButton->setWidth(menuButtonWidth);
     langButton->event = [this] {
-        auto locales = KeyboardView::getLocales();
+        const auto& locales = KeyboardView::getLocales();
         std::vector<std::string> langs;
 
         std::transform(locales.begin(), locales.end(),
                        std::back_inserter(langs),
-                       [](KeyboardLocale locale) { return locale.name; });
+                       [](const KeyboardLocale& locale) { return locale.name; });
 
         Dropdown* dropdown = new Dropdown(
             "settings/select_language"_i18n, langs,
@@ -8,7 +8,9 @@
 #include "keyboard_view.hpp"
 
 void KeyboardView::createLocales() {
-    locales.clear();
+    if (!locales.empty())
+        return;
+
     locales.reserve(6);
     locales.push_back(KeyboardLocale{
         .name = "English",
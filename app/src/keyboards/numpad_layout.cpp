@@ -18,12 +18,10 @@ KeyboardKeys NUM_BUTTONS[] = {
     VK_OEM_4,  VK_OEM_6,      VK_OEM_MINUS, VK_OEM_PLUS,
 };
 
-void KeyboardView::createNumpadLayout() {
-    clearViews();
-    keyboardLangLock = 0;
+void KeyboardView::createNumpadLayout(Box* layout) {
 
     Box* firstRow = new Box(Axis::ROW);
-    addView(firstRow);
+    layout->addView(firstRow);
 
     for (int i = 0; i < 13; i++) {
         ButtonView* button = new ButtonView(this);
@@ -34,7 +32,7 @@ void KeyboardView::createNumpadLayout() {
     }
 
     Box* secondRow = new Box(Axis::ROW);
-    addView(secondRow);
+    layout->addView(secondRow);
 
     for (int i = 13; i < 25; i++) {
         ButtonView* button = new ButtonView(this);
@@ -45,7 +43,7 @@ void KeyboardView::createNumpadLayout() {
     }
 
     Box* thirdRow = new Box(Axis::ROW);
-    addView(thirdRow);
+    layout->addView(thirdRow);
 
     ButtonView* lshiftButton = new ButtonView(this);
     lshiftButton->setKey(VK_RSHIFT);
@@ -72,7 +70,7 @@ void KeyboardView::createNumpadLayout() {
     thirdRow->addView(deleteButton);
 
     Box* fourthRow = new Box(Axis::ROW);
-    addView(fourthRow);
+    layout->addView(fourthRow);
 
     ButtonView* altButton = new ButtonView(this);
     altButton->charLabel->setText("ABC");
@@ -81,7 +79,7 @@ void KeyboardView::createNumpadLayout() {
     altButton->setWidth(120);
     altButton->event = [this] {
         sync([this] {
-            createEnglishLayout();
+            showLayout(ENGLISH_LAYOUT);
             if (needFocus)
                 Application::giveFocus(this);
         });
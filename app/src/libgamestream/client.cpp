@@ -28,7 +28,9 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <mutex>
 #include <sstream>
+#include <vector>
 
 #define CHANNEL_COUNT_STEREO 2
 #define CHANNEL_COUNT_51_SURROUND 6
@@ -57,13 +59,30 @@ int extractVersionQuadFromString(const char* string, int* quad) {
     return 0;
 }
 
+_SERVER_DATA::_SERVER_DATA(const _SERVER_DATA& other) { *this = other; }
+
+_SERVER_DATA& _SERVER_DATA::operator=(const _SERVER_DATA& other) {
+    if (this == &other)
+        return *this;
+
+    _SERVER_DATA_FIELDS::operator=(other);
+
+    if (other.serverInfo.address == other.address.c_str())
+        serverInfo.address = address.c_str();
+    if (other.serverInfo.serverInfoAppVersion == other.serverInfoAppVersion.c_str())
+        serverInfo.serverInfoAppVersion = serverInfoAppVersion.c_str();
+    if (other.serverInfo.serverInfoGfeVersion == other.serverInfoGfeVersion.c_str())
+        serverInfo.serverInfoGfeVersion = serverInfoGfeVersion.c_str();
+    return *this;
+}
+
 bool _SERVER_DATA::isSunshine() {
     int AppVersionQuad[4];
     extractVersionQuadFromString(serverInfoAppVersion.c_str(), AppVersionQuad);
     return AppVersionQuad[3] < 0;
 }
 
-static int load_serverinfo(PSERVER_DATA server, bool https) {
+static int load_serverinfo(PSERVER_DATA server, bool https, int* requests) {
     int ret = GS_INVALID;
     char url[4096];
     std::string pairedText;
@@ -83,6 +102,7 @@ static int load_serverinfo(PSERVER_DATA server, bool https) {
 
     Data data;
 
+    (*requests)++;
     if (http_request(url, &data, HTTPRequestTimeoutLow) != GS_OK) {
         ret = GS_IO_ERROR;
         goto cleanup;
@@ -158,24 +178,59 @@ cleanup:
     return ret;
 }
 
-static int load_server_status(PSERVER_DATA server) {
-    int ret = GS_INVALID;
-    int i;
+// Hints are keyed by the address gs_init was given, the port only when it
+// isn't the default one
+static std::string server_info_hint_address(const std::string& address,
+                                            unsigned short httpPort) {
+    return httpPort == 47989 ? address
+                             : address + ":" + std::to_string(httpPort);
+}
 
-    /* Fetch the HTTPS port if we don't have one yet */
-    if (!server->httpsPort) {
-        ret = load_serverinfo(server, false);
-        if (ret != GS_OK)
-            return ret;
-    }
+static int load_server_status(PSERVER_DATA server, bool preferHttps,
+                              bool* overHttps, int* requests) {
+    int ret = GS_INVALID;
+    bool haveHttpInfo = false;
+    SERVER_DATA httpInfo;
 
     // Modern GFE versions don't allow serverinfo to be fetched over HTTPS if the client
     // is not already paired. Since we can't pair without knowing the server version, we
     // make another request over HTTP if the HTTPS request fails. We can't just use HTTP
     // for everything because it doesn't accurately tell us if we're paired.
-    ret = GS_INVALID;
-    for (i = 0; i < 2 && ret != GS_OK; i++) {
-        ret = load_serverinfo(server, i == 0);
+    //
+    // When the last successful exchange went over HTTPS with a known port we try that
+    // first, otherwise HTTP goes first since it also tells us the HTTPS port.
+    if (!preferHttps || !server->httpsPort) {
+        ret = load_serverinfo(server, false, requests);
+        if (ret != GS_OK)
+            return ret;
+
+        // HTTP always reports PairStatus 0, only HTTPS can tell whether we
+        // are paired, so it is still asked after every HTTP answer
+        haveHttpInfo = true;
+        httpInfo = *server;
+    }
+
+    *overHttps = false;
+    const unsigned short triedHttpsPort = server->httpsPort;
+    ret = load_serverinfo(server, true, requests);
+    if (ret == GS_OK) {
+        *overHttps = true;
+    } else if (haveHttpInfo) {
+        *server = httpInfo;
+        ret = GS_OK;
+    } else {
+        ret = load_serverinfo(server, false, requests);
+
+        // The hinted HTTPS port was stale, the pair status is only known
+        // once HTTPS answers on the one HTTP just reported
+        if (ret == GS_OK && server->httpsPort != triedHttpsPort) {
+            httpInfo = *server;
+            if (load_serverinfo(server, true, requests) == GS_OK) {
+                *overHttps = true;
+            } else {
+                *server = httpInfo;
+            }
+        }
     }
 
     if (ret == GS_OK) {
@@ -195,9 +250,12 @@ static int load_server_status(PSERVER_DATA server) {
     return ret;
 }
 
-static std::string _gs_error = "";
+// Per thread, so concurrent requests only see their own failure
+static thread_local std::string _gs_error = "";
 
-void gs_set_error(std::string error) { _gs_error = error; }
+void gs_set_error(std::string error) {
+    _gs_error = error;
+}
 
 std::string gs_error() {
     if (_gs_error.empty()) {
@@ -446,6 +504,14 @@ int gs_pair(PSERVER_DATA server, char* pin) {
 
     server->paired = true;
 
+    // Paired hosts only answer serverinfo truthfully over HTTPS
+    ServerInfoHint hint;
+    hint.https_port = server->httpsPort;
+    hint.paired = true;
+    hint.https = true;
+    Settings::instance().set_server_info_hint(
+        server_info_hint_address(server->address, server->httpPort), hint);
+
     return gs_pair_cleanup(ret, server, &result);
 }
 
@@ -598,27 +664,51 @@ int gs_init(PSERVER_DATA server, const std::string address) {
         httpPort = atoi(seglist[1].c_str());
     }
     
-    if (!CryptoManager::load_cert_key_pair()) {
-        brls::Logger::info("Client: No certs, generate new...");
+    {
+        // Discovery verifies hosts from several threads at once
+        static std::mutex setupMutex;
+        std::lock_guard<std::mutex> lock(setupMutex);
+
+        if (!CryptoManager::load_cert_key_pair()) {
+            brls::Logger::info("Client: No certs, generate new...");
 
-        if (!CryptoManager::generate_new_cert_key_pair()) {
-            brls::Logger::info("Client: Failed to generate certs...");
-            return GS_FAILED;
+            if (!CryptoManager::generate_new_cert_key_pair()) {
+                brls::Logger::info("Client: Failed to generate certs...");
+                return GS_FAILED;
+            }
         }
+
+        http_init(Settings::instance().key_dir());
     }
 
-    http_init(Settings::instance().key_dir());
+    const std::string hintAddress = server_info_hint_address(seglist[0], httpPort);
+    ServerInfoHint hint;
+    const bool hasHint = Settings::instance().server_info_hint(hintAddress, &hint);
 
     LiInitializeServerInformation(&server->serverInfo);
     server->address = seglist[0];
     server->serverInfo.address = server->address.c_str();
     server->httpPort = httpPort;
-    server->httpsPort = 0; /* Populated by load_server_status() */
+    server->httpsPort = hasHint ? hint.https_port : 0; /* Refreshed by load_server_status() */
 
-    int result = load_server_status(server);
+    int requests = 0;
+    bool overHttps = false;
+    int result = load_server_status(server, hasHint && hint.https, &overHttps,
+                                    &requests);
     server->serverInfo.serverInfoAppVersion =
         server->serverInfoAppVersion.c_str();
     server->serverInfo.serverInfoGfeVersion =
         server->serverInfoGfeVersion.c_str();
+
+    brls::Logger::info("Client: serverinfo for {} took {} request(s){}",
+                       address, requests, hasHint ? " (known host)" : "");
+
+    if (result == GS_OK) {
+        ServerInfoHint newHint;
+        newHint.https_port = server->httpsPort;
+        newHint.paired = server->paired;
+        newHint.https = overHttps;
+        Settings::instance().set_server_info_hint(hintAddress, newHint);
+    }
     return result;
 }
@@ -27,7 +27,8 @@
 #define MIN_SUPPORTED_GFE_VERSION 3
 #define MAX_SUPPORTED_GFE_VERSION 7
 
-typedef struct _SERVER_DATA {
+// Everything SERVER_DATA holds, copied member by member by the compiler
+struct _SERVER_DATA_FIELDS {
     std::string address;
     std::string serverInfoAppVersion;
     std::string serverInfoGfeVersion;
@@ -42,6 +43,14 @@ typedef struct _SERVER_DATA {
     SERVER_INFORMATION serverInfo;
     unsigned short httpPort;
     unsigned short httpsPort;
+};
+
+typedef struct _SERVER_DATA : _SERVER_DATA_FIELDS {
+    _SERVER_DATA() = default;
+    // serverInfo points into the strings, copies point into their own
+    _SERVER_DATA(const _SERVER_DATA& other);
+    _SERVER_DATA& operator=(const _SERVER_DATA& other);
+
     bool isSunshine();
 } SERVER_DATA, *PSERVER_DATA;
 
@@ -24,11 +24,19 @@
 #include <borealis/core/logger.hpp>
 
 #include <curl/curl.h>
+#include <chrono>
 #include <cstring>
 
 static bool curlGlobalInit = false;
 static std::string certificateFilePath;
 static std::string keyFilePath;
+static thread_local const std::atomic_bool* cancelFlag = nullptr;
+
+static std::atomic<uint64_t> statRequests = 0;
+static std::atomic<uint64_t> statFailures = 0;
+static std::atomic<uint64_t> statCancelled = 0;
+static std::atomic<uint64_t> statBytes = 0;
+static std::atomic<uint64_t> statMicroseconds = 0;
 
 CURL* makeCurl();
 void freeCurl(CURL* curl);
@@ -53,6 +61,26 @@ static size_t _write_curl(void* contents, size_t size, size_t nmemb,
     return realsize;
 }
 
+static int _xferinfo_curl(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
+                          curl_off_t ultotal, curl_off_t ulnow) {
+    auto* flag = (const std::atomic_bool*)clientp;
+    return flag->load() ? 1 : 0;
+}
+
+void http_set_cancel_flag(const std::atomic_bool* flag) {
+    cancelFlag = flag;
+}
+
+HTTPStats http_stats() {
+    HTTPStats stats;
+    stats.requests = statRequests;
+    stats.failures = statFailures;
+    stats.cancelled = statCancelled;
+    stats.bytes = statBytes;
+    stats.microseconds = statMicroseconds;
+    return stats;
+}
+
 int http_init(const std::string& key_directory) {
     if (!curlGlobalInit) {
 #if LIBCURL_VERSION_NUM >= 0x075600
@@ -115,21 +143,42 @@ int http_request(const std::string& url, Data* data,
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
 
+    if (cancelFlag) {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, _xferinfo_curl);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void*)cancelFlag);
+    }
+
+    const auto startedAt = std::chrono::steady_clock::now();
     CURLcode res = curl_easy_perform(curl);
 
+    statRequests++;
+    statMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - startedAt)
+                            .count();
+
     if (res != CURLE_OK) {
-        gs_set_error(curl_easy_strerror(res));
-        brls::Logger::error("Curl: error: {}", gs_error().c_str());
+        if (res == CURLE_ABORTED_BY_CALLBACK) {
+            statCancelled++;
+            brls::Logger::info("Curl: cancelled:\n{}", url.c_str());
+        } else {
+            statFailures++;
+            gs_set_error(curl_easy_strerror(res));
+            brls::Logger::error("Curl: error: {}", gs_error().c_str());
+        }
         free(http_data->memory);
         free(http_data);
+        freeCurl(curl);
         return GS_FAILED;
     } else if (http_data->memory == nullptr) {
         brls::Logger::error("Curl: memory = NULL");
         free(http_data->memory);
         free(http_data);
+        freeCurl(curl);
         return GS_OUT_OF_MEMORY;
     }
 
+    statBytes += http_data->size;
     *data = Data(http_data->memory, http_data->size);
 
     if (http_data->size > 3000) {
@@ -20,6 +20,8 @@
 #pragma once
 
 #include "Data.hpp"
+#include <atomic>
+#include <cstdint>
 
 enum HTTPRequestTimeout : long {
     HTTPRequestTimeoutLow = 1,
@@ -30,3 +32,17 @@ enum HTTPRequestTimeout : long {
 int http_init(const std::string& key_directory);
 int http_request(const std::string& url, Data* data, HTTPRequestTimeout timeout);
 
+// Requests made by the calling thread are aborted once *flag becomes true.
+// Pass nullptr to detach.
+void http_set_cancel_flag(const std::atomic_bool* flag);
+
+// Process-wide counters of every http_request, see http_stats()
+struct HTTPStats {
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    uint64_t cancelled = 0;
+    uint64_t bytes = 0;
+    uint64_t microseconds = 0;
+};
+
+HTTPStats http_stats();
@@ -22,8 +22,11 @@
 #include "main_tabs_view.hpp"
 #include "settings_tab.hpp"
 #include "views/boolean_slider_cell.hpp"
+#include "views/box_art_view.hpp"
 
+#include "BoxArtManager.hpp"
 #include "DiscoverManager.hpp"
+#include "HostMonitor.hpp"
 #include "MoonlightSession.hpp"
 #include "SwitchMoonlightSessionDecoderAndRenderProvider.hpp"
 
@@ -137,6 +140,7 @@ int main(int argc, char* argv[]) {
     // Register custom views (including tabs, which are views)
     brls::Application::registerXMLView("BooleanSliderCell", BooleanSliderCell::create);
     brls::Application::registerXMLView("LinkCell", LinkCell::create);
+    brls::Application::registerXMLView("BoxArtView", BoxArtView::create);
 
     brls::Application::registerXMLView("MainTabs", MainTabs::create);
     brls::Application::registerXMLView("HostTab", HostTab::create);
@@ -154,6 +158,10 @@ int main(int argc, char* argv[]) {
     brls::getStyle().addMetric("about/padding_sides", 75);
     brls::getStyle().addMetric("about/description_margin", 50);
 
+    if (auto exitCode = runInputHarnessFromArgs(argc, argv)) {
+        return *exitCode;
+    }
+
     // Create and push the main activity to the stack if cannot run game from arguments
     if (!startFromArgs(argc, argv)) {
         brls::Application::pushActivity(new MainActivity());
@@ -163,9 +171,16 @@ int main(int argc, char* argv[]) {
     brls::Application::setSwapInputKeys(Settings::instance().swap_ui_keys());
 
     // Run the app
-    while (brls::Application::mainLoop()) {}
+    while (brls::Application::mainLoop()) {
+        // Art decoded meanwhile is on the atlas for the next frame
+        BoxArtManager::instance().upload_pending(
+            brls::Application::getNVGContext());
+    }
 
     // Exit
+    HostMonitor::instance().shutdown();
+    BoxArtManager::instance().shutdown();
+    Settings::instance().flush();
 #if defined(PLATFORM_TVOS)
     exit(0);
 #endif
@@ -8,9 +8,12 @@
 #include "main_args.hpp"
 #include <borealis.hpp>
 #include "streaming_view.hpp"
+#include "InputManager.hpp"
+#include "InputRecorder.hpp"
 
 #include <algorithm>
 #include <charconv>
+#include <cstdlib>
 #include <cctype>
 #include <optional>
 #include <string_view>
@@ -378,3 +381,26 @@ bool startFromUrl(const std::string& url, bool resetActivityStack) {
 
     return startFromLaunchRequest(parseDeepLinkUrl(url), resetActivityStack);
 }
+
+std::optional<int> runInputHarnessFromArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg(argv[i]);
+        const size_t separator = arg.find('=');
+        if (!arg.starts_with("--") || separator == std::string_view::npos) {
+            continue;
+        }
+
+        const std::string key = normalizeKey(std::string(arg.substr(2, separator - 2)));
+        const std::string path(arg.substr(separator + 1));
+
+        if (key == "recordinput") {
+            if (!MoonlightInputManager::instance().startRecording(path)) {
+                Logger::error("Failed to record input to {}", path);
+            }
+        } else if (key == "replayinput") {
+            return InputReplay::run(path) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    return std::nullopt;
+}
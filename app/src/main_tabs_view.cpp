@@ -6,6 +6,7 @@
 //
 
 #include "main_tabs_view.hpp"
+#include "HostMonitor.hpp"
 #include "Settings.hpp"
 #include "about_tab.hpp"
 #include "add_host_tab.hpp"
@@ -54,6 +55,7 @@ void MainTabs::refillTabs(bool keepFocus) {
     lastHasAnyFavorites = hasAnyFavorite;
 
     auto hosts = Settings::instance().hosts();
+    HostMonitor::instance().set_hosts(hosts);
     for (const Host& host : hosts) {
         addTab(host.hostname, [host] { return new HostTab(host); });
     }
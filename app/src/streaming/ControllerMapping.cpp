@@ -0,0 +1,100 @@
+#include "ControllerMapping.hpp"
+#include "Limelight.h"
+
+namespace {
+constexpr uint64_t buttonBit(int button) { return uint64_t(1) << button; }
+
+float fsqrt_(float f) {
+    int i = *(int *)&f;
+    i = (i >> 1) + 0x1fbb67ae;
+    float f1 = *(float *)&i;
+    return 0.5F * (f1 + f / f1);
+
+}
+}
+
+uint64_t ControllerMapping::packButtons(const brls::ControllerState& controller) {
+    uint64_t buttons = 0;
+    for (int i = 0; i < brls::_BUTTON_MAX; i++)
+        buttons |= uint64_t(controller.buttons[i]) << i;
+    return buttons;
+}
+
+uint64_t ControllerMapping::mapButtons(uint64_t buttons,
+                                       const CompiledInputMapping& mapping,
+                                       int& flags) {
+    uint64_t mapped = 0;
+    flags = 0;
+    // Only the pressed buttons are visited
+    for (; buttons != 0; buttons &= buttons - 1) {
+        const int button = __builtin_ctzll(buttons);
+        mapped |= mapping.buttonTargets[button];
+        flags |= mapping.buttonFlags[button];
+    }
+    return mapped;
+}
+
+GamepadState ControllerMapping::mapState(const brls::ControllerState& controller,
+                                         const CompiledInputMapping& mapping,
+                                         bool specialKey, bool guideSent) {
+    int buttonFlags = 0;
+    const uint64_t buttons =
+        mapButtons(packButtons(controller), mapping, buttonFlags);
+
+    // Use axis or button if axis is not available (equals 0)
+    float lzAxis = controller.axes[brls::LEFT_Z] > 0 ? controller.axes[brls::LEFT_Z] : ((buttons & buttonBit(brls::BUTTON_LT)) ? 1.f : 0.f);
+    float rzAxis = controller.axes[brls::RIGHT_Z] > 0 ? controller.axes[brls::RIGHT_Z] : ((buttons & buttonBit(brls::BUTTON_RT)) ? 1.f : 0.f);
+
+    // Truncate dead zones
+    float leftStickDeadzone = mapping.leftStickDeadzone;
+    float rightStickDeadzone = mapping.rightStickDeadzone;
+
+    float leftXAxis = controller.axes[brls::LEFT_X];
+    float leftYAxis = controller.axes[brls::LEFT_Y];
+    float rightXAxis = controller.axes[brls::RIGHT_X];
+    float rightYAxis = controller.axes[brls::RIGHT_Y];
+
+    if (leftStickDeadzone > 0) {
+        float magnitude = fsqrt_(leftXAxis * leftXAxis + leftYAxis * leftYAxis);
+        if (magnitude < leftStickDeadzone) {
+            leftXAxis = 0;
+            leftYAxis = 0;
+        }
+    }
+
+    if (rightStickDeadzone > 0) {
+        float magnitude = fsqrt_(rightXAxis * rightXAxis + rightYAxis * rightYAxis);
+        if (magnitude < rightStickDeadzone) {
+            rightXAxis = 0;
+            rightYAxis = 0;
+        }
+    }
+
+    GamepadState gamepadState{
+        .buttonFlags = static_cast<short>(buttonFlags),
+        .leftTrigger = static_cast<unsigned char>(
+            0xFF * (!specialKey ? lzAxis : 0)),
+        .rightTrigger = static_cast<unsigned char>(
+            0xFF * (!specialKey ? rzAxis : 0)),
+        .leftStickX = static_cast<short>(
+            0x7FFF * (!specialKey ? leftXAxis : 0)),
+        .leftStickY = static_cast<short>(
+            -0x7FFF * (!specialKey ? leftYAxis : 0)),
+        .rightStickX = static_cast<short>(
+            0x7FFF * (!specialKey ? rightXAxis : 0)),
+        .rightStickY = static_cast<short>(
+            -0x7FFF * (!specialKey ? rightYAxis : 0)),
+    };
+
+    const uint64_t guideCombo = mapping.guideCombo;
+    bool guideComboPressed = guideCombo != 0 && comboPressed(buttons, guideCombo);
+
+    if (guideComboPressed || guideSent)
+        gamepadState.buttonFlags = 0;
+
+    bool guidePressed = guideComboPressed || (buttons & buttonBit(brls::BUTTON_GUIDE));
+    guidePressed ? (gamepadState.buttonFlags |= SPECIAL_FLAG)
+               : (gamepadState.buttonFlags &= ~SPECIAL_FLAG);
+
+    return gamepadState;
+}
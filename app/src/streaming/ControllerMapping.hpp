@@ -0,0 +1,65 @@
+#pragma once
+
+#include <borealis.hpp>
+#include <chrono>
+#include <cstdint>
+
+// Moonlight ready gamepad
+struct GamepadState {
+    short buttonFlags = 0;
+    unsigned char leftTrigger = 0;
+    unsigned char rightTrigger = 0;
+    short leftStickX = 0;
+    short leftStickY = 0;
+    short rightStickX = 0;
+    short rightStickY = 0;
+
+    bool is_equal(GamepadState other) {
+        return buttonFlags == other.buttonFlags &&
+               leftTrigger == other.leftTrigger &&
+               rightTrigger == other.rightTrigger &&
+               leftStickX == other.leftStickX &&
+               leftStickY == other.leftStickY &&
+               rightStickX == other.rightStickX &&
+               rightStickY == other.rightStickY;
+    }
+};
+
+// The mapping layout and key combos flattened to bitmasks over
+// brls::ControllerButton, plus the other settings a poll reads, so the
+// sampling thread never touches Settings
+struct CompiledInputMapping {
+    // Mapped button and Limelight flags raised by each physical button
+    uint64_t buttonTargets[brls::_BUTTON_MAX] = {};
+    int buttonFlags[brls::_BUTTON_MAX] = {};
+    // Mapped buttons, 0 when no combo is set
+    uint64_t guideCombo = 0;
+    // Physical buttons of the unified controller
+    uint64_t overlayCombo = 0;
+    int overlayHoldTime = 0;
+    uint64_t mouseInputCombo = 0;
+    int mouseInputHoldTime = 0;
+    float leftStickDeadzone = 0;
+    float rightStickDeadzone = 0;
+    std::chrono::milliseconds minSendInterval{0};
+    float rumbleForce = 1;
+};
+
+// What a single controller poll goes through. It keeps no state, so the
+// input bench in tools/fake_host runs it outside the app
+class ControllerMapping {
+  public:
+    static uint64_t packButtons(const brls::ControllerState& controller);
+    // Mapped buttons of the pressed `buttons`, their Limelight flags in `flags`
+    static uint64_t mapButtons(uint64_t buttons,
+                               const CompiledInputMapping& mapping, int& flags);
+    static bool comboPressed(uint64_t buttons, uint64_t combo) {
+        return (buttons & combo) == combo;
+    }
+
+    // `guideSent` tells whether the last state sent for this controller
+    // carried the guide button
+    static GamepadState mapState(const brls::ControllerState& controller,
+                                 const CompiledInputMapping& mapping,
+                                 bool specialKey, bool guideSent);
+};
@@ -20,6 +20,8 @@ void DiscoverManager::reset() {
     pause();
     counter = 0;
     addresses.clear();
+
+    std::lock_guard<std::mutex> lock(hostsMutex);
     _hosts.clear();
     hosts = hosts.success(std::vector<Host>());
 }
@@ -40,7 +42,7 @@ void DiscoverManager::start() {
         paused = false;
         brls::async([] { DiscoverManager::instance().loop(); });
     }
-    brls::sync([this] { getHostsUpdateEvent()->fire(hosts); });
+    brls::sync([this] { getHostsUpdateEvent()->fire(getHosts()); });
 }
 
 void DiscoverManager::pause() { paused = true; }
@@ -55,42 +57,73 @@ void DiscoverManager::loop() {
                 Host host;
                 host.address = addresses[counter];
                 host.remoteAddress =
-                    GameStreamClient::external_address_for_mdns(host.address);
+                    GameStreamClient::cached_external_address_for_mdns(host.address);
                 host.hostname = server_data.hostname;
                 host.mac = server_data.mac;
-                auto it = std::find_if(_hosts.begin(), _hosts.end(), [host](const Host& existing) {
-                    return hosts_match(existing, host);
-                });
-                if (it == _hosts.end()) {
-                    _hosts.push_back(host);
-                } else {
-                    if (!host.address.empty()) {
-                        it->address = host.address;
-                    }
-                    if (!host.remoteAddress.empty()) {
-                        it->remoteAddress = host.remoteAddress;
-                    }
-                    if (!host.hostname.empty()) {
-                        it->hostname = host.hostname;
-                    }
-                    if (!host.mac.empty()) {
-                        it->mac = host.mac;
-                    }
+                mergeHost(host);
+
+                // Show the host right away, WAN address arrives later
+                if (host.remoteAddress.empty()) {
+                    GameStreamClient::resolve_external_address_for_mdns(
+                        host.address, [this, host](const std::string& remoteAddress) {
+                            if (remoteAddress.empty()) {
+                                return;
+                            }
+
+                            Host resolvedHost = host;
+                            resolvedHost.remoteAddress = remoteAddress;
+                            mergeHost(resolvedHost);
+                        });
                 }
-                hosts = hosts.success(_hosts);
-                brls::sync([this] { getHostsUpdateEvent()->fire(hosts); });
             }
 
             counter++;
         }
 
-        if (counter == addresses.size() && _hosts.empty()) {
-            hosts = hosts.failure("discovery_manager/no_host"_i18n);
-            brls::sync([this] { getHostsUpdateEvent()->fire(hosts); });
+        if (counter == addresses.size()) {
+            std::lock_guard<std::mutex> lock(hostsMutex);
+            if (_hosts.empty()) {
+                hosts = hosts.failure("discovery_manager/no_host"_i18n);
+                brls::sync([this] { getHostsUpdateEvent()->fire(hosts); });
+            }
+
+            // Every address answered or not by now, gs_init left hints for
+            // the ones that did
+            auto discovered = _hosts;
+            brls::sync([discovered] {
+                Settings::instance().prune_server_info_hints(discovered);
+            });
         }
 
         paused = true;
     });
 }
 
+void DiscoverManager::mergeHost(const Host& host) {
+    std::lock_guard<std::mutex> lock(hostsMutex);
+    auto it = std::find_if(_hosts.begin(), _hosts.end(), [host](const Host& existing) {
+        return hosts_match(existing, host);
+    });
+    if (it == _hosts.end()) {
+        _hosts.push_back(host);
+    } else {
+        if (!host.address.empty()) {
+            it->address = host.address;
+        }
+        if (!host.remoteAddress.empty()) {
+            it->remoteAddress = host.remoteAddress;
+        }
+        if (!host.hostname.empty()) {
+            it->hostname = host.hostname;
+        }
+        if (!host.mac.empty()) {
+            it->mac = host.mac;
+        }
+    }
+    hosts = hosts.success(_hosts);
+
+    auto snapshot = hosts;
+    brls::sync([this, snapshot] { getHostsUpdateEvent()->fire(snapshot); });
+}
+
 DiscoverManager::~DiscoverManager() { paused = true; }
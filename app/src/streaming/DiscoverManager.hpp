@@ -11,6 +11,7 @@
 #include "Settings.hpp"
 #include "Singleton.hpp"
 #include <borealis.hpp>
+#include <mutex>
 #include <pthread.h>
 #include <stdio.h>
 
@@ -23,7 +24,10 @@ class DiscoverManager : public Singleton<DiscoverManager> {
         return &hostsUpdateEvent;
     }
 
-    GSResult<std::vector<Host>> getHosts() { return hosts; }
+    GSResult<std::vector<Host>> getHosts() {
+        std::lock_guard<std::mutex> lock(hostsMutex);
+        return hosts;
+    }
 
     bool isPaused() { return paused; }
 
@@ -33,9 +37,11 @@ class DiscoverManager : public Singleton<DiscoverManager> {
 
   private:
     void loop();
+    void mergeHost(const Host& host);
     std::vector<std::string> addresses;
     GSResult<std::vector<Host>> hosts;
     std::vector<Host> _hosts;
+    std::mutex hostsMutex;
     brls::Event<GSResult<std::vector<Host>>> hostsUpdateEvent;
     int counter = 0;
     bool paused = true;
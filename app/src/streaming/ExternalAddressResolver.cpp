@@ -0,0 +1,171 @@
+#include "ExternalAddressResolver.hpp"
+#include "GameStreamClient.hpp"
+#include "Settings.hpp"
+#include <Limelight.h>
+#include <borealis.hpp>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#endif
+
+using namespace brls;
+
+namespace {
+constexpr unsigned short DEFAULT_STUN_PORT = 3478;
+constexpr auto RESOLVED_TTL = std::chrono::minutes(10);
+// Don't hammer the STUN server while we are offline
+constexpr auto FAILED_TTL = std::chrono::seconds(30);
+
+void split_stun_server(const std::string& server, std::string& host,
+                       unsigned short& port) {
+    host = server;
+    port = DEFAULT_STUN_PORT;
+
+    const auto separator = server.rfind(':');
+    if (separator == std::string::npos ||
+        server.find(':') != separator) {
+        return;
+    }
+
+    const int parsedPort = atoi(server.substr(separator + 1).c_str());
+    if (parsedPort > 0 && parsedPort <= 65535) {
+        host = server.substr(0, separator);
+        port = static_cast<unsigned short>(parsedPort);
+    }
+}
+
+std::string format_ipv4(unsigned int address) {
+    in_addr externalAddr{};
+    externalAddr.s_addr = address;
+
+    char addressBuffer[INET_ADDRSTRLEN] = {};
+    if (inet_ntop(AF_INET, &externalAddr, addressBuffer,
+                  sizeof(addressBuffer)) == nullptr) {
+        Logger::error("Failed to format remote IPv4 address returned by STUN");
+        return "";
+    }
+
+    return addressBuffer;
+}
+}
+
+bool ExternalAddressResolver::is_valid_locked(
+    std::chrono::steady_clock::time_point now, uint32_t localAddress,
+    const std::string& stunServer) const {
+    if (!m_has_result || m_local_address != localAddress ||
+        m_stun_server != stunServer) {
+        return false;
+    }
+
+    const auto ttl = m_address.empty()
+                         ? std::chrono::steady_clock::duration(FAILED_TTL)
+                         : std::chrono::steady_clock::duration(RESOLVED_TTL);
+    return now - m_resolved_at < ttl;
+}
+
+std::string ExternalAddressResolver::cached_address() {
+    const auto localAddress = GameStreamClient::local_ipv4_address();
+    const auto stunServer = Settings::instance().stun_server();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!is_valid_locked(std::chrono::steady_clock::now(), localAddress,
+                         stunServer)) {
+        return "";
+    }
+    return m_address;
+}
+
+std::string ExternalAddressResolver::resolve() {
+    const auto localAddress = GameStreamClient::local_ipv4_address();
+    const auto stunServer = Settings::instance().stun_server();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (is_valid_locked(std::chrono::steady_clock::now(), localAddress,
+                        stunServer)) {
+        return m_address;
+    }
+
+    if (m_lookup_in_flight) {
+        m_lookup_finished.wait(lock, [this] { return !m_lookup_in_flight; });
+        return m_address;
+    }
+
+    m_lookup_in_flight = true;
+    lock.unlock();
+
+    run_lookup(localAddress, stunServer);
+
+    lock.lock();
+    return m_address;
+}
+
+void ExternalAddressResolver::resolve_async(Callback callback) {
+    const auto localAddress = GameStreamClient::local_ipv4_address();
+    const auto stunServer = Settings::instance().stun_server();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (is_valid_locked(std::chrono::steady_clock::now(), localAddress,
+                        stunServer)) {
+        const auto address = m_address;
+        lock.unlock();
+        callback(address);
+        return;
+    }
+
+    m_waiters.push_back(std::move(callback));
+    if (m_lookup_in_flight) {
+        return;
+    }
+
+    m_lookup_in_flight = true;
+    lock.unlock();
+
+    brls::async([this, localAddress, stunServer] {
+        run_lookup(localAddress, stunServer);
+    });
+}
+
+void ExternalAddressResolver::invalidate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_has_result = false;
+}
+
+void ExternalAddressResolver::run_lookup(uint32_t localAddress,
+                                         const std::string& stunServer) {
+    std::string stunHost;
+    unsigned short stunPort = DEFAULT_STUN_PORT;
+    split_stun_server(stunServer, stunHost, stunPort);
+
+    std::string address;
+    unsigned int wanAddress = 0;
+    const int err =
+        LiFindExternalAddressIP4(stunHost.c_str(), stunPort, &wanAddress);
+    if (err != 0) {
+        Logger::error("Failed to get remote IPv4 address over STUN ({}): {}",
+                      stunServer, err);
+    } else {
+        address = format_ipv4(wanAddress);
+    }
+
+    std::vector<Callback> waiters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_has_result = true;
+        m_address = address;
+        m_local_address = localAddress;
+        m_stun_server = stunServer;
+        m_resolved_at = std::chrono::steady_clock::now();
+        m_lookup_in_flight = false;
+        waiters.swap(m_waiters);
+    }
+    m_lookup_finished.notify_all();
+
+    for (const auto& waiter : waiters) {
+        waiter(address);
+    }
+}
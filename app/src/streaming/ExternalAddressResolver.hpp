@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Singleton.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide STUN lookup of our WAN IPv4 address.
+// Concurrent callers share a single in-flight request, the result is cached
+// for a TTL and dropped as soon as the local IP address changes.
+class ExternalAddressResolver : public Singleton<ExternalAddressResolver> {
+  public:
+    using Callback = std::function<void(const std::string&)>;
+
+    // Cached address if it is still valid, empty string otherwise.
+    // Never touches the network.
+    std::string cached_address();
+
+    // Blocks until the address is known, joining a running lookup if any.
+    std::string resolve();
+
+    // Returns immediately, callback is called from a worker thread
+    // (or inline when the cached value is still valid).
+    void resolve_async(Callback callback);
+
+    void invalidate();
+
+  private:
+    bool is_valid_locked(std::chrono::steady_clock::time_point now,
+                         uint32_t localAddress,
+                         const std::string& stunServer) const;
+    void run_lookup(uint32_t localAddress, const std::string& stunServer);
+
+    std::mutex m_mutex;
+    std::condition_variable m_lookup_finished;
+    bool m_lookup_in_flight = false;
+    std::vector<Callback> m_waiters;
+
+    bool m_has_result = false;
+    std::string m_address;
+    uint32_t m_local_address = 0;
+    std::string m_stun_server;
+    std::chrono::steady_clock::time_point m_resolved_at;
+};
@@ -1,15 +1,25 @@
 #include "GameStreamClient.hpp"
+#include "ExternalAddressResolver.hpp"
+#include "HostMonitor.hpp"
+#include "HostStateCache.hpp"
 #include "Settings.hpp"
 #include "WakeOnLanManager.hpp"
+#include "http.h"
 #include <borealis.hpp>
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <thread>
 #include <vector>
 
 #include <curl/curl.h>
-#include <libretro-common/retro_timers.h>
 #include <cstring>
 
 #if defined(_WIN32)
@@ -18,6 +28,7 @@
 #else
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #endif
@@ -48,14 +59,6 @@ extern "C" {
 using namespace brls;
 
 namespace {
-void rebind_server_info(SERVER_DATA& server) {
-    server.serverInfo.address = server.address.c_str();
-    server.serverInfo.serverInfoAppVersion =
-        server.serverInfoAppVersion.c_str();
-    server.serverInfo.serverInfoGfeVersion =
-        server.serverInfoGfeVersion.c_str();
-}
-
 std::string host_key(const Host& host) {
     if (!host.mac.empty()) {
         return "mac:" + host.mac;
@@ -124,43 +127,259 @@ std::string ipv4_port_suffix(const std::string& address) {
     return address.substr(firstColon);
 }
 
+bool can_have_external_address(const std::string& address) {
+    const auto localAddress = strip_ipv4_port(address);
+    return localAddress.empty() || is_ipv4_address(localAddress);
+}
+
+std::string with_port_suffix(const std::string& externalAddress,
+                             const std::string& localAddress) {
+    if (externalAddress.empty()) {
+        return "";
+    }
+
+    return externalAddress + ipv4_port_suffix(localAddress);
+}
+
+// Head start the preferred address gets before the next one is tried
+constexpr auto CONNECT_ATTEMPT_STAGGER = std::chrono::milliseconds(300);
+
+struct ConnectionRace {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic_bool cancelled = false;
+    size_t running = 0;
+    bool finished = false;
+    std::string winnerAddress;
+    SERVER_DATA winnerServer;
+    std::string lastError;
+};
+
+std::string current_network_key() {
+    const uint32_t address = GameStreamClient::local_ipv4_address();
+    if (address == 0) {
+        return "";
+    }
+
+    // The /24 we are on is enough to tell home from away
+    return fmt::format("{}.{}.{}", address & 0xFF, (address >> 8) & 0xFF,
+                       (address >> 16) & 0xFF);
+}
+
+std::vector<std::string> order_by_network_preference(
+    const std::vector<std::string>& addresses,
+    const std::string& preferenceKey) {
+    std::vector<std::string> ordered;
+    for (const auto& address : addresses) {
+        if (!address.empty() &&
+            std::find(ordered.begin(), ordered.end(), address) == ordered.end()) {
+            ordered.push_back(address);
+        }
+    }
+
+    if (!preferenceKey.empty()) {
+        const auto preferred = Settings::instance().preferred_connection_address(
+            current_network_key(), preferenceKey);
+        auto it = std::find(ordered.begin(), ordered.end(), preferred);
+        if (it != ordered.end()) {
+            std::rotate(ordered.begin(), it, it + 1);
+        }
+    }
+
+    return ordered;
+}
+
+// Happy eyeballs: the preferred address starts right away, every next one
+// after CONNECT_ATTEMPT_STAGGER (or as soon as all running attempts failed).
+// The first SERVER_DATA wins and the remaining requests are aborted.
 bool connect_to_addresses_sync(const std::vector<std::string>& addresses,
+                               const std::string& preferenceKey,
                                std::string& connectedAddress,
                                SERVER_DATA& connectedServer,
                                std::string& error) {
-    if (std::none_of(addresses.begin(), addresses.end(),
-                     [](const std::string& address) {
-                         return !address.empty();
-                     })) {
+    const auto ordered = order_by_network_preference(addresses, preferenceKey);
+    if (ordered.empty()) {
         error = "Address is Empty";
         return false;
     }
 
-    error = "Address is Empty";
     connectedAddress.clear();
     connectedServer = SERVER_DATA{};
 
-    for (const auto& address : addresses) {
-        if (address.empty()) {
-            continue;
-        }
+    auto race = std::make_shared<ConnectionRace>();
+    std::unique_lock<std::mutex> lock(race->mutex);
+
+    for (size_t i = 0; i < ordered.size(); i++) {
+        race->running++;
+        std::thread([race, address = ordered[i]] {
+            http_set_cancel_flag(&race->cancelled);
+            SERVER_DATA serverData{};
+            const int status = gs_init(&serverData, address);
+            const auto attemptError = status == GS_OK ? "" : gs_error();
+            http_set_cancel_flag(nullptr);
+
+            std::lock_guard<std::mutex> lock(race->mutex);
+            race->running--;
+            if (status == GS_OK && !race->finished) {
+                race->finished = true;
+                race->winnerAddress = address;
+                race->winnerServer = serverData;
+                race->cancelled = true;
+            } else if (status != GS_OK && !race->cancelled) {
+                race->lastError = attemptError;
+            }
+            race->changed.notify_all();
+        }).detach();
 
-        SERVER_DATA serverData{};
-        const int status = gs_init(&serverData, address);
-        if (status == GS_OK) {
-            connectedAddress = address;
-            connectedServer = serverData;
-            return true;
+        if (i + 1 < ordered.size()) {
+            race->changed.wait_for(lock, CONNECT_ATTEMPT_STAGGER, [&race] {
+                return race->finished || race->running == 0;
+            });
+            if (race->finished) {
+                break;
+            }
         }
+    }
+
+    race->changed.wait(lock, [&race] {
+        return race->finished || race->running == 0;
+    });
+
+    if (!race->finished) {
+        error = race->lastError.empty() ? "Address is Empty" : race->lastError;
+        return false;
+    }
+
+    connectedAddress = race->winnerAddress;
+    connectedServer = race->winnerServer;
+    lock.unlock();
+
+    if (!preferenceKey.empty()) {
+        Settings::instance().set_preferred_connection_address(
+            current_network_key(), preferenceKey, connectedAddress);
+    }
+    return true;
+}
+
+constexpr auto WAKE_TIMEOUT = std::chrono::seconds(90);
+constexpr auto WAKE_PROBE_INTERVAL = std::chrono::milliseconds(500);
+
+// TCP-connects to every address at once, true as soon as one answers
+struct ReachabilityProbe {
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t running = 0;
+    bool reachable = false;
+};
+
+bool any_address_reachable(const std::vector<std::string>& addresses) {
+    auto probe = std::make_shared<ReachabilityProbe>();
+    std::unique_lock<std::mutex> lock(probe->mutex);
+
+    // Probes still running after the first answer finish on their own
+    for (const auto& address : addresses) {
+        probe->running++;
+        std::thread([probe, address] {
+            const bool reachable = HostMonitor::is_reachable(address);
+
+            std::lock_guard<std::mutex> lock(probe->mutex);
+            probe->running--;
+            probe->reachable = probe->reachable || reachable;
+            probe->changed.notify_all();
+        }).detach();
+    }
+
+    probe->changed.wait(lock, [&probe] {
+        return probe->reachable || probe->running == 0;
+    });
+    return probe->reachable;
+}
+
+// Server data goes out of date quickly (the running game changes),
+// app lists rarely do
+constexpr auto SERVER_INFO_MAX_AGE = std::chrono::seconds(5);
+constexpr auto SERVER_INFO_MAX_STALE = std::chrono::minutes(2);
+constexpr auto APPLIST_MAX_AGE = std::chrono::minutes(2);
+constexpr auto APPLIST_MAX_STALE = std::chrono::hours(1);
+
+using ServerInfoCache = ResponseCache<GSResult<SERVER_DATA>>;
+using AppListCache = ResponseCache<GSResult<AppInfoList>>;
+
+std::string server_info_cache_key(const std::vector<std::string>& addresses,
+                                  const std::string& activeKey) {
+    if (!activeKey.empty()) {
+        return ServerInfoCache::key(activeKey, "serverinfo");
+    }
+
+    std::string joined;
+    for (const auto& address : addresses) {
+        joined += joined.empty() ? address : "," + address;
+    }
+    return ServerInfoCache::key(joined, "serverinfo");
+}
 
-        error = gs_error();
+// Logs wall-clock time and HTTP traffic of one client flow. The HTTP
+// counters are process-wide, flows running at the same time see each
+// other's requests.
+class FlowMeasurement {
+  public:
+    explicit FlowMeasurement(std::string name)
+        : m_name(std::move(name)), m_http(http_stats()),
+          m_started(std::chrono::steady_clock::now()) {}
+
+    ~FlowMeasurement() {
+        const auto http = http_stats();
+        const auto elapsed =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - m_started);
+        brls::Logger::info(
+            "GameStreamClient: {} took {} ms, {} request(s) ({} failed, {} "
+            "cancelled), {} bytes, {} ms in HTTP",
+            m_name, elapsed.count(), http.requests - m_http.requests,
+            http.failures - m_http.failures, http.cancelled - m_http.cancelled,
+            http.bytes - m_http.bytes,
+            (http.microseconds - m_http.microseconds) / 1000);
     }
 
-    return false;
+  private:
+    std::string m_name;
+    HTTPStats m_http;
+    std::chrono::steady_clock::time_point m_started;
+};
+
+void log_cache_stats(const std::string& name, const ResponseCacheStats& stats) {
+    brls::Logger::debug("GameStreamClient: {} cache hits {}, misses {}, "
+                        "coalesced {}",
+                        name, stats.hits, stats.misses, stats.coalesced);
 }
 
-constexpr int WAKE_POLL_ATTEMPTS = 20;
-constexpr auto WAKE_POLL_INTERVAL = std::chrono::seconds(1);
+GSResult<AppInfoList> load_applist(SERVER_DATA& server) {
+    PAPP_LIST list;
+
+    int status = gs_applist(&server, &list);
+    if (status != GS_OK) {
+        return GSResult<AppInfoList>::failure(gs_error());
+    }
+
+    AppInfoList app_list;
+
+    while (list) {
+        std::string name = std::string(list->name);
+        int id = list->id;
+        AppInfo info;
+        info.name = name;
+        info.app_id = id;
+        app_list.push_back(info);
+        list = list->next;
+    }
+
+    std::sort(app_list.begin(), app_list.end(),
+              [](const AppInfo& a, const AppInfo& b) {
+                  return a.name < b.name;
+              });
+
+    return GSResult<AppInfoList>::success(app_list);
+}
 
 #if defined(__linux) || defined(__APPLE__)
 bool copy_interface_name(struct ifreq& request, const char* interfaceName) {
@@ -321,36 +540,41 @@ std::vector<std::string> GameStreamClient::host_addresses_for_find() {
     return addresses;
 }
 
-std::string GameStreamClient::external_address_for_mdns(const std::string& address) {
-    const auto localAddress = strip_ipv4_port(address);
-    if (!localAddress.empty() && !is_ipv4_address(localAddress)) {
-        return "";
-    }
+uint32_t GameStreamClient::local_ipv4_address() {
+    return get_my_ip_address();
+}
 
-    unsigned int wanAddress = 0;
-    const int err =
-        LiFindExternalAddressIP4("stun.moonlight-stream.org", 3478, &wanAddress);
-    if (err != 0) {
-        Logger::error("Failed to get remote IPv4 address over STUN: {}", err);
+std::string GameStreamClient::external_address_for_mdns(const std::string& address) {
+    if (!can_have_external_address(address)) {
         return "";
     }
 
-    in_addr externalAddr{};
-    externalAddr.s_addr = wanAddress;
+    return with_port_suffix(ExternalAddressResolver::instance().resolve(),
+                            address);
+}
 
-    char addressBuffer[INET_ADDRSTRLEN] = {};
-    if (inet_ntop(AF_INET, &externalAddr, addressBuffer, sizeof(addressBuffer)) == nullptr) {
-        Logger::error("Failed to format remote IPv4 address returned by STUN");
+std::string GameStreamClient::cached_external_address_for_mdns(
+    const std::string& address) {
+    if (!can_have_external_address(address)) {
         return "";
     }
 
-    std::string externalAddress = addressBuffer;
-    const auto portSuffix = ipv4_port_suffix(address);
-    if (!portSuffix.empty()) {
-        externalAddress += portSuffix;
+    return with_port_suffix(
+        ExternalAddressResolver::instance().cached_address(), address);
+}
+
+void GameStreamClient::resolve_external_address_for_mdns(
+    const std::string& address,
+    const std::function<void(const std::string&)>& callback) {
+    if (!can_have_external_address(address)) {
+        callback("");
+        return;
     }
 
-    return externalAddress;
+    ExternalAddressResolver::instance().resolve_async(
+        [address, callback](const std::string& externalAddress) {
+            callback(with_port_suffix(externalAddress, address));
+        });
 }
 
 bool GameStreamClient::can_find_host() {
@@ -364,140 +588,400 @@ bool GameStreamClient::can_find_host() {
 #ifndef MULTICAST_DISABLED
 static std::atomic_uint64_t findHostsGeneration = 0;
 
-struct MdnsSearchContext {
-    std::string foundHost;
+namespace {
+class DiscoveredHosts {
+  public:
+    std::vector<Host> merge(const Host& host) {
+        std::lock_guard<std::mutex> lock(mutex);
+        merge_discovered_host(hosts, host);
+        return hosts;
+    }
+
+  private:
+    std::mutex mutex;
+    std::vector<Host> hosts;
 };
 
-std::string get_ip_str(const struct sockaddr *addr)
-{
-    char addrStr[INET6_ADDRSTRLEN];
-    if (addr->sa_family == AF_INET) {
-        inet_ntop(addr->sa_family, &((struct sockaddr_in*)addr)->sin_addr, addrStr, sizeof(addrStr));
-        unsigned short port = htons(((struct sockaddr_in*)addr)->sin_port);
-        return fmt::format("{}", addrStr);
-    }
-    else {
-        struct sockaddr_in6* sin6 = (struct sockaddr_in6*)addr;
-        inet_ntop(addr->sa_family, &sin6->sin6_addr, addrStr, sizeof(addrStr));
-        unsigned short port = ntohs(((struct sockaddr_in6*)addr)->sin6_port);
-        if (sin6->sin6_scope_id != 0) {
-            // Link-local addresses with scope IDs are special
-            return fmt::format("{}{}", addrStr, sin6->sin6_scope_id);
-        }
-        else {
-            return fmt::format("{}", addrStr);
-        }
+constexpr unsigned short DEFAULT_HTTP_PORT = 47989;
+constexpr auto MDNS_LISTEN_DURATION = std::chrono::seconds(30);
+constexpr auto MDNS_WAKEUP_INTERVAL = std::chrono::milliseconds(100);
+constexpr auto MDNS_FAILED_RETRY_INTERVAL = std::chrono::seconds(5);
+// Responders verified at once, a slow host holds back only its own worker
+constexpr size_t MDNS_MAX_VERIFIERS = 4;
+// Host record TTL recommended by RFC 6762, for responders known only by
+// their source address
+constexpr uint32_t MDNS_DEFAULT_TTL_SECONDS = 120;
+// Re-query quickly first to catch lost packets, then back off
+constexpr std::array<std::chrono::milliseconds, 6> MDNS_QUERY_SCHEDULE = {
+    std::chrono::milliseconds(0),    std::chrono::milliseconds(250),
+    std::chrono::milliseconds(1000), std::chrono::milliseconds(3000),
+    std::chrono::milliseconds(7000), std::chrono::milliseconds(15000),
+};
+
+struct MdnsAddressRecord {
+    std::string name;
+    std::string address;
+    uint32_t ttl;
+};
+
+struct MdnsServiceRecord {
+    std::string target;
+    unsigned short port;
+    uint32_t ttl;
+};
+
+struct MdnsPacketContext {
+    std::string fromAddress;
+    std::vector<MdnsAddressRecord> addressRecords;
+    std::vector<MdnsServiceRecord> serviceRecords;
+};
+
+std::string get_ipv4_str(const struct sockaddr* addr) {
+    if (addr == nullptr || addr->sa_family != AF_INET) {
+        return "";
     }
+
+    char addrStr[INET_ADDRSTRLEN] = {};
+    if (inet_ntop(AF_INET, &((const struct sockaddr_in*)addr)->sin_addr,
+                  addrStr, sizeof(addrStr)) == nullptr) {
+        return "";
+    }
+    return addrStr;
 }
 
-static int mdns_discovery_callback(int sock, const struct sockaddr* from, size_t addrlen,
-                                   mdns_entry_type_t entry, uint16_t query_id, uint16_t type,
-                                   uint16_t rclass, uint32_t ttl, const void* data, size_t size,
-                                   size_t offset, size_t length, size_t record_offset,
-                                   size_t record_length, void* user_data)
+int mdns_discovery_callback(int sock, const struct sockaddr* from, size_t addrlen,
+                            mdns_entry_type_t entry, uint16_t query_id, uint16_t type,
+                            uint16_t rclass, uint32_t ttl, const void* data, size_t size,
+                            size_t offset, size_t length, size_t record_offset,
+                            size_t record_length, void* user_data)
 {
-    auto* context = static_cast<MdnsSearchContext*>(user_data);
-    if (type == MDNS_RECORDTYPE_A) {
-        context->foundHost = get_ip_str(from);
+    auto* context = static_cast<MdnsPacketContext*>(user_data);
+    if (context->fromAddress.empty()) {
+        context->fromAddress = get_ipv4_str(from);
+    }
+
+    // TTL 0 is a goodbye packet
+    if (entry == MDNS_ENTRYTYPE_QUESTION || ttl == 0) {
+        return 0;
+    }
+
+    char nameBuffer[256];
+    size_t nameOffset = offset;
+    mdns_string_t name = mdns_string_extract(data, size, &nameOffset,
+                                             nameBuffer, sizeof(nameBuffer));
+
+    if (type == MDNS_RECORDTYPE_SRV) {
+        char targetBuffer[256];
+        mdns_record_srv_t service =
+            mdns_record_parse_srv(data, size, record_offset, record_length,
+                                  targetBuffer, sizeof(targetBuffer));
+        context->serviceRecords.push_back(
+            {std::string(service.name.str, service.name.length), service.port,
+             ttl});
+    } else if (type == MDNS_RECORDTYPE_A) {
+        struct sockaddr_in address {};
+        mdns_record_parse_a(data, size, record_offset, record_length, &address);
+        auto addressText = get_ipv4_str((const struct sockaddr*)&address);
+        if (!addressText.empty()) {
+            context->addressRecords.push_back(
+                {std::string(name.str, name.length), addressText, ttl});
+        }
     }
     return 0;
 }
 
-void GameStreamClient::find_hosts(ServerCallback<std::vector<Host>>& callback) {
-    const uint64_t generation = ++findHostsGeneration;
-    brls::async([callback, generation] {
-        auto isCancelled = [generation]() {
-            return generation != findHostsGeneration.load();
-        };
-
-        std::vector<Host> foundHosts;
-        MdnsSearchContext searchContext;
-        size_t capacity = 2048;
-        std::vector<uint8_t> buffer(capacity);
-        size_t records;
-
-        int sock = mdns_socket_open_ipv4(nullptr);
-        if (sock < 0) {
+class MdnsDiscovery : public std::enable_shared_from_this<MdnsDiscovery> {
+  public:
+    MdnsDiscovery(uint64_t generation,
+                  std::function<void(GSResult<std::vector<Host>>)> callback)
+        : m_generation(generation), m_callback(std::move(callback)) {}
+
+    void run();
+
+  private:
+    struct ResponderRecord {
+        bool verifying = false;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct PendingResponder {
+        std::string address;
+        uint32_t ttl;
+    };
+
+    [[nodiscard]] bool is_cancelled() const {
+        return m_generation != findHostsGeneration.load();
+    }
+
+    void publish(const std::vector<Host>& hostsSnapshot);
+    void fail(const std::string& error);
+    void handle_packet(const MdnsPacketContext& packet);
+    void handle_responder(const std::string& address, uint32_t ttl);
+    void verify_pending();
+    void stop_verifiers();
+    void verify(const std::string& address, uint32_t ttl);
+
+    const uint64_t m_generation;
+    const std::function<void(GSResult<std::vector<Host>>)> m_callback;
+    DiscoveredHosts m_hosts;
+    std::mutex m_records_mutex;
+    std::map<std::string, ResponderRecord> m_records;
+    // Started on demand up to MDNS_MAX_VERIFIERS, joined when run() ends
+    std::condition_variable m_pending_condition;
+    std::deque<PendingResponder> m_pending;
+    std::vector<std::thread> m_verifiers;
+    size_t m_idle_verifiers = 0;
+    bool m_stopping = false;
+};
+
+void MdnsDiscovery::publish(const std::vector<Host>& hostsSnapshot) {
+    auto self = shared_from_this();
+    brls::sync([self, hostsSnapshot] {
+        if (self->is_cancelled()) {
             return;
         }
 
-        auto closeSocket = [&sock]() {
-            if (sock >= 0) {
-                mdns_socket_close(sock);
-                sock = -1;
-            }
-        };
+        self->m_callback(GSResult<std::vector<Host>>::success(hostsSnapshot));
+    });
+}
 
-        if (isCancelled()) {
-            closeSocket();
+void MdnsDiscovery::fail(const std::string& error) {
+    auto self = shared_from_this();
+    brls::sync([self, error] {
+        if (self->is_cancelled()) {
             return;
         }
 
-        if (mdns_query_send(sock, MDNS_RECORDTYPE_PTR,
-                        MDNS_STRING_CONST("_nvstream._tcp.local"),
-                        buffer.data(), capacity, 0)) {
-            closeSocket();
-            brls::sync([callback, generation] {
-                if (generation != findHostsGeneration.load()) {
-                    return;
-                }
+        self->m_callback(GSResult<std::vector<Host>>::failure(error));
+    });
+}
 
-                callback(GSResult<std::vector<Host>>::failure(
-                        "error/unknown_error"_i18n));
-            });
-            return;
+void MdnsDiscovery::run() {
+    std::vector<int> sockets;
+    const int ipv4Socket = mdns_socket_open_ipv4(nullptr);
+    if (ipv4Socket >= 0) {
+        sockets.push_back(ipv4Socket);
+    }
+    const int ipv6Socket = mdns_socket_open_ipv6(nullptr);
+    if (ipv6Socket >= 0) {
+        sockets.push_back(ipv6Socket);
+    }
+
+    if (sockets.empty()) {
+        fail("error/unknown_error"_i18n);
+        return;
+    }
+
+    std::vector<uint8_t> buffer(4096);
+    const auto startedAt = std::chrono::steady_clock::now();
+    size_t nextQuery = 0;
+
+    while (!is_cancelled()) {
+        const auto elapsed = std::chrono::steady_clock::now() - startedAt;
+        if (elapsed >= MDNS_LISTEN_DURATION) {
+            break;
         }
 
-        int empty_cnt = 0;
-        while (!isCancelled()) {
-            searchContext.foundHost.clear();
-            records = mdns_query_recv(sock, buffer.data(), capacity, mdns_discovery_callback, &searchContext, 0);
-            if (isCancelled()) {
+        if (nextQuery < MDNS_QUERY_SCHEDULE.size() &&
+            elapsed >= MDNS_QUERY_SCHEDULE[nextQuery]) {
+            size_t sent = 0;
+            for (int sock : sockets) {
+                if (mdns_query_send(sock, MDNS_RECORDTYPE_PTR,
+                                    MDNS_STRING_CONST("_nvstream._tcp.local"),
+                                    buffer.data(), buffer.size(), 0) == 0) {
+                    sent++;
+                }
+            }
+
+            if (sent == 0 && nextQuery == 0) {
+                fail("error/unknown_error"_i18n);
                 break;
             }
 
-            if (records == 0) {
-                empty_cnt++;
-            } else {
-                empty_cnt = 0;
+            nextQuery++;
+            continue;
+        }
 
-                if (searchContext.foundHost.empty()) {
-                    continue;
-                }
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+            MDNS_WAKEUP_INTERVAL);
+        if (nextQuery < MDNS_QUERY_SCHEDULE.size()) {
+            wait = std::min(
+                wait, std::chrono::duration_cast<std::chrono::microseconds>(
+                          MDNS_QUERY_SCHEDULE[nextQuery] - elapsed));
+        }
 
-                SERVER_DATA server_data;
+        fd_set readfs;
+        FD_ZERO(&readfs);
+        int nfds = 0;
+        for (int sock : sockets) {
+            FD_SET(sock, &readfs);
+            nfds = std::max(nfds, sock + 1);
+        }
 
-                int status = gs_init(&server_data, searchContext.foundHost);
-                if (status == GS_OK) {
-                    Host host;
-                    host.address = searchContext.foundHost;
-                    host.remoteAddress =
-                        GameStreamClient::external_address_for_mdns(host.address);
-                    host.hostname = server_data.hostname;
-                    host.mac = server_data.mac;
-                    merge_discovered_host(foundHosts, host);
-
-                    auto hostsSnapshot = foundHosts;
-
-                    brls::sync([callback, hostsSnapshot, generation] {
-                        if (generation != findHostsGeneration.load()) {
-                            return;
-                        }
-
-                        callback(GSResult<std::vector<Host>>::success(hostsSnapshot));
-                    });
-                }
+        struct timeval timeout {};
+        timeout.tv_sec = (long)(wait.count() / 1000000);
+        timeout.tv_usec = (long)(wait.count() % 1000000);
+
+        if (select(nfds, &readfs, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+
+        for (int sock : sockets) {
+            if (!FD_ISSET(sock, &readfs)) {
+                continue;
             }
-            // wait 30sec after last receive
-            if (empty_cnt >= 10) {
-                break;
+
+            MdnsPacketContext packet;
+            if (mdns_query_recv(sock, buffer.data(), buffer.size(),
+                                mdns_discovery_callback, &packet, 0) > 0) {
+                handle_packet(packet);
             }
+        }
+    }
 
-            retro_sleep(500);
+    for (int sock : sockets) {
+        mdns_socket_close(sock);
+    }
+
+    stop_verifiers();
+}
+
+void MdnsDiscovery::handle_packet(const MdnsPacketContext& packet) {
+    for (const auto& record : packet.addressRecords) {
+        unsigned short port = DEFAULT_HTTP_PORT;
+        auto service = std::find_if(
+            packet.serviceRecords.begin(), packet.serviceRecords.end(),
+            [&record](const MdnsServiceRecord& service) {
+                return service.target == record.name;
+            });
+        if (service != packet.serviceRecords.end() && service->port != 0) {
+            port = service->port;
         }
 
-        closeSocket();
-    });
+        handle_responder(port == DEFAULT_HTTP_PORT
+                             ? record.address
+                             : record.address + ":" + std::to_string(port),
+                         record.ttl);
+    }
+
+    // Responders without an A record, IPv6 senders can't be used by gs_init
+    if (packet.addressRecords.empty() && !packet.serviceRecords.empty() &&
+        !packet.fromAddress.empty()) {
+        handle_responder(packet.fromAddress,
+                         std::min(packet.serviceRecords.front().ttl,
+                                  MDNS_DEFAULT_TTL_SECONDS));
+    }
+}
+
+void MdnsDiscovery::handle_responder(const std::string& address, uint32_t ttl) {
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        auto& record = m_records[address];
+        if (record.verifying || now < record.expires) {
+            return;
+        }
+        record.verifying = true;
+        m_pending.push_back({address, ttl});
+
+        // Idle verifiers pick the responder up, start another one only
+        // when every verifier is busy
+        if (m_idle_verifiers < m_pending.size() &&
+            m_verifiers.size() < MDNS_MAX_VERIFIERS) {
+            m_verifiers.emplace_back([this] { verify_pending(); });
+        }
+    }
+    m_pending_condition.notify_one();
+}
+
+void MdnsDiscovery::verify_pending() {
+    std::unique_lock<std::mutex> lock(m_records_mutex);
+    while (true) {
+        m_idle_verifiers++;
+        m_pending_condition.wait(
+            lock, [this] { return m_stopping || !m_pending.empty(); });
+        m_idle_verifiers--;
+        if (m_stopping) {
+            return;
+        }
+
+        auto responder = m_pending.front();
+        m_pending.pop_front();
+
+        lock.unlock();
+        verify(responder.address, responder.ttl);
+        lock.lock();
+    }
+}
+
+void MdnsDiscovery::stop_verifiers() {
+    std::vector<std::thread> verifiers;
+    {
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        m_stopping = true;
+        m_pending.clear();
+        verifiers.swap(m_verifiers);
+    }
+    m_pending_condition.notify_all();
+
+    // A verifier in gs_init finishes its request first
+    for (auto& verifier : verifiers) {
+        verifier.join();
+    }
+}
+
+void MdnsDiscovery::verify(const std::string& address, uint32_t ttl) {
+    SERVER_DATA server_data;
+    const int status = is_cancelled() ? GS_FAILED : gs_init(&server_data, address);
+
+    {
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        auto& record = m_records[address];
+        record.verifying = false;
+        record.expires = std::chrono::steady_clock::now() +
+                         (status == GS_OK
+                              ? std::chrono::steady_clock::duration(
+                                    std::chrono::seconds(ttl))
+                              : std::chrono::steady_clock::duration(
+                                    MDNS_FAILED_RETRY_INTERVAL));
+    }
+
+    if (status != GS_OK || is_cancelled()) {
+        return;
+    }
+
+    Host host;
+    host.address = address;
+    host.remoteAddress =
+        GameStreamClient::cached_external_address_for_mdns(host.address);
+    host.hostname = server_data.hostname;
+    host.mac = server_data.mac;
+    publish(m_hosts.merge(host));
+
+    // Show the host right away, WAN address arrives later
+    if (host.remoteAddress.empty()) {
+        auto self = shared_from_this();
+        GameStreamClient::resolve_external_address_for_mdns(
+            host.address, [self, host](const std::string& remoteAddress) {
+                if (remoteAddress.empty()) {
+                    return;
+                }
+
+                Host resolvedHost = host;
+                resolvedHost.remoteAddress = remoteAddress;
+                self->publish(self->m_hosts.merge(resolvedHost));
+            });
+    }
+}
+}
+
+void GameStreamClient::find_hosts(ServerCallback<std::vector<Host>>& callback) {
+    const uint64_t generation = ++findHostsGeneration;
+    auto discovery = std::make_shared<MdnsDiscovery>(generation, callback);
+
+    // Listener lives for MDNS_LISTEN_DURATION, keep it off the shared
+    // brls::async queue
+    std::thread([discovery] { discovery->run(); }).detach();
 }
 
 void GameStreamClient::cancel_find_hosts() {
@@ -511,7 +995,8 @@ bool GameStreamClient::can_wake_up_host(const Host& host) {
 
 void GameStreamClient::wake_up_host(const Host& host,
                                     ServerCallback<bool>& callback) {
-    brls::async([host, callback] {
+    // Can take a while, keep it off the shared brls::async worker
+    std::thread([host, callback] {
         auto result = WakeOnLanManager::wake_up_host(host);
         if (!result.isSuccess()) {
             brls::sync([callback, result] { callback(result); });
@@ -522,13 +1007,29 @@ void GameStreamClient::wake_up_host(const Host& host,
         std::string error;
         SERVER_DATA connectedServer{};
 
-        for (int attempt = 0; attempt < WAKE_POLL_ATTEMPTS; attempt++) {
-            if (connect_to_addresses_sync(host.connection_addresses(),
+        const auto startedAt = std::chrono::steady_clock::now();
+        const auto addresses = host.connection_addresses();
+
+        // Cheap TCP probes until the host answers, serverinfo only after that
+        while (std::chrono::steady_clock::now() - startedAt < WAKE_TIMEOUT) {
+            const auto probeStarted = std::chrono::steady_clock::now();
+
+            if (any_address_reachable(addresses) &&
+                connect_to_addresses_sync(addresses, host_key(host),
                                           connectedAddress, connectedServer,
                                           error)) {
                 auto& client = GameStreamClient::instance();
                 client.cache_server_data(connectedAddress, connectedServer);
-                client.m_active_addresses[host_key(host)] = connectedAddress;
+                client.set_active_address(host_key(host), connectedAddress);
+                client.m_server_info_cache.store(
+                    server_info_cache_key({}, host_key(host)),
+                    GSResult<SERVER_DATA>::success(connectedServer));
+
+                brls::Logger::info(
+                    "GameStreamClient: {} woke up after {} ms", host.hostname,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - startedAt)
+                        .count());
 
                 brls::sync([callback] {
                     callback(GSResult<bool>::success(true));
@@ -536,28 +1037,67 @@ void GameStreamClient::wake_up_host(const Host& host,
                 return;
             }
 
-            if (attempt + 1 < WAKE_POLL_ATTEMPTS) {
-                std::this_thread::sleep_for(WAKE_POLL_INTERVAL);
-            }
+            std::this_thread::sleep_until(probeStarted + WAKE_PROBE_INTERVAL);
         }
 
+        brls::Logger::warning(
+            "GameStreamClient: {} did not wake up within {} s", host.hostname,
+            std::chrono::duration_cast<std::chrono::seconds>(WAKE_TIMEOUT)
+                .count());
+
         brls::sync([callback, error] {
             callback(GSResult<bool>::failure(
                 error.empty() ? "Host did not come online after wake signal"
                               : error));
         });
-    });
+    }).detach();
+}
+
+SERVER_DATA GameStreamClient::server_data_locked(const std::string& address) {
+    auto it = m_server_data.find(address);
+    if (it == m_server_data.end()) {
+        return SERVER_DATA{};
+    }
+
+    return it->second;
 }
 
 void GameStreamClient::cache_server_data(const std::string& address,
                                          const SERVER_DATA& data) {
+    std::lock_guard<std::mutex> lock(m_server_data_mutex);
     m_server_data[address] = data;
-    rebind_server_info(m_server_data[address]);
     if (!data.mac.empty()) {
         m_active_addresses["mac:" + data.mac] = address;
     }
 }
 
+void GameStreamClient::invalidate_server_info(const std::string& address,
+                                              const SERVER_DATA& server) {
+    m_server_info_cache.invalidate_if([&](const std::string& key) {
+        const auto host = key.substr(0, key.find('|'));
+        if ((!server.mac.empty() && host == "mac:" + server.mac) ||
+            host == "address:" + address || host == "remote:" + address) {
+            return true;
+        }
+
+        // Keys of plain connects list the addresses tried
+        std::stringstream addresses(host);
+        std::string candidate;
+        while (std::getline(addresses, candidate, ',')) {
+            if (candidate == address) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+void GameStreamClient::set_active_address(const std::string& key,
+                                          const std::string& address) {
+    std::lock_guard<std::mutex> lock(m_server_data_mutex);
+    m_active_addresses[key] = address;
+}
+
 void GameStreamClient::connect_to_addresses(
     const std::vector<std::string>& addresses, const std::string& activeKey,
     ServerCallback<SERVER_DATA>& callback) {
@@ -569,28 +1109,29 @@ void GameStreamClient::connect_to_addresses(
         return;
     }
 
-    brls::async([this, addresses, activeKey, callback] {
-        std::string connectedAddress;
-        std::string error;
-        SERVER_DATA connectedServer{};
-        connect_to_addresses_sync(addresses, connectedAddress, connectedServer,
-                                  error);
-
-        brls::sync([this, callback, activeKey, connectedAddress,
-                    connectedServer, error] {
-            if (connectedAddress.empty()) {
-                callback(GSResult<SERVER_DATA>::failure(error));
-                return;
+    const auto cacheKey = server_info_cache_key(addresses, activeKey);
+
+    brls::async([this, addresses, activeKey, cacheKey, callback] {
+        const auto result = m_server_info_cache.fetch(cacheKey, [&] {
+            FlowMeasurement measurement("connect");
+            std::string connectedAddress;
+            std::string error;
+            SERVER_DATA connectedServer{};
+            if (!connect_to_addresses_sync(addresses, activeKey,
+                                           connectedAddress, connectedServer,
+                                           error)) {
+                return GSResult<SERVER_DATA>::failure(error);
             }
 
             cache_server_data(connectedAddress, connectedServer);
             if (!activeKey.empty()) {
-                m_active_addresses[activeKey] = connectedAddress;
+                set_active_address(activeKey, connectedAddress);
             }
-
-            callback(
-                GSResult<SERVER_DATA>::success(m_server_data[connectedAddress]));
+            return GSResult<SERVER_DATA>::success(connectedServer);
         });
+        log_cache_stats("serverinfo", m_server_info_cache.stats());
+
+        brls::sync([callback, result] { callback(result); });
     });
 }
 
@@ -600,6 +1141,7 @@ void GameStreamClient::connect(const std::string& address,
 }
 
 std::string GameStreamClient::active_address(const Host& host) const {
+    std::lock_guard<std::mutex> lock(m_server_data_mutex);
     if (const auto it = m_active_addresses.find(host_key(host));
         it != m_active_addresses.end() && !it->second.empty()) {
         return it->second;
@@ -610,22 +1152,60 @@ std::string GameStreamClient::active_address(const Host& host) const {
 
 void GameStreamClient::connect(const Host& host,
                                ServerCallback<SERVER_DATA>& callback) {
-    connect_to_addresses(host.connection_addresses(), host_key(host), callback);
+    connect_to_addresses(host.connection_addresses(), host_key(host),
+                         [host, callback](const GSResult<SERVER_DATA>& result) {
+                             if (result.isSuccess()) {
+                                 HostStateCache::instance().store_server(
+                                     host, result.value());
+                             }
+                             callback(result);
+                         });
+}
+
+void GameStreamClient::connect_cached(const Host& host,
+                                      ServerCallback<SERVER_DATA>& callback) {
+    const auto cacheKey = server_info_cache_key({}, host_key(host));
+
+    GSResult<SERVER_DATA> cached;
+    switch (m_server_info_cache.lookup(cacheKey, SERVER_INFO_MAX_AGE,
+                                       SERVER_INFO_MAX_STALE, cached)) {
+        case ServerInfoCache::Freshness::MISSING:
+            connect(host, callback);
+            return;
+        case ServerInfoCache::Freshness::STALE:
+            if (m_server_info_cache.should_refresh(cacheKey)) {
+                connect(host, [](const GSResult<SERVER_DATA>&) {});
+            }
+            break;
+        case ServerInfoCache::Freshness::FRESH:
+            break;
+    }
+
+    // Asynchronous like a fetch, callers may still be setting up
+    brls::sync([callback, cached] { callback(cached); });
 }
 
 void GameStreamClient::pair(const std::string& address, const std::string& pin,
                             ServerCallback<bool>& callback) {
     with_cached_server_data<bool>(
         address, "Firstly call connect()...", callback,
-        [this, pin](const std::string& cachedAddress,
+        [this, pin](const std::string& cachedAddress, SERVER_DATA server,
                     ServerCallback<bool>& callback) {
-            int status = gs_pair(&m_server_data[cachedAddress], (char*)pin.c_str());
+            FlowMeasurement measurement("pair");
+            int status = gs_pair(&server, (char*)pin.c_str());
+            if (status == GS_OK) {
+                cache_server_data(cachedAddress, server);
+                invalidate_server_info(cachedAddress, server);
+                m_applist_cache.invalidate(cachedAddress + "|");
+            }
+
+            const std::string error = status == GS_OK ? "" : gs_error();
 
-            brls::sync([callback, status] {
+            brls::sync([callback, status, error] {
                 if (status == GS_OK) {
                     callback(GSResult<bool>::success(true));
                 } else {
-                    callback(GSResult<bool>::failure(gs_error()));
+                    callback(GSResult<bool>::failure(error));
                 }
             });
         });
@@ -636,69 +1216,76 @@ void GameStreamClient::pair(const Host& host, const std::string& pin,
     pair(active_address(host), pin, callback);
 }
 
-void GameStreamClient::applist(const std::string& address,
-                               ServerCallback<AppInfoList>& callback) {
+void GameStreamClient::fetch_applist(const std::string& address,
+                                     const std::string& key,
+                                     ServerCallback<AppInfoList>& callback) {
     with_cached_server_data<AppInfoList>(
         address, "Firstly call connect() & pair()...", callback,
-        [this](const std::string& cachedAddress,
-               ServerCallback<AppInfoList>& callback) {
-            PAPP_LIST list;
-
-            int status = gs_applist(&m_server_data[cachedAddress], &list);
-            if (status != CURLE_OK) {
-                brls::sync([callback] {
-                    callback(GSResult<AppInfoList>::failure(gs_error()));
+        [this, key](const std::string& cachedAddress, SERVER_DATA server,
+                    ServerCallback<AppInfoList>& callback) {
+            const auto result = m_applist_cache.fetch(
+                key, [&server] {
+                    FlowMeasurement measurement("applist");
+                    return load_applist(server);
                 });
-                return;
-            }
+            log_cache_stats("applist", m_applist_cache.stats());
+
+            brls::sync([callback, result] { callback(result); });
+        });
+}
 
-            AppInfoList app_list;
+void GameStreamClient::applist(const std::string& address,
+                               ServerCallback<AppInfoList>& callback) {
+    const auto key = AppListCache::key(address, "applist");
 
-            while (list) {
-                std::string name = std::string(list->name);
-                int id = list->id;
-                AppInfo info;
-                info.name = name;
-                info.app_id = id;
-                app_list.push_back(info);
-                list = list->next;
+    GSResult<AppInfoList> cached;
+    switch (m_applist_cache.lookup(key, APPLIST_MAX_AGE, APPLIST_MAX_STALE,
+                                   cached)) {
+        case AppListCache::Freshness::MISSING:
+            fetch_applist(address, key, callback);
+            return;
+        case AppListCache::Freshness::STALE:
+            if (m_applist_cache.should_refresh(key)) {
+                fetch_applist(address, key,
+                              [](const GSResult<AppInfoList>&) {});
             }
+            break;
+        case AppListCache::Freshness::FRESH:
+            break;
+    }
 
-            std::sort(app_list.begin(), app_list.end(),
-                      [](const AppInfo& a, const AppInfo& b) {
-                          return a.name < b.name;
-                      });
-
-            brls::sync([app_list, callback, status] {
-                if (status == GS_OK) {
-                    callback(GSResult<AppInfoList>::success(app_list));
-                } else {
-                    callback(GSResult<AppInfoList>::failure(gs_error()));
-                }
-            });
-        });
+    // Asynchronous like a fetch, callers may still be setting up
+    brls::sync([callback, cached] { callback(cached); });
 }
 
 void GameStreamClient::applist(const Host& host,
                                ServerCallback<AppInfoList>& callback) {
-    applist(active_address(host), callback);
+    applist(active_address(host),
+            [host, callback](const GSResult<AppInfoList>& result) {
+                if (result.isSuccess()) {
+                    HostStateCache::instance().store_apps(host,
+                                                          result.value());
+                }
+                callback(result);
+            });
 }
 
 void GameStreamClient::app_boxart(const std::string& address, int app_id,
                                   ServerCallback<Data>& callback) {
     with_cached_server_data<Data>(
         address, "Firstly call connect() & pair()...", callback,
-        [this, app_id](const std::string& cachedAddress,
-                       ServerCallback<Data>& callback) {
+        [app_id](const std::string& cachedAddress, SERVER_DATA server,
+                 ServerCallback<Data>& callback) {
             Data data;
-            int status =
-                gs_app_boxart(&m_server_data[cachedAddress], app_id, &data);
+            int status = gs_app_boxart(&server, app_id, &data);
 
-            brls::sync([callback, data, status] {
+            const std::string error = status == GS_OK ? "" : gs_error();
+
+            brls::sync([callback, data, status, error] {
                 if (status == GS_OK) {
                     callback(GSResult<Data>::success(data));
                 } else {
-                    callback(GSResult<Data>::failure(gs_error()));
+                    callback(GSResult<Data>::failure(error));
                 }
             });
         });
@@ -716,17 +1303,22 @@ void GameStreamClient::start(const std::string& address,
 
     with_cached_server_data<STREAM_CONFIGURATION>(
         address, "Firstly call connect() & pair()...", callback,
-        [this, app_id](const std::string& cachedAddress,
+        [this, app_id](const std::string& cachedAddress, SERVER_DATA server,
                        ServerCallback<STREAM_CONFIGURATION>& callback) {
-            int status = gs_start_app(&m_server_data[cachedAddress], &m_config,
+            FlowMeasurement measurement("launch");
+            int status = gs_start_app(&server, &m_config,
                                       app_id, Settings::instance().sops(),
                                       Settings::instance().play_audio(), 0x1);
+            // The running game changed
+            invalidate_server_info(cachedAddress, server);
+
+            const std::string error = status == GS_OK ? "" : gs_error();
 
-            brls::sync([this, callback, status] {
+            brls::sync([this, callback, status, error] {
                 if (status == GS_OK) {
                     callback(GSResult<STREAM_CONFIGURATION>::success(m_config));
                 } else {
-                    callback(GSResult<STREAM_CONFIGURATION>::failure(gs_error()));
+                    callback(GSResult<STREAM_CONFIGURATION>::failure(error));
                 }
             });
         });
@@ -742,16 +1334,19 @@ void GameStreamClient::quit(const std::string& address,
                             ServerCallback<bool>& callback) {
     with_cached_server_data<bool>(
         address, "Firstly call connect() & pair()...", callback,
-        [this](const std::string& cachedAddress, ServerCallback<bool>& callback) {
-            auto server_data = m_server_data[cachedAddress];
+        [this](const std::string& cachedAddress, SERVER_DATA server,
+               ServerCallback<bool>& callback) {
+            FlowMeasurement measurement("quit");
+            int status = gs_quit_app(&server);
+            invalidate_server_info(cachedAddress, server);
 
-            int status = gs_quit_app((PSERVER_DATA)&server_data);
+            const std::string error = status == GS_OK ? "" : gs_error();
 
-            brls::sync([callback, status] {
+            brls::sync([callback, status, error] {
                 if (status == GS_OK) {
                     callback(GSResult<bool>::success(true));
                 } else {
-                    callback(GSResult<bool>::failure(gs_error()));
+                    callback(GSResult<bool>::failure(error));
                 }
             });
         });
@@ -1,10 +1,13 @@
 #include "Data.hpp"
+#include "ResponseCache.hpp"
 #include "Singleton.hpp"
 #include "Settings.hpp"
 #include "client.h"
 #include "errors.h"
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -54,7 +57,8 @@ using AppInfoList = std::vector<AppInfo>;
 class GameStreamClient : public Singleton<GameStreamClient> {
   public:
     SERVER_DATA server_data(const std::string& address) {
-        return m_server_data[address];
+        std::lock_guard<std::mutex> lock(m_server_data_mutex);
+        return server_data_locked(address);
     }
     SERVER_DATA server_data(const Host& host) {
         return server_data(active_address(host));
@@ -68,7 +72,12 @@ class GameStreamClient : public Singleton<GameStreamClient> {
     void stop();
 
     static std::vector<std::string> host_addresses_for_find();
+    static uint32_t local_ipv4_address();
     static std::string external_address_for_mdns(const std::string& address = "");
+    static std::string cached_external_address_for_mdns(const std::string& address);
+    static void resolve_external_address_for_mdns(
+        const std::string& address,
+        const std::function<void(const std::string&)>& callback);
 
     static bool can_find_host();
     static void find_hosts(ServerCallback<std::vector<Host>>& callback);
@@ -80,6 +89,10 @@ class GameStreamClient : public Singleton<GameStreamClient> {
     void connect(const std::string& address,
                  ServerCallback<SERVER_DATA>& callback);
     void connect(const Host& host, ServerCallback<SERVER_DATA>& callback);
+    // Serves the last known server data right away and refreshes it in the
+    // background. Falls back to connect() when nothing is cached yet.
+    void connect_cached(const Host& host,
+                        ServerCallback<SERVER_DATA>& callback);
     void pair(const std::string& address, const std::string& pin,
               ServerCallback<bool>& callback);
     void pair(const Host& host, const std::string& pin,
@@ -98,29 +111,58 @@ class GameStreamClient : public Singleton<GameStreamClient> {
     void quit(const std::string& address, ServerCallback<bool>& callback);
     void quit(const Host& host, ServerCallback<bool>& callback);
 
+    [[nodiscard]] ResponseCacheStats server_info_cache_stats() const {
+        return m_server_info_cache.stats();
+    }
+    [[nodiscard]] ResponseCacheStats applist_cache_stats() const {
+        return m_applist_cache.stats();
+    }
+
   private:
     template <typename T, typename Worker>
     void with_cached_server_data(const std::string& address,
                                  const std::string& missingError,
                                  ServerCallback<T>& callback,
                                  Worker&& worker) {
-        if (m_server_data.count(address) == 0) {
+        SERVER_DATA server;
+        bool cached;
+        {
+            std::lock_guard<std::mutex> lock(m_server_data_mutex);
+            cached = m_server_data.count(address) != 0;
+            if (cached) {
+                server = server_data_locked(address);
+            }
+        }
+
+        if (!cached) {
             callback(GSResult<T>::failure(missingError));
             return;
         }
 
-        brls::async([this, address, callback,
+        brls::async([address, server, callback,
                      worker = std::forward<Worker>(worker)]() mutable {
-            worker(address, callback);
+            worker(address, server, callback);
         });
     }
 
+    SERVER_DATA server_data_locked(const std::string& address);
     void cache_server_data(const std::string& address, const SERVER_DATA& data);
+    // Drops the cached serverinfo of the host at `address` after its pairing
+    // or running game changed
+    void invalidate_server_info(const std::string& address, const SERVER_DATA& server);
+    void set_active_address(const std::string& key, const std::string& address);
+    void fetch_applist(const std::string& address, const std::string& key,
+                       ServerCallback<AppInfoList>& callback);
     void connect_to_addresses(const std::vector<std::string>& addresses,
                               const std::string& activeKey,
                               ServerCallback<SERVER_DATA>& callback);
 
+    // Guards m_server_data and m_active_addresses, both are touched from
+    // brls::async workers
+    mutable std::mutex m_server_data_mutex;
     std::map<std::string, SERVER_DATA> m_server_data;
     std::map<std::string, std::string> m_active_addresses;
+    ResponseCache<GSResult<SERVER_DATA>> m_server_info_cache;
+    ResponseCache<GSResult<AppInfoList>> m_applist_cache;
     STREAM_CONFIGURATION m_config;
 };
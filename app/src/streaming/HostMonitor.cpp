@@ -0,0 +1,353 @@
+#include "HostMonitor.hpp"
+#include "GameStreamClient.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr const char* DEFAULT_HTTP_PORT = "47989";
+constexpr auto PROBE_TIMEOUT = std::chrono::milliseconds(800);
+constexpr auto ONLINE_INTERVAL = std::chrono::seconds(15);
+constexpr auto OFFLINE_MIN_INTERVAL = std::chrono::seconds(5);
+constexpr auto OFFLINE_MAX_INTERVAL = std::chrono::minutes(2);
+// Upper bound for the scheduler sleep, also picks up new hosts
+constexpr auto IDLE_WAKEUP = std::chrono::seconds(1);
+
+std::string monitor_key(const Host& host) {
+    if (!host.mac.empty()) {
+        return "mac:" + host.mac;
+    }
+    return "address:" + host.preferred_address();
+}
+
+void split_probe_address(const std::string& addressPort, std::string& address,
+                         std::string& port) {
+    address = addressPort;
+    port = DEFAULT_HTTP_PORT;
+
+    if (addressPort.front() == '[') {
+        const auto closingBracket = addressPort.find(']');
+        if (closingBracket == std::string::npos) {
+            return;
+        }
+
+        address = addressPort.substr(1, closingBracket - 1);
+        if (closingBracket + 2 < addressPort.size() &&
+            addressPort[closingBracket + 1] == ':') {
+            port = addressPort.substr(closingBracket + 2);
+        }
+        return;
+    }
+
+    const auto separator = addressPort.rfind(':');
+    if (separator != std::string::npos && addressPort.find(':') == separator &&
+        separator + 1 < addressPort.size()) {
+        address = addressPort.substr(0, separator);
+        port = addressPort.substr(separator + 1);
+    }
+}
+
+void close_probe_socket(int fd) {
+#if defined(_WIN32)
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+bool connect_with_timeout(const addrinfo* info) {
+    int fd = (int)socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd < 0) {
+        return false;
+    }
+
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    ioctlsocket(fd, FIONBIO, &nonBlocking);
+#else
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    if (connect(fd, info->ai_addr, (socklen_t)info->ai_addrlen) == 0) {
+        close_probe_socket(fd);
+        return true;
+    }
+
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+
+    timeval timeout{};
+    timeout.tv_sec = 0;
+    timeout.tv_usec =
+        std::chrono::duration_cast<std::chrono::microseconds>(PROBE_TIMEOUT)
+            .count();
+
+    bool connected = false;
+    if (select(fd + 1, nullptr, &writeSet, nullptr, &timeout) > 0) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        connected = getsockopt(fd, SOL_SOCKET, SO_ERROR, (char*)&error,
+                               &length) == 0 &&
+                    error == 0;
+    }
+
+    close_probe_socket(fd);
+    return connected;
+}
+
+bool tcp_probe(const std::string& addressPort) {
+    if (addressPort.empty()) {
+        return false;
+    }
+
+    std::string address;
+    std::string port;
+    split_probe_address(addressPort, address, port);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(address.c_str(), port.c_str(), &hints, &result) != 0) {
+        return false;
+    }
+
+    bool reachable = false;
+    for (addrinfo* info = result; info && !reachable; info = info->ai_next) {
+        reachable = connect_with_timeout(info);
+    }
+
+    freeaddrinfo(result);
+    return reachable;
+}
+
+// +-20% so hosts added together are not probed in lockstep
+std::chrono::steady_clock::duration jittered(
+    std::chrono::steady_clock::duration interval) {
+    static std::mt19937 generator(std::random_device{}());
+    std::uniform_real_distribution<double> factor(0.8, 1.2);
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        interval * factor(generator));
+}
+}
+
+HostStatus HostMonitor::status(const Host& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_hosts.find(monitor_key(host));
+    return it == m_hosts.end() ? HostStatus::UNKNOWN : it->second.status;
+}
+
+bool HostMonitor::is_reachable(const std::string& address) {
+    return tcp_probe(address);
+}
+
+void HostMonitor::set_hosts(const std::vector<Host>& hosts) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<std::string, Watched> watched;
+    for (const auto& host : hosts) {
+        const auto key = monitor_key(host);
+        auto it = m_hosts.find(key);
+        if (it != m_hosts.end()) {
+            watched[key] = it->second;
+        } else {
+            watched[key].next_probe = Clock::now();
+        }
+        watched[key].host = host;
+    }
+    m_hosts.swap(watched);
+
+    start_locked();
+    m_wakeup.notify_all();
+}
+
+void HostMonitor::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = false;
+
+    // Whatever was seen before stopping is stale by now
+    for (auto& [key, watched] : m_hosts) {
+        watched.next_probe = Clock::now();
+        watched.fetch_requested = true;
+    }
+    start_locked();
+}
+
+void HostMonitor::start_locked() {
+    if (m_stopped || m_hosts.empty() || m_thread.joinable()) {
+        return;
+    }
+
+    m_running = true;
+    m_thread = std::thread([this] { run(); });
+}
+
+void HostMonitor::stop() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        m_running = false;
+        m_wakeup.notify_all();
+        thread = std::move(m_thread);
+    }
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void HostMonitor::shutdown() {
+    stop();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wakeup.wait(lock, [this] { return m_probes_in_flight == 0; });
+}
+
+void HostMonitor::refresh(const Host& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_hosts.find(monitor_key(host));
+    if (it == m_hosts.end()) {
+        return;
+    }
+
+    it->second.fetch_requested = true;
+    it->second.next_probe = Clock::now();
+    // Asked for explicitly, e.g. after a wake, so back off from scratch
+    it->second.offline_interval = Clock::duration::zero();
+    m_wakeup.notify_all();
+}
+
+void HostMonitor::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        const auto now = Clock::now();
+        auto next = now + IDLE_WAKEUP;
+
+        for (auto& [key, watched] : m_hosts) {
+            if (watched.probing) {
+                continue;
+            }
+
+            if (watched.next_probe > now) {
+                next = std::min(next, watched.next_probe);
+                continue;
+            }
+
+            watched.probing = true;
+            const bool fetch = watched.fetch_requested;
+            watched.fetch_requested = false;
+            // Counted so shutdown() can wait for it, a probe takes at most
+            // PROBE_TIMEOUT per address
+            m_probes_in_flight++;
+            std::thread([this, key = key, host = watched.host, fetch] {
+                probe(key, host, fetch);
+            }).detach();
+        }
+
+        m_wakeup.wait_until(lock, next);
+    }
+}
+
+void HostMonitor::probe(const std::string& key, const Host& host,
+                        bool fetch) {
+    const auto addresses = host.connection_addresses();
+    const bool reachable =
+        std::any_of(addresses.begin(), addresses.end(), tcp_probe);
+    finish_probe(key, reachable, fetch);
+
+    // Last touch of the monitor from this thread
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_probes_in_flight--;
+    m_wakeup.notify_all();
+}
+
+void HostMonitor::finish_probe(const std::string& key, bool reachable,
+                               bool fetch) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_hosts.find(key);
+    if (it == m_hosts.end()) {
+        return;
+    }
+
+    auto& watched = it->second;
+    watched.probing = false;
+
+    // Stopped while probing, start() probes again anyway
+    if (!m_running) {
+        return;
+    }
+
+    if (reachable) {
+        const bool wasOnline = watched.status == HostStatus::ONLINE ||
+                               watched.status == HostStatus::STREAMING;
+        watched.offline_interval = Clock::duration::zero();
+        watched.next_probe = Clock::now() + jittered(ONLINE_INTERVAL);
+
+        if (!wasOnline || fetch) {
+            const auto host = watched.host;
+            lock.unlock();
+            fetch_server_info(key, host);
+        }
+        return;
+    }
+
+    watched.offline_interval =
+        watched.offline_interval == Clock::duration::zero()
+            ? Clock::duration(OFFLINE_MIN_INTERVAL)
+            : std::min<Clock::duration>(watched.offline_interval * 2,
+                                        OFFLINE_MAX_INTERVAL);
+    watched.next_probe = Clock::now() + jittered(watched.offline_interval);
+
+    if (watched.status != HostStatus::OFFLINE || fetch) {
+        lock.unlock();
+        brls::sync([this, key] { publish(key, HostStatus::OFFLINE); });
+    }
+}
+
+void HostMonitor::fetch_server_info(const std::string& key, const Host& host) {
+    brls::sync([this, key, host] {
+        GameStreamClient::instance().connect(
+            host, [this, key](const GSResult<SERVER_DATA>& result) {
+                if (!result.isSuccess()) {
+                    publish(key, HostStatus::OFFLINE);
+                } else if (result.value().currentGame != 0) {
+                    publish(key, HostStatus::STREAMING);
+                } else {
+                    publish(key, HostStatus::ONLINE);
+                }
+            });
+    });
+}
+
+void HostMonitor::publish(const std::string& key, HostStatus status) {
+    HostStatusUpdate update;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_hosts.find(key);
+        if (it == m_hosts.end()) {
+            return;
+        }
+
+        it->second.status = status;
+        update.host = it->second.host;
+        update.status = status;
+    }
+
+    m_status_event.fire(update);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Settings.hpp"
+#include "Singleton.hpp"
+#include <borealis.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class HostStatus { UNKNOWN, ONLINE, OFFLINE, STREAMING };
+
+struct HostStatusUpdate {
+    Host host;
+    HostStatus status;
+};
+
+// Watches saved hosts with cheap TCP connects to their HTTP port.
+// serverinfo is only fetched when a host comes online or on refresh(),
+// offline hosts are probed less and less often.
+// The status event always fires on the UI thread.
+class HostMonitor : public Singleton<HostMonitor> {
+  public:
+    brls::Event<HostStatusUpdate>* status_event() { return &m_status_event; }
+
+    HostStatus status(const Host& host);
+
+    // Replaces the monitored hosts and starts the probe thread if needed
+    void set_hosts(const std::vector<Host>& hosts);
+
+    // Stops probing, e.g. while streaming, until start() is called again.
+    // Probes already in flight are discarded.
+    void stop();
+    void start();
+    // stop() that also waits for probes in flight, before exiting
+    void shutdown();
+
+    // Probes the host right away and fetches its serverinfo
+    void refresh(const Host& host);
+
+    // Blocking TCP connect to the HTTP port of address ("host[:port]")
+    static bool is_reachable(const std::string& address);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Watched {
+        Host host;
+        HostStatus status = HostStatus::UNKNOWN;
+        Clock::time_point next_probe;
+        Clock::duration offline_interval{};
+        bool probing = false;
+        bool fetch_requested = false;
+    };
+
+    void start_locked();
+    void run();
+    void probe(const std::string& key, const Host& host, bool fetch);
+    void finish_probe(const std::string& key, bool reachable, bool fetch);
+    void fetch_server_info(const std::string& key, const Host& host);
+    void publish(const std::string& key, HostStatus status);
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::map<std::string, Watched> m_hosts;
+    bool m_running = false;
+    bool m_stopped = false;
+    int m_probes_in_flight = 0;
+    std::thread m_thread;
+
+    brls::Event<HostStatusUpdate> m_status_event;
+};
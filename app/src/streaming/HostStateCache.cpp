@@ -0,0 +1,285 @@
+#include "HostStateCache.hpp"
+#include <borealis.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+namespace fs = std::filesystem;
+
+constexpr uint32_t RECORD_MAGIC = 0x4348534d; // "MSHC"
+constexpr uint32_t RECORD_VERSION = 1;
+constexpr uint32_t MAX_APPS = 100000;
+
+class RecordWriter {
+  public:
+    void u32(uint32_t value) { raw(&value, sizeof(value)); }
+    void i32(int32_t value) { raw(&value, sizeof(value)); }
+
+    void string(const std::string& value) {
+        u32((uint32_t)value.size());
+        raw(value.data(), value.size());
+    }
+
+    const std::string& bytes() const { return m_bytes; }
+
+  private:
+    void raw(const void* data, size_t size) {
+        m_bytes.append(static_cast<const char*>(data), size);
+    }
+
+    std::string m_bytes;
+};
+
+class RecordReader {
+  public:
+    explicit RecordReader(const std::string& bytes) : m_bytes(bytes) {}
+
+    bool u32(uint32_t& value) { return raw(&value, sizeof(value)); }
+    bool i32(int32_t& value) { return raw(&value, sizeof(value)); }
+
+    bool string(std::string& value) {
+        uint32_t size = 0;
+        if (!u32(size) || size > m_bytes.size() - m_offset) {
+            return false;
+        }
+        value.assign(m_bytes, m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+  private:
+    bool raw(void* data, size_t size) {
+        if (size > m_bytes.size() - m_offset) {
+            return false;
+        }
+        std::memcpy(data, m_bytes.data() + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+    const std::string& m_bytes;
+    size_t m_offset = 0;
+};
+
+enum RecordFlags : uint32_t {
+    HAS_SERVER = 1 << 0,
+    HAS_APPS = 1 << 1,
+    PAIRED = 1 << 2,
+    SUPPORTS_4K = 1 << 3,
+};
+
+std::string encode(const HostSnapshot& snapshot) {
+    RecordWriter writer;
+    writer.u32(RECORD_MAGIC);
+    writer.u32(RECORD_VERSION);
+
+    const auto& server = snapshot.server;
+    uint32_t flags = 0;
+    if (snapshot.has_server)
+        flags |= HAS_SERVER;
+    if (snapshot.has_apps)
+        flags |= HAS_APPS;
+    if (server.paired)
+        flags |= PAIRED;
+    if (server.supports4K)
+        flags |= SUPPORTS_4K;
+    writer.u32(flags);
+
+    writer.string(server.address);
+    writer.string(server.serverInfoAppVersion);
+    writer.string(server.serverInfoGfeVersion);
+    writer.string(server.mac);
+    writer.string(server.gpuType);
+    writer.string(server.gsVersion);
+    writer.string(server.hostname);
+    writer.i32(server.currentGame);
+    writer.i32(server.serverMajorVersion);
+    writer.i32(server.serverInfo.serverCodecModeSupport);
+    writer.u32(server.httpPort);
+    writer.u32(server.httpsPort);
+
+    writer.u32((uint32_t)snapshot.apps.size());
+    for (const auto& app : snapshot.apps) {
+        writer.i32(app.app_id);
+        writer.string(app.name);
+    }
+    return writer.bytes();
+}
+
+bool decode(const std::string& bytes, HostSnapshot& snapshot) {
+    RecordReader reader(bytes);
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t flags = 0;
+    if (!reader.u32(magic) || magic != RECORD_MAGIC || !reader.u32(version) ||
+        version != RECORD_VERSION || !reader.u32(flags)) {
+        return false;
+    }
+
+    auto& server = snapshot.server;
+    int32_t codecModeSupport = 0;
+    uint32_t httpPort = 0;
+    uint32_t httpsPort = 0;
+    if (!reader.string(server.address) ||
+        !reader.string(server.serverInfoAppVersion) ||
+        !reader.string(server.serverInfoGfeVersion) ||
+        !reader.string(server.mac) || !reader.string(server.gpuType) ||
+        !reader.string(server.gsVersion) || !reader.string(server.hostname) ||
+        !reader.i32(server.currentGame) ||
+        !reader.i32(server.serverMajorVersion) ||
+        !reader.i32(codecModeSupport) || !reader.u32(httpPort) ||
+        !reader.u32(httpsPort)) {
+        return false;
+    }
+    server.serverInfo.serverCodecModeSupport = codecModeSupport;
+    server.httpPort = (unsigned short)httpPort;
+    server.httpsPort = (unsigned short)httpsPort;
+    server.paired = flags & PAIRED;
+    server.supports4K = flags & SUPPORTS_4K;
+
+    uint32_t count = 0;
+    if (!reader.u32(count) || count > MAX_APPS) {
+        return false;
+    }
+
+    snapshot.apps.resize(count);
+    for (auto& app : snapshot.apps) {
+        int32_t appId = 0;
+        if (!reader.i32(appId) || !reader.string(app.name)) {
+            return false;
+        }
+        app.app_id = appId;
+    }
+
+    snapshot.has_server = flags & HAS_SERVER;
+    snapshot.has_apps = flags & HAS_APPS;
+    return true;
+}
+
+bool same_apps(const AppInfoList& l, const AppInfoList& r) {
+    return std::equal(l.begin(), l.end(), r.begin(), r.end(),
+                      [](const AppInfo& a, const AppInfo& b) {
+                          return a.app_id == b.app_id && a.name == b.name;
+                      });
+}
+
+bool same_server(const SERVER_DATA& l, const SERVER_DATA& r) {
+    return l.address == r.address && l.mac == r.mac &&
+           l.hostname == r.hostname && l.paired == r.paired &&
+           l.currentGame == r.currentGame &&
+           l.serverInfoAppVersion == r.serverInfoAppVersion &&
+           l.serverInfoGfeVersion == r.serverInfoGfeVersion &&
+           l.gpuType == r.gpuType && l.gsVersion == r.gsVersion &&
+           l.supports4K == r.supports4K &&
+           l.serverInfo.serverCodecModeSupport ==
+               r.serverInfo.serverCodecModeSupport &&
+           l.httpPort == r.httpPort && l.httpsPort == r.httpsPort;
+}
+}
+
+std::string HostStateCache::record_path(const Host& host) {
+    std::string name = !host.mac.empty() ? host.mac : host.preferred_address();
+    for (auto& c : name) {
+        if (!std::isalnum((unsigned char)c)) {
+            c = '_';
+        }
+    }
+
+    return (fs::path(Settings::instance().host_cache_dir()) / (name + ".bin"))
+        .string();
+}
+
+HostSnapshot& HostStateCache::snapshot_locked(const Host& host) {
+    const auto path = record_path(host);
+    auto it = m_snapshots.find(path);
+    if (it != m_snapshots.end()) {
+        return it->second;
+    }
+
+    HostSnapshot snapshot;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (file) {
+        std::string bytes(size_t(file.tellg()), '\0');
+        file.seekg(0);
+        if (!file.read(bytes.data(), (std::streamsize)bytes.size()) ||
+            !decode(bytes, snapshot)) {
+            brls::Logger::warning("HostStateCache: Ignoring broken record {}",
+                                  path);
+            snapshot = HostSnapshot();
+        }
+    }
+
+    return m_snapshots[path] = snapshot;
+}
+
+bool HostStateCache::load(const Host& host, HostSnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    snapshot = snapshot_locked(host);
+    return snapshot.has_server || snapshot.has_apps;
+}
+
+void HostStateCache::store_server(const Host& host, const SERVER_DATA& server) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& snapshot = snapshot_locked(host);
+    if (snapshot.has_server && same_server(snapshot.server, server)) {
+        return;
+    }
+
+    snapshot.has_server = true;
+    snapshot.server = server;
+    // Its pointers refer to the live SERVER_DATA strings
+    snapshot.server.serverInfo = SERVER_INFORMATION{};
+    snapshot.server.serverInfo.serverCodecModeSupport =
+        server.serverInfo.serverCodecModeSupport;
+    schedule_write(host);
+}
+
+void HostStateCache::store_apps(const Host& host, const AppInfoList& apps) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& snapshot = snapshot_locked(host);
+    if (snapshot.has_apps && same_apps(snapshot.apps, apps)) {
+        return;
+    }
+
+    snapshot.has_apps = true;
+    snapshot.apps = apps;
+    schedule_write(host);
+}
+
+void HostStateCache::schedule_write(const Host& host) {
+    brls::async([this, host] {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+
+        // Encoded when written, so writes finishing out of order still leave
+        // the latest snapshot on disk
+        std::string bytes;
+        {
+            std::lock_guard<std::mutex> snapshotLock(m_mutex);
+            bytes = encode(snapshot_locked(host));
+        }
+
+        const auto path = record_path(host);
+
+        const auto temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(bytes.data(), (std::streamsize)bytes.size());
+            if (!file) {
+                brls::Logger::error("HostStateCache: Failed to write {}",
+                                    temporary);
+                return;
+            }
+        }
+
+        std::error_code error;
+        fs::rename(temporary, path, error);
+        if (error) {
+            brls::Logger::error("HostStateCache: Failed to replace {}: {}",
+                                path, error.message());
+        }
+    });
+}
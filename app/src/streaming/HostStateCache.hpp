@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GameStreamClient.hpp"
+#include "Settings.hpp"
+#include "Singleton.hpp"
+#include <map>
+#include <mutex>
+#include <string>
+
+// What a host looked like the last time it answered
+struct HostSnapshot {
+    bool has_server = false;
+    // Display data only: serverInfo is not rebound, never pass it to gs_*
+    SERVER_DATA server{};
+    bool has_apps = false;
+    AppInfoList apps;
+};
+
+// Last serverinfo and app list per host, persisted so the host tabs and the
+// app list can be painted right after launch. Anything loaded from here is
+// stale until live data replaces it.
+//
+// One compact binary record per host in host_cache_dir(), read with a single
+// read and rewritten in the background only when the data changed.
+class HostStateCache : public Singleton<HostStateCache> {
+  public:
+    bool load(const Host& host, HostSnapshot& snapshot);
+
+    void store_server(const Host& host, const SERVER_DATA& server);
+    void store_apps(const Host& host, const AppInfoList& apps);
+
+  private:
+    static std::string record_path(const Host& host);
+
+    HostSnapshot& snapshot_locked(const Host& host);
+    void schedule_write(const Host& host);
+
+    std::mutex m_mutex;
+    std::map<std::string, HostSnapshot> m_snapshots;
+    std::mutex m_write_mutex;
+};
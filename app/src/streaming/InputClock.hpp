@@ -0,0 +1,24 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+// Time as seen by the input pipeline. A replay pins it to the recorded
+// timestamps, so rate limits and timers behave as they did when recording.
+class InputClock {
+  public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    static time_point now() {
+        return pinned ? pinnedTime : std::chrono::steady_clock::now();
+    }
+    static void pin(time_point time) {
+        pinnedTime = time;
+        pinned = true;
+    }
+    static void unpin() { pinned = false; }
+
+  private:
+    inline static std::atomic<bool> pinned = false;
+    inline static time_point pinnedTime;
+};
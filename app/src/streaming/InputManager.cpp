@@ -4,183 +4,418 @@
 #endif
 
 #include "InputManager.hpp"
+#include "InputClock.hpp"
+#include "InputSink.hpp"
 #include "Limelight.h"
 #include "Settings.hpp"
 #include <borealis.hpp>
 #include <streaming_view.hpp>
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
 
 using namespace brls;
 
 namespace {
 constexpr float STICK_SCROLL_DEADZONE = 0.2f;
+constexpr int MIN_SAMPLING_RATE = 250;
+constexpr int MAX_SAMPLING_RATE = 1000;
+constexpr int MAX_MIN_SEND_INTERVAL_MS = 50;
+// Changes up to this size against the last sent value are treated as noise
+constexpr int STICK_HYSTERESIS = 64;
+constexpr int TRIGGER_HYSTERESIS = 2;
+// Finger moves shorter than this, in content points, are not sent
+constexpr float TOUCH_MOVE_THRESHOLD = 2.0f;
+
+static_assert(brls::_BUTTON_MAX <= 64, "Controller buttons must fit a uint64_t");
+
+struct LimelightButton {
+    int flag;
+    brls::ControllerButton button;
+};
+
+// Mapped button behind every Limelight flag, guide is handled separately
+constexpr LimelightButton LIMELIGHT_BUTTONS[] = {
+    {UP_FLAG, brls::BUTTON_UP},
+    {DOWN_FLAG, brls::BUTTON_DOWN},
+    {LEFT_FLAG, brls::BUTTON_LEFT},
+    {RIGHT_FLAG, brls::BUTTON_RIGHT},
+#ifdef __SWITCH__
+    {A_FLAG, brls::BUTTON_B},
+    {B_FLAG, brls::BUTTON_A},
+    {X_FLAG, brls::BUTTON_Y},
+    {Y_FLAG, brls::BUTTON_X},
+#else
+    {A_FLAG, brls::BUTTON_A},
+    {B_FLAG, brls::BUTTON_B},
+    {X_FLAG, brls::BUTTON_X},
+    {Y_FLAG, brls::BUTTON_Y},
+#endif
+    {BACK_FLAG, brls::BUTTON_BACK},
+    {PLAY_FLAG, brls::BUTTON_START},
+    {LB_FLAG, brls::BUTTON_LB},
+    {RB_FLAG, brls::BUTTON_RB},
+    {LS_CLK_FLAG, brls::BUTTON_LSB},
+    {RS_CLK_FLAG, brls::BUTTON_RSB},
+};
+
+constexpr uint64_t buttonBit(int button) { return uint64_t(1) << button; }
+
+uint64_t comboMask(const std::vector<brls::ControllerButton>& buttons) {
+    uint64_t mask = 0;
+    for (auto button : buttons)
+        mask |= buttonBit(button);
+    return mask;
+}
+
+template <typename T>
+T applyHysteresis(T value, T sent, int threshold, int limit) {
+    // Rest and full deflection always go through, so releases are exact
+    if (value == 0 || std::abs(int(value)) >= limit)
+        return value;
+    return std::abs(int(value) - int(sent)) > threshold ? value : sent;
+}
 
 float applyStickScrollDeadzone(float axis, float configuredDeadzone) {
     float deadzone = std::fmax(STICK_SCROLL_DEADZONE, configuredDeadzone);
     return std::fabs(axis) < deadzone ? 0.f : axis;
 }
-}
 
-float fsqrt_(float f) {
-    int i = *(int *)&f;
-    i = (i >> 1) + 0x1fbb67ae;
-    float f1 = *(float *)&i;
-    return 0.5F * (f1 + f / f1);
+#ifdef __SWITCH__
+struct SwitchPadButton {
+    uint64_t hid;
+    brls::ControllerButton button;
+};
+
+constexpr SwitchPadButton SWITCH_PAD_BUTTONS[] = {
+    {HidNpadButton_ZL, brls::BUTTON_LT},
+    {HidNpadButton_L, brls::BUTTON_LB},
+    {HidNpadButton_StickL, brls::BUTTON_LSB},
+    {HidNpadButton_Up, brls::BUTTON_UP},
+    {HidNpadButton_Right, brls::BUTTON_RIGHT},
+    {HidNpadButton_Down, brls::BUTTON_DOWN},
+    {HidNpadButton_Left, brls::BUTTON_LEFT},
+    {HidNpadButton_Minus, brls::BUTTON_BACK},
+    {HidNpadButton_Plus, brls::BUTTON_START},
+    {HidNpadButton_StickR, brls::BUTTON_RSB},
+    {HidNpadButton_Y, brls::BUTTON_Y},
+    {HidNpadButton_B, brls::BUTTON_B},
+    {HidNpadButton_A, brls::BUTTON_A},
+    {HidNpadButton_X, brls::BUTTON_X},
+    {HidNpadButton_R, brls::BUTTON_RB},
+    {HidNpadButton_ZR, brls::BUTTON_RT},
+};
+
+// The sampling thread's own PadStates. padUpdate() on borealis' pads would
+// race the UI thread, which keeps updating them every frame.
+class SwitchSamplerPads {
+  public:
+    SwitchSamplerPads() {
+        padInitialize(&pads[0], HidNpadIdType_No1, HidNpadIdType_Handheld);
+        for (int i = 1; i < GAMEPADS_MAX; i++)
+            padInitialize(&pads[i], HidNpadIdType(HidNpadIdType_No1 + i));
+    }
+
+    // Connected controllers in player order, read like borealis does
+    void read(std::vector<brls::ControllerState>& controllers) {
+        controllers.clear();
+        for (auto& pad : pads) {
+            padUpdate(&pad);
+            if (!padIsConnected(&pad))
+                continue;
+
+            brls::ControllerState state{};
+            const uint64_t held = padGetButtons(&pad);
+            for (const auto& button : SWITCH_PAD_BUTTONS)
+                state.buttons[button.button] = (held & button.hid) != 0;
+
+            const HidAnalogStickState left = padGetStickPos(&pad, 0);
+            const HidAnalogStickState right = padGetStickPos(&pad, 1);
+            state.axes[brls::LEFT_X] = float(left.x) / float(JOYSTICK_MAX);
+            state.axes[brls::LEFT_Y] = -float(left.y) / float(JOYSTICK_MAX);
+            state.axes[brls::RIGHT_X] = float(right.x) / float(JOYSTICK_MAX);
+            state.axes[brls::RIGHT_Y] = -float(right.y) / float(JOYSTICK_MAX);
+            controllers.push_back(state);
+        }
+    }
 
+  private:
+    PadState pads[GAMEPADS_MAX];
+};
+#endif
 }
 
 MoonlightInputManager::MoonlightInputManager() {
+    reloadButtonMappingLayout();
+
     auto inputManager = brls::Application::getPlatform()->getInputManager();
 
     inputManager
         ->getMouseCusorOffsetChanged()
         ->subscribe([this](brls::Point offset) {
-            if (!inputEnabled) return;
-
-            if (offset.x != 0 || offset.y != 0) {
-                float multiplier =
-                        (float) Settings::instance().get_mouse_speed_multiplier() / 100.f *
-                        1.5f + 0.5f;
-
-                if (!this->inputDropped) {
-                    sendRelativeMouseMove(
-                        brls::Point(offset.x * multiplier,
-                                    offset.y * multiplier));
-                }
-            }
+            InputEvent event;
+            event.type = InputEvent::Type::MOUSE_OFFSET;
+            event.x = offset.x;
+            event.y = offset.y;
+            handlePlatformEvent(event);
         });
 
     inputManager
         ->getMouseScrollOffsetChanged()
         ->subscribe([this](brls::Point scroll) {
-            if (!inputEnabled) return;
-
-            if (scroll.x != 0) {
-                brls::Logger::info("Mouse scroll X sended: {}", scroll.x);
-                LiSendHighResHScrollEvent( short(scroll.x));
-            }
-            if (scroll.y != 0) {
-                brls::Logger::info("Mouse scroll Y sended: {}", scroll.y);
-                LiSendHighResScrollEvent( short(scroll.y));
-            }
+            InputEvent event;
+            event.type = InputEvent::Type::MOUSE_SCROLL;
+            event.x = scroll.x;
+            event.y = scroll.y;
+            handlePlatformEvent(event);
         });
 
     inputManager
         ->getKeyboardKeyStateChanged()
         ->subscribe([this](brls::KeyState state) {
-            if (!inputEnabled) return;
-
-            int vkKey = MoonlightInputManager::glfwKeyToVKKey(state.key);
-            char modifiers = state.mods;
-            LiSendKeyboardEvent(vkKey,
-                                state.pressed ? KEY_ACTION_DOWN : KEY_ACTION_UP,
-                                modifiers);
+            InputEvent event;
+            event.type = InputEvent::Type::KEY;
+            event.code = state.key;
+            event.mods = state.mods;
+            event.pressed = state.pressed;
+            handlePlatformEvent(event);
         });
 
     inputManager
         ->getControllerSensorStateChanged()
-        ->subscribe([this](brls::SensorEvent event) {
-            if (!inputEnabled) return;
-            
-            switch (event.type) {
+        ->subscribe([this](brls::SensorEvent sensor) {
+            InputEvent event;
+            event.type = InputEvent::Type::SENSOR;
+            event.code = (int32_t)sensor.type;
+            event.controller = (uint8_t)sensor.controllerIndex;
+            event.x = sensor.data[0];
+            event.y = sensor.data[1];
+            event.z = sensor.data[2];
+            handlePlatformEvent(event);
+        });
+}
+
+void MoonlightInputManager::handlePlatformEvent(InputEvent event) {
+    if (!inputEnabled || replaying) return;
+
+    if (recorder.isOpen()) {
+        event.timeUs = recorder.elapsedUs();
+        pendingEvents.push_back(event);
+    }
+    handleEvent(event);
+}
+
+void MoonlightInputManager::handleEvent(const InputEvent& event) {
+    switch (event.type) {
+        case InputEvent::Type::MOUSE_OFFSET:
+            if ((event.x != 0 || event.y != 0) && !inputDropped) {
+                float multiplier =
+                        (float) Settings::instance().get_mouse_speed_multiplier() / 100.f *
+                        1.5f + 0.5f;
+                pointer.addMove(event.x * multiplier, event.y * multiplier);
+            }
+            break;
+        case InputEvent::Type::MOUSE_SCROLL:
+            if (event.x != 0 || event.y != 0)
+                pointer.addScroll(event.x, event.y);
+            break;
+        case InputEvent::Type::KEY:
+            sendKeyboardEvent(glfwKeyToVKKey((brls::BrlsKeyboardScancode)event.code),
+                              event.pressed, (char)event.mods);
+            break;
+        case InputEvent::Type::SENSOR:
+            switch ((brls::SensorEventType)event.code) {
                 case brls::SensorEventType::ACCEL:
-                    LiSendControllerMotionEvent((uint8_t)event.controllerIndex, LI_MOTION_TYPE_ACCEL, event.data[0], event.data[1], event.data[2]);
+                    motionForwarder.addSample(event.controller, LI_MOTION_TYPE_ACCEL, event.x, event.y, event.z);
                     break;
                 case brls::SensorEventType::GYRO:
                     // Convert rad/s to deg/s
-                    LiSendControllerMotionEvent((uint8_t)event.controllerIndex, LI_MOTION_TYPE_GYRO, 
-                        event.data[0] * 57.2957795f, 
-                        event.data[1] * 57.2957795f, 
-                        event.data[2] * 57.2957795f);
+                    motionForwarder.addSample(event.controller, LI_MOTION_TYPE_GYRO,
+                        event.x * 57.2957795f,
+                        event.y * 57.2957795f,
+                        event.z * 57.2957795f);
                     break;
             }
-        });
+            break;
+        case InputEvent::Type::PAN:
+            panDelta = brls::Point(event.x, event.y);
+            break;
+    }
 }
 
-void MoonlightInputManager::sendRelativeMouseMove(brls::Point offset) {
-    desktopMouseRemainder.x += offset.x;
-    desktopMouseRemainder.y += offset.y;
+bool MoonlightInputManager::startRecording(const std::string& path) {
+    stopSampling();
+    pendingEvents.clear();
+    return recorder.open(path);
+}
 
-    short deltaX = static_cast<short>(std::trunc(desktopMouseRemainder.x));
-    short deltaY = static_cast<short>(std::trunc(desktopMouseRemainder.y));
+void MoonlightInputManager::stopRecording() {
+    recorder.close();
+    pendingEvents.clear();
+}
 
-    if (deltaX == 0 && deltaY == 0) {
-        return;
-    }
+void MoonlightInputManager::setReplaying(bool replaying) {
+    if (replaying)
+        stopSampling();
+    this->replaying = replaying;
+}
 
-    desktopMouseRemainder.x -= deltaX;
-    desktopMouseRemainder.y -= deltaY;
+void MoonlightInputManager::replayEvent(const InputEvent& event) {
+    handleEvent(event);
+}
 
-    LiSendMouseMoveEvent(deltaX, deltaY);
+void MoonlightInputManager::replayFrame(const InputFrame& frame) {
+    inputDropped = false;
+    controllersReadAt = InputClock::now();
+    processFrame(frame);
+    pointer.flush();
 }
 
 void MoonlightInputManager::reloadButtonMappingLayout() {
-    KeyMappingLayout layout = (*Settings::instance().get_mapping_laouts())
-        [Settings::instance().get_current_mapping_layout()];
+    const auto* layouts = Settings::instance().get_mapping_laouts();
+    const KeyMappingLayout* layout = layouts->empty() ? nullptr
+        : &(*layouts)[Settings::instance().get_current_mapping_layout()];
+
+    const int next = 1 - activeMapping;
+    CompiledInputMapping& mapping = compiledMappings[next];
+    mapping = CompiledInputMapping();
+
     for (int i = 0; i < _BUTTON_MAX; i++) {
-        if (layout.mapping.count(i) == 1) {
-            mappingButtons[i] = (brls::ControllerButton)layout.mapping.at(i);
-        } else {
-            mappingButtons[i] = (brls::ControllerButton)i;
+        int button = i;
+        if (layout) {
+            auto target = layout->mapping.find(i);
+            if (target != layout->mapping.end())
+                button = target->second;
+        }
+        if (button < 0 || button >= _BUTTON_MAX)
+            button = i;
+
+        mapping.buttonTargets[i] = buttonBit(button);
+        for (const auto& limelight : LIMELIGHT_BUTTONS) {
+            if (limelight.button == button)
+                mapping.buttonFlags[i] |= limelight.flag;
         }
     }
+
+    mapping.guideCombo = comboMask(Settings::instance().guide_key_options().buttons);
+
+    auto overlay = Settings::instance().overlay_options();
+    mapping.overlayCombo = comboMask(overlay.buttons);
+    mapping.overlayHoldTime = overlay.holdTime;
+
+    auto mouseInput = Settings::instance().mouse_input_options();
+    mapping.mouseInputCombo = comboMask(mouseInput.buttons);
+    mapping.mouseInputHoldTime = mouseInput.holdTime;
+
+    mapping.leftStickDeadzone = Settings::instance().get_deadzone_stick_left();
+    mapping.rightStickDeadzone = Settings::instance().get_deadzone_stick_right();
+    mapping.minSendInterval = std::chrono::milliseconds(
+        std::clamp(Settings::instance().input_min_send_interval_ms(), 0,
+                   MAX_MIN_SEND_INTERVAL_MS));
+    mapping.rumbleForce = Settings::instance().get_rumble_force();
+
+    activeMapping = next;
 }
 
 void MoonlightInputManager::updateTouchScreenPanDelta(
     brls::PanGestureStatus panStatus) {
-    this->panStatus = panStatus;
+    InputEvent event;
+    event.type = InputEvent::Type::PAN;
+    event.x = panStatus.delta.x;
+    event.y = panStatus.delta.y;
+    handlePlatformEvent(event);
 }
 
 void MoonlightInputManager::handleRumble(unsigned short controller,
                                          unsigned short lowFreqMotor,
                                          unsigned short highFreqMotor) {
     brls::Logger::debug("Rumble {} {}", lowFreqMotor, highFreqMotor);
+    postRumble(controller, uint64_t(lowFreqMotor) | uint64_t(highFreqMotor) << 16,
+               0xFFFFFFFFull);
+}
 
+void MoonlightInputManager::handleRumbleTriggers(uint16_t controllerNumber, 
+                                                  uint16_t leftTriggerMotor, 
+                                                  uint16_t rightTriggerMotor) {
+    brls::Logger::debug("Rumble Trigger {} {}", leftTriggerMotor, rightTriggerMotor);
+    postRumble(controllerNumber,
+               uint64_t(leftTriggerMotor) << 32 | uint64_t(rightTriggerMotor) << 48,
+               0xFFFFFFFFull << 32);
+}
+
+void MoonlightInputManager::postRumble(unsigned short controller,
+                                       uint64_t motors, uint64_t mask) {
     if (controller >= GAMEPADS_MAX) {
         brls::Logger::warning("Ignoring rumble for out-of-range controller {}", controller);
+        rumbleDropped++;
         return;
     }
 
-    float rumbleMultiplier = Settings::instance().get_rumble_force();
-
-    rumbleCache[controller].lowFreqMotor = lowFreqMotor * rumbleMultiplier;
-    rumbleCache[controller].highFreqMotor = highFreqMotor * rumbleMultiplier;
+    RumbleMailbox& mailbox = rumbleMailboxes[controller];
+    uint64_t current = mailbox.motors;
+    while (!mailbox.motors.compare_exchange_weak(current, (current & ~mask) | motors)) {}
 
-    brls::Application::getPlatform()->getInputManager()->sendRumble(
-        controller, 
-        rumbleCache[controller].lowFreqMotor,
-        rumbleCache[controller].highFreqMotor);
+    rumblePosts++;
+    // Still unapplied, the input thread only sees the newest values
+    if (mailbox.pending.exchange(true))
+        rumbleCoalesced++;
 }
 
-void MoonlightInputManager::handleRumbleTriggers(uint16_t controllerNumber, 
-                                                  uint16_t leftTriggerMotor, 
-                                                  uint16_t rightTriggerMotor) {
-    brls::Logger::debug("Rumble Trigger {} {}", leftTriggerMotor, rightTriggerMotor);
+void MoonlightInputManager::applyRumble(int controllersCount) {
+    if (replaying) return;
 
-    if (controllerNumber >= GAMEPADS_MAX) {
-        brls::Logger::warning("Ignoring trigger rumble for out-of-range controller {}", controllerNumber);
-        return;
-    }
+    const float rumbleMultiplier = compiledMapping().rumbleForce;
+    auto inputManager = brls::Application::getPlatform()->getInputManager();
 
-    float rumbleMultiplier = Settings::instance().get_rumble_force();
+    for (int i = 0; i < controllersCount; i++) {
+        if (!rumbleMailboxes[i].pending.exchange(false))
+            continue;
+
+        const uint64_t motors = rumbleMailboxes[i].motors;
+        RumbleValues values;
+        values.lowFreqMotor = uint16_t(motors) * rumbleMultiplier;
+        values.highFreqMotor = uint16_t(motors >> 16) * rumbleMultiplier;
+        values.leftTriggerMotor = uint16_t(motors >> 32) * rumbleMultiplier;
+        values.rightTriggerMotor = uint16_t(motors >> 48) * rumbleMultiplier;
+
+        // Controllers without trigger motors keep getting the plain call
+        const RumbleValues& applied = rumbleCache[i];
+        if (values.leftTriggerMotor || values.rightTriggerMotor ||
+            applied.leftTriggerMotor || applied.rightTriggerMotor) {
+            inputManager->sendRumble(i, values.lowFreqMotor, values.highFreqMotor,
+                                     values.leftTriggerMotor, values.rightTriggerMotor);
+        } else {
+            inputManager->sendRumble(i, values.lowFreqMotor, values.highFreqMotor);
+        }
+        rumbleCache[i] = values;
+        rumbleApplied++;
+    }
+}
 
-    rumbleCache[controllerNumber].leftTriggerMotor = leftTriggerMotor * rumbleMultiplier;
-    rumbleCache[controllerNumber].rightTriggerMotor = rightTriggerMotor * rumbleMultiplier;
+void MoonlightInputManager::resetConnectionState() {
+    motionForwarder.resetReportRates();
+    hostTouchUnsupported = false;
+    for (auto& mailbox : rumbleMailboxes) {
+        mailbox.motors = 0;
+        mailbox.pending = false;
+    }
+}
 
-    brls::Application::getPlatform()->getInputManager()->sendRumble(
-        controllerNumber, 
-        rumbleCache[controllerNumber].lowFreqMotor,
-        rumbleCache[controllerNumber].highFreqMotor,
-        rumbleCache[controllerNumber].leftTriggerMotor,
-        rumbleCache[controllerNumber].rightTriggerMotor);
+void MoonlightInputManager::handleMotionEventState(uint16_t controller,
+                                                   uint8_t motionType,
+                                                   uint16_t reportRateHz) {
+    motionForwarder.setReportRate(controller, motionType, reportRateHz);
 }
 
 void MoonlightInputManager::dropInput() {
+    stopSampling();
+
     if (inputDropped)
         return;
 
-    desktopMouseRemainder = {0, 0};
+    pointer.reset();
+    motionForwarder.reset();
 
     bool res = true;
     // Drop gamepad state
@@ -195,197 +430,368 @@ void MoonlightInputManager::dropInput() {
     }
 
     for (short i = 0; i < controllersCount; i++) {
-        res &= LiSendMultiControllerEvent(
-                   i, controllersToMap(), gamepadState.buttonFlags,
+        res &= InputSink::sendMultiControllerEvent(
+                   i, controllersToMap(controllersCount), gamepadState.buttonFlags,
                    gamepadState.leftTrigger, gamepadState.rightTrigger,
                    gamepadState.leftStickX, gamepadState.leftStickY,
                    gamepadState.rightStickX, gamepadState.rightStickY) == 0;
+        lastGamepadStates[i] = gamepadState;
+    }
+
+    // Stop rumble, the latest values from the host are applied again once
+    // input resumes
+    for (int i = 0; i < GAMEPADS_MAX && !replaying; i++) {
+        RumbleValues& applied = rumbleCache[i];
+        if (!applied.lowFreqMotor && !applied.highFreqMotor &&
+            !applied.leftTriggerMotor && !applied.rightTriggerMotor)
+            continue;
+
+        brls::Application::getPlatform()->getInputManager()->sendRumble(i, 0, 0, 0, 0);
+        applied = RumbleValues();
+        rumbleMailboxes[i].pending = true;
     }
 
     // Drop touchscreen mouse state
-    LiSendMouseButtonEvent(BUTTON_ACTION_RELEASE,BUTTON_MOUSE_LEFT);
+    InputSink::sendMouseButtonEvent(BUTTON_ACTION_RELEASE,BUTTON_MOUSE_LEFT);
 
     // Drop touchscreen state
-    for (auto id: activeTouchIDs) {
-        LiSendTouchEvent(LI_TOUCH_EVENT_CANCEL, id.first, 0, 0, 0, 0, 0, LI_ROT_UNKNOWN);
+    for (auto& slot : touchSlots) {
+        if (slot.active && !hostTouchUnsupported)
+            InputSink::sendTouchEvent(LI_TOUCH_EVENT_CANCEL, slot.fingerId, 0, 0, 0, 0, 0, LI_ROT_UNKNOWN);
+        slot = TouchSlot();
     }
-    activeTouchIDs.clear();
 
-    // Drop keyboard state
-    for (int i = BRLS_KBD_KEY_SPACE; i < BrlsKeyboardScancode::BRLS_KBD_KEY_LAST; i++)  {
-        short vkKey = MoonlightInputManager::glfwKeyToVKKey((BrlsKeyboardScancode)i);
-        LiSendKeyboardEvent(vkKey, KEY_ACTION_UP, 0);
+    // Drop keyboard state, only what is actually held
+    int released = 0;
+    for (int word = 0; word < 4; word++) {
+        for (uint64_t keys = heldKeys[word]; keys != 0; keys &= keys - 1) {
+            InputSink::sendKeyboardEvent(short(word * 64 + __builtin_ctzll(keys)), KEY_ACTION_UP, 0);
+            released++;
+        }
+        heldKeys[word] = 0;
     }
+    keyEventsSent += released;
+    keyReleasesAvoided += BRLS_KBD_KEY_LAST - BRLS_KBD_KEY_SPACE - released;
 
+    recorder.flush();
     inputDropped = res;
 }
 
+void MoonlightInputManager::sendKeyboardEvent(short vkKey, bool pressed,
+                                              char modifiers) {
+    // Only virtual keys are tracked and released by dropInput()
+    if (vkKey < 0 || vkKey >= 256)
+        return;
+
+    const uint64_t bit = uint64_t(1) << (vkKey % 64);
+    pressed ? (heldKeys[vkKey / 64] |= bit) : (heldKeys[vkKey / 64] &= ~bit);
+
+    InputSink::sendKeyboardEvent(vkKey, pressed ? KEY_ACTION_DOWN : KEY_ACTION_UP,
+                                 modifiers);
+    keyEventsSent++;
+}
+
+void MoonlightInputManager::sendKeyboardChanges(KeyboardView* keyboard,
+                                                const KeyboardState& state,
+                                                KeyboardState& sent) {
+    for (int word = 0; word < KeyboardState::WORDS; word++) {
+        for (uint64_t changed = state.words[word] ^ sent.words[word];
+             changed != 0; changed &= changed - 1) {
+            const int key = word * 64 + __builtin_ctzll(changed);
+            sendKeyboardEvent(keyboard->getKeyCode((KeyboardKeys)key),
+                              state.pressed(key));
+        }
+        sent.words[word] = state.words[word];
+    }
+}
+
 GamepadState MoonlightInputManager::getControllerState(int controllerNum,
+                                                       const brls::ControllerState& controller,
                                                        bool specialKey) {
-    brls::ControllerState rawController{};
-    brls::ControllerState controller{};
+    return ControllerMapping::mapState(
+        controller, compiledMapping(), specialKey,
+        lastGamepadStates[controllerNum].buttonFlags & SPECIAL_FLAG);
+}
 
-    brls::Application::setSwapHalfJoyconStickToDpad(Settings::instance().swap_joycon_stick_to_dpad());
-    brls::Application::getPlatform()->getInputManager()->updateControllerState(
-        &rawController, controllerNum);
-    controller = mapController(rawController);
-
-    // Use axis or button if axis is not available (equals 0)
-    float lzAxis = controller.axes[LEFT_Z] > 0 ? controller.axes[LEFT_Z] : (controller.buttons[brls::BUTTON_LT] ? 1.f : 0.f);
-    float rzAxis = controller.axes[RIGHT_Z] > 0 ? controller.axes[RIGHT_Z] : (controller.buttons[brls::BUTTON_RT] ? 1.f : 0.f);
-
-    // Truncate dead zones
-    float leftStickDeadzone = Settings::instance().get_deadzone_stick_left();
-    float rightStickDeadzone = Settings::instance().get_deadzone_stick_right();
-
-    float leftXAxis = controller.axes[brls::LEFT_X];
-    float leftYAxis = controller.axes[brls::LEFT_Y];
-    float rightXAxis = controller.axes[brls::RIGHT_X];
-    float rightYAxis = controller.axes[brls::RIGHT_Y];
-
-    if (leftStickDeadzone > 0) {
-        float magnitude = fsqrt_(std::powf(leftXAxis, 2) + std::powf(leftYAxis, 2));
-        if (magnitude < leftStickDeadzone) {
-            leftXAxis = 0;
-            leftYAxis = 0;
-        }
+void MoonlightInputManager::filterAxes(GamepadState& state,
+                                       const GamepadState& sent) {
+    state.leftTrigger = applyHysteresis(state.leftTrigger, sent.leftTrigger, TRIGGER_HYSTERESIS, 0xFF);
+    state.rightTrigger = applyHysteresis(state.rightTrigger, sent.rightTrigger, TRIGGER_HYSTERESIS, 0xFF);
+    state.leftStickX = applyHysteresis(state.leftStickX, sent.leftStickX, STICK_HYSTERESIS, 0x7FFF);
+    state.leftStickY = applyHysteresis(state.leftStickY, sent.leftStickY, STICK_HYSTERESIS, 0x7FFF);
+    state.rightStickX = applyHysteresis(state.rightStickX, sent.rightStickX, STICK_HYSTERESIS, 0x7FFF);
+    state.rightStickY = applyHysteresis(state.rightStickY, sent.rightStickY, STICK_HYSTERESIS, 0x7FFF);
+}
+
+void MoonlightInputManager::handleControllers(bool specialKey,
+                                              const InputFrame* frame,
+                                              InputClock::time_point readAt) {
+    int controllersCount = frame ? (int)frame->controllers.size()
+                                 : brls::Application::getPlatform()
+                                       ->getInputManager()
+                                       ->getControllersConnectedCount();
+
+    if (controllersCount > GAMEPADS_MAX) {
+        brls::Logger::warning("Clamping controller count from {} to {} while handling input", controllersCount, GAMEPADS_MAX);
+        controllersCount = GAMEPADS_MAX;
     }
 
-    if (rightStickDeadzone > 0) {
-        float magnitude = fsqrt_(std::powf(rightXAxis, 2) + std::powf(rightYAxis, 2));
-        if (magnitude < rightStickDeadzone) {
-            rightXAxis = 0;
-            rightYAxis = 0;
+    applyRumble(controllersCount);
+
+    short mappedControllersCount = controllersToMap(controllersCount);
+    const auto minSendInterval = compiledMapping().minSendInterval;
+
+    for (int i = 0; i < controllersCount; i++) {
+        // Measured from the start of the read, not from after it
+        const auto polled = frame ? readAt : InputClock::now();
+        brls::ControllerState controller{};
+        if (frame) {
+            controller = frame->controllers[i];
+        } else {
+            brls::Application::getPlatform()->getInputManager()->updateControllerState(
+                &controller, i);
         }
-    }
+        GamepadState gamepadState = getControllerState(i, controller, specialKey);
+        const GamepadState& sent = lastGamepadStates[i];
 
-    GamepadState gamepadState{
-        .buttonFlags = 0,
-        .leftTrigger = static_cast<unsigned char>(
-            0xFF * (!specialKey ? lzAxis : 0)),
-        .rightTrigger = static_cast<unsigned char>(
-            0xFF * (!specialKey ? rzAxis : 0)),
-        .leftStickX = static_cast<short>(
-            0x7FFF * (!specialKey ? leftXAxis : 0)),
-        .leftStickY = static_cast<short>(
-            -0x7FFF * (!specialKey ? leftYAxis : 0)),
-        .rightStickX = static_cast<short>(
-            0x7FFF * (!specialKey ? rightXAxis : 0)),
-        .rightStickY = static_cast<short>(
-            -0x7FFF * (!specialKey ? rightYAxis : 0)),
-    };
-
-    brls::ControllerButton a = brls::BUTTON_A;
-    brls::ControllerButton b = brls::BUTTON_B;
-    brls::ControllerButton x = brls::BUTTON_X;
-    brls::ControllerButton y = brls::BUTTON_Y;
-
-#define SET_GAME_PAD_STATE(LIMELIGHT_KEY, GAMEPAD_BUTTON)                      \
-    controller.buttons[GAMEPAD_BUTTON]                                         \
-        ? (gamepadState.buttonFlags |= LIMELIGHT_KEY)                          \
-        : (gamepadState.buttonFlags &= ~LIMELIGHT_KEY);
-
-    SET_GAME_PAD_STATE(UP_FLAG, brls::BUTTON_UP);
-    SET_GAME_PAD_STATE(DOWN_FLAG, brls::BUTTON_DOWN);
-    SET_GAME_PAD_STATE(LEFT_FLAG, brls::BUTTON_LEFT);
-    SET_GAME_PAD_STATE(RIGHT_FLAG, brls::BUTTON_RIGHT);
+        if (gamepadState.is_equal(sent))
+            continue;
 
+        filterAxes(gamepadState, sent);
+        if (gamepadState.is_equal(sent)) {
+            suppressedSends++;
+            continue;
+        }
+
+        // Button edges go out immediately, axis-only updates at most once
+        // per interval, carrying the latest position when they do
+        if (gamepadState.buttonFlags == sent.buttonFlags &&
+            polled - lastGamepadSends[i] < minSendInterval) {
+            suppressedSends++;
+            continue;
+        }
+
+        lastGamepadStates[i] = gamepadState;
+        lastGamepadSends[i] = polled;
+
+        if (lastControllerCount != controllersCount) {
+            lastControllerCount = controllersCount;
+
+            for (int i = 0; i < controllersCount; i++) {
+                Logger::debug("StreamingView: send features message for controller #{}", i);
+                InputSink::sendControllerArrivalEvent(i, mappedControllersCount, LI_CTYPE_UNKNOWN, 0, LI_CCAP_RUMBLE | LI_CCAP_ACCEL | LI_CCAP_GYRO);
+            }
+        }
+
+        if (InputSink::sendMultiControllerEvent(
+                i, mappedControllersCount, gamepadState.buttonFlags,
+                gamepadState.leftTrigger, gamepadState.rightTrigger,
+                gamepadState.leftStickX, gamepadState.leftStickY,
+                gamepadState.rightStickX, gamepadState.rightStickY) != 0)
+            brls::Logger::info("StreamingView: error sending input data");
+
+        recordPollToSend(polled);
+    }
+    polls++;
+}
+
+bool MoonlightInputManager::canSampleOffUIThread() {
 #ifdef __SWITCH__
-    SET_GAME_PAD_STATE(A_FLAG, b);
-    SET_GAME_PAD_STATE(B_FLAG, a);
-    SET_GAME_PAD_STATE(X_FLAG, y);
-    SET_GAME_PAD_STATE(Y_FLAG, x);
+    // HID is read from shared memory, other platforms pump their
+    // controller events on the main thread
+    return true;
 #else
-    SET_GAME_PAD_STATE(A_FLAG, a);
-    SET_GAME_PAD_STATE(B_FLAG, b);
-    SET_GAME_PAD_STATE(X_FLAG, x);
-    SET_GAME_PAD_STATE(Y_FLAG, y);
+    return false;
 #endif
+}
 
-    SET_GAME_PAD_STATE(BACK_FLAG, brls::BUTTON_BACK);
-    SET_GAME_PAD_STATE(PLAY_FLAG, brls::BUTTON_START);
-
-    SET_GAME_PAD_STATE(LB_FLAG, brls::BUTTON_LB);
-    SET_GAME_PAD_STATE(RB_FLAG, brls::BUTTON_RB);
+bool MoonlightInputManager::controllersNeedUIThread() {
+#ifdef __SWITCH__
+    // borealis turns single Joy-Cons sideways and optionally swaps their
+    // stick to the d-pad in updateControllerState(), the sampler only reads
+    // raw pads
+    for (int i = 0; i < GAMEPADS_MAX; i++) {
+        const uint32_t styles = hidGetNpadStyleSet(HidNpadIdType(HidNpadIdType_No1 + i));
+        if (styles & (HidNpadStyleTag_NpadJoyLeft | HidNpadStyleTag_NpadJoyRight))
+            return true;
+    }
+#endif
+    return false;
+}
 
-    SET_GAME_PAD_STATE(LS_CLK_FLAG, brls::BUTTON_LSB);
-    SET_GAME_PAD_STATE(RS_CLK_FLAG, brls::BUTTON_RSB);
+void MoonlightInputManager::startSampling() {
+    // Recording and replay need controllers read with each frame
+    if (!canSampleOffUIThread() || samplingRunning || recorder.isOpen() ||
+        replaying || controllersNeedUIThread())
+        return;
 
-    auto guideKeys = Settings::instance().guide_key_options().buttons;
-    bool guideCombo = !guideKeys.empty();
-    for (auto key : guideKeys)
-        guideCombo &= controller.buttons[key];
+    const int rate = std::clamp(Settings::instance().input_sampling_rate(),
+                                MIN_SAMPLING_RATE, MAX_SAMPLING_RATE);
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / rate));
 
-    if (guideCombo ||
-        lastGamepadStates[controllerNum].buttonFlags & SPECIAL_FLAG)
-        gamepadState.buttonFlags = 0;
+    samplingRunning = true;
+    samplingThread = std::thread([this, period] { samplingLoop(period); });
+    brls::Logger::info("MoonlightInputManager: Sampling controllers at {} Hz", rate);
+}
 
-    bool guidePressed = guideCombo || controller.buttons[brls::BUTTON_GUIDE];
-    guidePressed ? (gamepadState.buttonFlags |= SPECIAL_FLAG)
-               : (gamepadState.buttonFlags &= ~SPECIAL_FLAG);
+void MoonlightInputManager::stopSampling() {
+    if (!samplingRunning)
+        return;
 
-    return gamepadState;
+    samplingRunning = false;
+    if (samplingThread.joinable())
+        samplingThread.join();
 }
 
-void MoonlightInputManager::handleControllers(bool specialKey) {
-    static int lastControllerCount = 0;
+void MoonlightInputManager::samplingLoop(std::chrono::steady_clock::duration period) {
+#ifdef __SWITCH__
+    SwitchSamplerPads pads;
+    InputFrame frame;
+#endif
 
-    auto controllersCount = brls::Application::getPlatform()
-                            ->getInputManager()
-                            ->getControllersConnectedCount();
+    auto next = std::chrono::steady_clock::now();
+    while (samplingRunning) {
+        if (inputEnabled) {
+#ifdef __SWITCH__
+            const auto readAt = InputClock::now();
+            pads.read(frame.controllers);
+            handleControllers(specialKeyActive, &frame, readAt);
+#else
+            handleControllers(specialKeyActive);
+#endif
+        }
 
-    if (controllersCount > GAMEPADS_MAX) {
-        brls::Logger::warning("Clamping controller count from {} to {} while handling input", controllersCount, GAMEPADS_MAX);
-        controllersCount = GAMEPADS_MAX;
+        // Late wakeups skip ticks instead of polling in a burst
+        next += period;
+        const auto now = std::chrono::steady_clock::now();
+        if (next < now)
+            next = now + period;
+        std::this_thread::sleep_until(next);
     }
+}
 
-    short mappedControllersCount = controllersToMap();
+void MoonlightInputManager::recordPollToSend(std::chrono::steady_clock::time_point polled) {
+    const uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        InputClock::now() - polled).count();
 
-    for (int i = 0; i < controllersCount; i++) {
-        GamepadState gamepadState = getControllerState(i, specialKey);
-
-        if (!gamepadState.is_equal(lastGamepadStates[i])) {
-            lastGamepadStates[i] = gamepadState;
-
-            if (lastControllerCount != controllersCount) {
-                lastControllerCount = controllersCount;
-                
-                for (int i = 0; i < controllersCount; i++) {
-                    Logger::debug("StreamingView: send features message for controller #{}", i);
-                    LiSendControllerArrivalEvent(i, mappedControllersCount, LI_CTYPE_UNKNOWN, 0, LI_CCAP_RUMBLE | LI_CCAP_ACCEL | LI_CCAP_GYRO);
-                }
-            }
+    sends++;
+    pollToSendTotalUs += elapsed;
+    uint64_t max = pollToSendMaxUs;
+    while (elapsed > max && !pollToSendMaxUs.compare_exchange_weak(max, elapsed)) {}
+}
 
-            if (LiSendMultiControllerEvent(
-                    i, mappedControllersCount, gamepadState.buttonFlags,
-                    gamepadState.leftTrigger, gamepadState.rightTrigger,
-                    gamepadState.leftStickX, gamepadState.leftStickY,
-                    gamepadState.rightStickX, gamepadState.rightStickY) != 0)
-                brls::Logger::info("StreamingView: error sending input data");
-        }
+InputLatencyStats MoonlightInputManager::latencyStats() {
+    // Polls per second over the last full second
+    const auto now = std::chrono::steady_clock::now();
+    if (now - statsWindowStart >= std::chrono::seconds(1)) {
+        const uint64_t currentPolls = polls;
+        const auto window = std::chrono::duration<float>(now - statsWindowStart).count();
+        measuredSamplingRate = int(float(currentPolls - statsWindowPolls) / window);
+        statsWindowPolls = currentPolls;
+        measuredTouchEventRate = int(float(touchEventsSent - statsWindowTouchEvents) / window);
+        statsWindowTouchEvents = touchEventsSent;
+        statsWindowStart = now;
     }
+
+    InputLatencyStats stats;
+    stats.samplingRate = measuredSamplingRate;
+    const uint64_t sent = sends;
+    stats.eventsSent = sent;
+    stats.eventsSuppressed = suppressedSends;
+    stats.motionSendRate = motionForwarder.effectiveSendRate();
+    stats.pointerInputs = pointer.inputs();
+    stats.pointerSends = pointer.sends();
+    stats.keyEventsSent = keyEventsSent;
+    stats.keyReleasesAvoided = keyReleasesAvoided;
+    stats.touchEventRate = measuredTouchEventRate;
+    stats.touchMovesSkipped = touchMovesSkipped;
+    stats.rumbleUpdates = rumblePosts;
+    stats.rumbleApplied = rumbleApplied;
+    stats.rumbleCoalesced = rumbleCoalesced + rumbleDropped;
+    if (sent > 0)
+        stats.averagePollToSendMs = float(pollToSendTotalUs) / float(sent) / 1000.f;
+    stats.maxPollToSendMs = float(pollToSendMaxUs) / 1000.f;
+    return stats;
 }
 
 void MoonlightInputManager::handleInput(bool ignoreTouch) {
+    if (replaying) return;
+
     inputDropped = false;
-    static brls::ControllerState rawController;
-    static brls::ControllerState controller;
-    static brls::RawMouseState mouse;
+    if (controllersNeedUIThread())
+        stopSampling();
+    startSampling();
+
+    InputFrame& frame = currentFrame;
+    readFrame(frame, ignoreTouch);
+    if (recorder.isOpen()) {
+        frame.timeUs = recorder.elapsedUs();
+        frame.events.swap(pendingEvents);
+        recorder.write(frame);
+        pendingEvents.clear();
+    }
+
+    processFrame(frame);
+}
+
+void MoonlightInputManager::readFrame(InputFrame& frame, bool ignoreTouch) {
+    auto inputManager = brls::Application::getPlatform()->getInputManager();
+
+    frame.ignoreTouch = ignoreTouch;
+    frame.contentWidth = Application::contentWidth;
+    frame.contentHeight = Application::contentHeight;
+
+    inputManager->updateUnifiedControllerState(&frame.unified);
+    inputManager->updateMouseStates(&frame.mouse);
+
+    rawTouchStates.clear();
+    inputManager->updateTouchStates(&rawTouchStates);
+    frame.touchStates = (int)rawTouchStates.size();
+
+    brls::Application::setSwapHalfJoyconStickToDpad(Settings::instance().swap_joycon_stick_to_dpad());
 
-    brls::Application::getPlatform()
-            ->getInputManager()
-            ->updateUnifiedControllerState(&rawController);
-    brls::Application::getPlatform()->getInputManager()->updateMouseStates(
-            &mouse);
-    controller = mapController(rawController);
+    // The sampling thread reads controllers itself
+    frame.controllers.clear();
+    controllersReadAt = InputClock::now();
+    if (!samplingRunning) {
+        int controllersCount = std::min(inputManager->getControllersConnectedCount(), GAMEPADS_MAX);
+        frame.controllers.resize(controllersCount);
+        for (int i = 0; i < controllersCount; i++)
+            inputManager->updateControllerState(&frame.controllers[i], i);
+    }
+
+    frame.touches.clear();
+    for (const auto& touch : brls::Application::currentTouchState) {
+        InputTouch input;
+        input.fingerId = touch.fingerId;
+        input.x = touch.position.x;
+        input.y = touch.position.y;
+        input.phase = touch.phase;
+        input.blocked = touch.view && touch.view->hasParent() &&
+                        dynamic_cast<StreamingView*>(touch.view->getParent()) == nullptr;
+        frame.touches.push_back(input);
+    }
 
-    std::vector<brls::RawTouchState> states;
-    brls::Application::getPlatform()->getInputManager()->updateTouchStates(&states);
+    frame.events.clear();
+}
+
+void MoonlightInputManager::processFrame(const InputFrame& frame) {
+    const brls::ControllerState& controller = frame.unified;
+    const brls::RawMouseState& mouse = frame.mouse;
+    const bool ignoreTouch = frame.ignoreTouch;
+
+    int buttonFlags = 0;
+    const uint64_t buttons = ControllerMapping::mapButtons(
+        ControllerMapping::packButtons(controller), compiledMapping(),
+        buttonFlags);
 
     //Do not use gamepad for mouse controll assist if touchscreen mode enabled
-    bool specialKey = !ignoreTouch && !Settings::instance().touchscreen_mouse_mode() && states.size() == 1;
+    bool specialKey = !ignoreTouch && !Settings::instance().touchscreen_mouse_mode() && frame.touchStates == 1;
 
-    handleControllers(specialKey);
+    specialKeyActive = specialKey;
+    if (!samplingRunning)
+        handleControllers(specialKey, &frame, controllersReadAt);
 
     float stickScrolling = 0;
     if (specialKey) {
@@ -396,15 +802,13 @@ void MoonlightInputManager::handleInput(bool ignoreTouch) {
                                          Settings::instance().get_deadzone_stick_right());
     }
 
-    static MouseStateS lastMouseState;
-
     MouseStateS mouseState;
     if (!Settings::instance().touchscreen_mouse_mode()) {
         mouseState = {
                 .scroll_y = stickScrolling,
-                .l_pressed = (specialKey && controller.buttons[brls::BUTTON_RT]) || mouse.leftButton,
+                .l_pressed = (specialKey && (buttons & buttonBit(brls::BUTTON_RT))) || mouse.leftButton,
                 .m_pressed = mouse.middleButton,
-                .r_pressed = (specialKey && controller.buttons[brls::BUTTON_LT]) || mouse.rightButton
+                .r_pressed = (specialKey && (buttons & buttonBit(brls::BUTTON_LT))) || mouse.rightButton
         };
     } else {
         mouseState = {
@@ -422,108 +826,198 @@ void MoonlightInputManager::handleInput(bool ignoreTouch) {
         lastMouseState.l_pressed = mouseState.l_pressed;
         auto lb = Settings::instance().swap_mouse_keys() ? BUTTON_MOUSE_RIGHT
                                                          : BUTTON_MOUSE_LEFT;
-        LiSendMouseButtonEvent(mouseState.l_pressed ? BUTTON_ACTION_PRESS
-                                                    : BUTTON_ACTION_RELEASE,
-                               lb);
+        InputSink::sendMouseButtonEvent(mouseState.l_pressed ? BUTTON_ACTION_PRESS
+                                                               : BUTTON_ACTION_RELEASE,
+                                        lb);
         if (!mouseState.l_pressed)
             Logger::debug("Release key lmb");
     }
 
     if (mouseState.m_pressed != lastMouseState.m_pressed) {
         lastMouseState.m_pressed = mouseState.m_pressed;
-        LiSendMouseButtonEvent(mouseState.m_pressed ? BUTTON_ACTION_PRESS
-                                                    : BUTTON_ACTION_RELEASE,
-                               BUTTON_MOUSE_MIDDLE);
+        InputSink::sendMouseButtonEvent(mouseState.m_pressed ? BUTTON_ACTION_PRESS
+                                                               : BUTTON_ACTION_RELEASE,
+                                        BUTTON_MOUSE_MIDDLE);
     }
 
     if (mouseState.r_pressed != lastMouseState.r_pressed) {
         lastMouseState.r_pressed = mouseState.r_pressed;
         auto rb = Settings::instance().swap_mouse_keys() ? BUTTON_MOUSE_LEFT
                                                          : BUTTON_MOUSE_RIGHT;
-        LiSendMouseButtonEvent(mouseState.r_pressed ? BUTTON_ACTION_PRESS
-                                                    : BUTTON_ACTION_RELEASE,
-                               rb);
+        InputSink::sendMouseButtonEvent(mouseState.r_pressed ? BUTTON_ACTION_PRESS
+                                                               : BUTTON_ACTION_RELEASE,
+                                        rb);
     }
 
-    std::chrono::high_resolution_clock::time_point timeNow =
-            std::chrono::high_resolution_clock::now();
-    static std::chrono::high_resolution_clock::time_point timeStamp = timeNow;
+    const auto timeNow = InputClock::now();
+    if (scrollTimeStamp == InputClock::time_point())
+        scrollTimeStamp = timeNow;
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-            timeNow - timeStamp)
+            timeNow - scrollTimeStamp)
             .count();
     if (mouseState.scroll_y != 0 &&
         (float) duration > 550 - std::fabs(mouseState.scroll_y) * 500) {
-        timeStamp = timeNow;
-        brls::Logger::info("Scroll sended: {}", mouseState.scroll_y);
+        scrollTimeStamp = timeNow;
         lastMouseState.scroll_y = mouseState.scroll_y;
-        LiSendScrollEvent(mouseState.scroll_y > 0 ? 1 : -1);
+        pointer.addScroll(0, mouseState.scroll_y > 0 ? PointerPipeline::NOTCH
+                                                     : -PointerPipeline::NOTCH);
     }
 
     if (!Settings::instance().touchscreen_mouse_mode()) {
+        // Fingers still down when the mode was switched
+        releaseMissingTouches(frame, false);
+
         // Do not process touch events, useful if onscreen keyboard is presented
         if (ignoreTouch) { return; }
 
-        if (panStatus.has_value()) {
+        if (panDelta.has_value()) {
             float multiplier =
                     Settings::instance().get_mouse_speed_multiplier() / 100.f * 1.5f +
                     0.5f;
-            LiSendMouseMoveEvent(-panStatus->delta.x * multiplier,
-                                 -panStatus->delta.y * multiplier);
-            panStatus.reset();
+            pointer.addMove(-panDelta->x * multiplier,
+                            -panDelta->y * multiplier);
+            panDelta.reset();
         }
     } else {
-        uint8_t eventType;
+        releaseMissingTouches(frame, true);
 
-        auto touches = brls::Application::currentTouchState;
+        const auto& touches = frame.touches;
         for (int i = 0; i < touches.size(); i++) {
-            auto touch = touches[i];
-            if (touch.view && touch.view->hasParent() && dynamic_cast<StreamingView*>(touch.view->getParent()) == nullptr) return;
+            const auto& touch = touches[i];
+            if (touch.blocked) continue;
 
-            switch (touch.phase) {
-                case TouchPhase::START:
-                    eventType = LI_TOUCH_EVENT_DOWN;
-                    break;
-                case TouchPhase::STAY:
-                    eventType = LI_TOUCH_EVENT_MOVE;
-                    break;
-                case TouchPhase::END:
-                    eventType = LI_TOUCH_EVENT_UP;
-                    break;
-                case TouchPhase::NONE:
-                    eventType = LI_TOUCH_EVENT_CANCEL;
-                    break;
-            }
+            sendTouch(touch, i == 0, frame);
+        }
+    }
+}
 
-            if (touch.phase != TouchPhase::NONE) {
-                activeTouchIDs.insert(std::pair(touch.fingerId, true));
-            } else {
-                activeTouchIDs.erase(touch.fingerId);
-            }
+MoonlightInputManager::TouchSlot* MoonlightInputManager::touchSlot(uint32_t fingerId, bool allocate) {
+    TouchSlot* free = nullptr;
+    for (auto& slot : touchSlots) {
+        if (slot.active && slot.fingerId == fingerId)
+            return &slot;
+        if (!slot.active && !free)
+            free = &slot;
+    }
 
-            if (LiSendTouchEvent(eventType, touch.fingerId, touch.position.x / (float) Application::contentWidth,
-                                 touch.position.y / (float) Application::contentHeight, 0, 0, 0, LI_ROT_UNKNOWN) ==
-                LI_ERR_UNSUPPORTED && i == 0) {
-                // Fallback to move cursor and click if touch unsupported
-                if (touch.phase != TouchPhase::NONE) {
-                    LiSendMousePositionEvent(touch.position.x, touch.position.y, Application::contentWidth,
-                                             Application::contentHeight);
-                }
-                if (touch.phase == TouchPhase::START) {
-                    LiSendMouseButtonEvent(BUTTON_ACTION_PRESS, BUTTON_MOUSE_LEFT);
-                }
-                if (touch.phase == TouchPhase::END) {
-                    LiSendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_MOUSE_LEFT);
-                }
-            }
+    if (!allocate || !free)
+        return nullptr;
+
+    free->active = true;
+    free->fingerId = fingerId;
+    return free;
+}
+
+void MoonlightInputManager::releaseMissingTouches(const InputFrame& frame,
+                                                  bool handled) {
+    bool released = false;
+    for (auto& slot : touchSlots) {
+        if (!slot.active)
+            continue;
+
+        const bool present = handled &&
+            std::any_of(frame.touches.begin(), frame.touches.end(),
+                        [&slot](const InputTouch& touch) {
+                            return touch.fingerId == slot.fingerId && !touch.blocked;
+                        });
+        if (present)
+            continue;
+
+        if (!hostTouchUnsupported) {
+            InputSink::sendTouchEvent(LI_TOUCH_EVENT_CANCEL, slot.fingerId, 0, 0, 0, 0, 0, LI_ROT_UNKNOWN);
+            touchEventsSent++;
         }
+        slot.active = false;
+        slot.moved = false;
+        released = true;
+    }
+
+    // The mouse fallback may have pressed for one of them, keep a drag by a
+    // finger that is still down
+    const bool anyActive = std::any_of(std::begin(touchSlots), std::end(touchSlots),
+                                       [](const TouchSlot& slot) { return slot.active; });
+    if (released && hostTouchUnsupported && !anyActive) {
+        InputSink::sendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_MOUSE_LEFT);
+        touchEventsSent++;
     }
 }
 
-short MoonlightInputManager::controllersToMap() {
-    switch (brls::Application::getPlatform()
-                ->getInputManager()
-                ->getControllersConnectedCount()) {
+void MoonlightInputManager::sendTouch(const InputTouch& touch, bool primary,
+                                      const InputFrame& frame) {
+    uint8_t eventType;
+    switch (touch.phase) {
+        case TouchPhase::START:
+            eventType = LI_TOUCH_EVENT_DOWN;
+            break;
+        case TouchPhase::STAY:
+            eventType = LI_TOUCH_EVENT_MOVE;
+            break;
+        case TouchPhase::END:
+            eventType = LI_TOUCH_EVENT_UP;
+            break;
+        case TouchPhase::NONE:
+            eventType = LI_TOUCH_EVENT_CANCEL;
+            break;
+    }
+
+    const bool down = touch.phase == TouchPhase::START || touch.phase == TouchPhase::STAY;
+    TouchSlot* slot = touchSlot(touch.fingerId, down);
+    if (down) {
+        if (!slot) {
+            Logger::debug("Ignoring finger {}, all {} touch slots are in use", touch.fingerId, TOUCH_SLOTS);
+            return;
+        }
+
+        if (touch.phase == TouchPhase::STAY && slot->moved &&
+            std::fabs(touch.x - slot->x) < TOUCH_MOVE_THRESHOLD &&
+            std::fabs(touch.y - slot->y) < TOUCH_MOVE_THRESHOLD) {
+            touchMovesSkipped++;
+            return;
+        }
+
+        slot->x = touch.x;
+        slot->y = touch.y;
+        slot->moved = true;
+    } else if (slot) {
+        slot->active = false;
+        slot->moved = false;
+    } else {
+        // Never sent down, e.g. while every slot was in use
+        return;
+    }
+
+    if (!hostTouchUnsupported) {
+        touchEventsSent++;
+        if (InputSink::sendTouchEvent(eventType, touch.fingerId, touch.x / frame.contentWidth,
+                                      touch.y / frame.contentHeight, 0, 0, 0, LI_ROT_UNKNOWN) !=
+            LI_ERR_UNSUPPORTED)
+            return;
+
+        Logger::info("Host does not support touch events, falling back to the mouse");
+        hostTouchUnsupported = true;
+    }
+
+    // Fallback to move cursor and click if touch unsupported
+    if (!primary) return;
+
+    if (touch.phase != TouchPhase::NONE) {
+        InputSink::sendMousePositionEvent(touch.x, touch.y, frame.contentWidth,
+                                          frame.contentHeight);
+        touchEventsSent++;
+    }
+    if (touch.phase == TouchPhase::START) {
+        InputSink::sendMouseButtonEvent(BUTTON_ACTION_PRESS, BUTTON_MOUSE_LEFT);
+        touchEventsSent++;
+    }
+    if (touch.phase == TouchPhase::END) {
+        InputSink::sendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_MOUSE_LEFT);
+        touchEventsSent++;
+    }
+}
+
+short MoonlightInputManager::controllersToMap(int controllersCount) {
+    switch (controllersCount) {
     case 0:
         return 0x0;
     case 1:
@@ -537,30 +1031,14 @@ short MoonlightInputManager::controllersToMap() {
     }
 }
 
-brls::ControllerState
-MoonlightInputManager::mapController(brls::ControllerState controller) {
-    brls::ControllerState result{};
-
-    std::fill(result.buttons, result.buttons + sizeof(result.buttons), false);
-
-    for (int i = 0; i < _AXES_MAX; i++)
-        result.axes[i] = controller.axes[i];
-
-    for (int i = 0; i < _BUTTON_MAX; i++) {
-        result.buttons[mappingButtons[i]] |= controller.buttons[i];
-    }
-
-    return result;
-}
-
 void MoonlightInputManager::leftMouseClick() {
-    LiSendMouseButtonEvent(BUTTON_ACTION_PRESS, BUTTON_MOUSE_LEFT);
-    LiSendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_MOUSE_LEFT);
+    InputSink::sendMouseButtonEvent(BUTTON_ACTION_PRESS, BUTTON_MOUSE_LEFT);
+    InputSink::sendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_MOUSE_LEFT);
 }
 
 void MoonlightInputManager::rightMouseClick() {
-    LiSendMouseButtonEvent(BUTTON_ACTION_PRESS, BUTTON_MOUSE_RIGHT);
-    LiSendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_MOUSE_RIGHT);
+    InputSink::sendMouseButtonEvent(BUTTON_ACTION_PRESS, BUTTON_MOUSE_RIGHT);
+    InputSink::sendMouseButtonEvent(BUTTON_ACTION_RELEASE, BUTTON_MOUSE_RIGHT);
 }
 
 short MoonlightInputManager::glfwKeyToVKKey(BrlsKeyboardScancode key) {
@@ -661,6 +1139,12 @@ short MoonlightInputManager::glfwKeyToVKKey(BrlsKeyboardScancode key) {
         return 0x2E;
 
     default:
-        return key;
+        // Space, digits and letters share their codes with virtual keys,
+        // anything else has no virtual key and is not sent
+        if (key == BRLS_KBD_KEY_SPACE ||
+            (BRLS_KBD_KEY_0 <= key && key <= BRLS_KBD_KEY_9) ||
+            (BRLS_KBD_KEY_A <= key && key <= BRLS_KBD_KEY_Z))
+            return key;
+        return -1;
     }
 }
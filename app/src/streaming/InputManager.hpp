@@ -7,31 +7,19 @@
 
 #pragma once
 
+#include "ControllerMapping.hpp"
+#include "InputClock.hpp"
+#include "InputRecorder.hpp"
+#include "MotionForwarder.hpp"
+#include "PointerPipeline.hpp"
 #include "Singleton.hpp"
 #include "keyboard_view.hpp"
 #include <borealis.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <optional>
-
-// Moonlight ready gamepad
-struct GamepadState {
-    short buttonFlags = 0;
-    unsigned char leftTrigger = 0;
-    unsigned char rightTrigger = 0;
-    short leftStickX = 0;
-    short leftStickY = 0;
-    short rightStickX = 0;
-    short rightStickY = 0;
-
-    bool is_equal(GamepadState other) {
-        return buttonFlags == other.buttonFlags &&
-               leftTrigger == other.leftTrigger &&
-               rightTrigger == other.rightTrigger &&
-               leftStickX == other.leftStickX &&
-               leftStickY == other.leftStickY &&
-               rightStickX == other.rightStickX &&
-               rightStickY == other.rightStickY;
-    }
-};
+#include <thread>
 
 struct MouseStateS {
     float scroll_y = 0;
@@ -41,41 +29,192 @@ struct MouseStateS {
 };
 
 struct RumbleValues {
-    unsigned short lowFreqMotor;
-    unsigned short highFreqMotor;
-    uint16_t leftTriggerMotor;
-    uint16_t rightTriggerMotor;
+    unsigned short lowFreqMotor = 0;
+    unsigned short highFreqMotor = 0;
+    uint16_t leftTriggerMotor = 0;
+    uint16_t rightTriggerMotor = 0;
+};
+
+struct InputLatencyStats {
+    int samplingRate = 0;
+    float averagePollToSendMs = 0;
+    float maxPollToSendMs = 0;
+    uint64_t eventsSent = 0;
+    // Jitter filtered out by hysteresis or axis updates coalesced
+    uint64_t eventsSuppressed = 0;
+    int motionSendRate = 0;
+    uint64_t pointerInputs = 0;
+    uint64_t pointerSends = 0;
+    uint64_t keyEventsSent = 0;
+    // Releases dropInput() did not send for keys that were not held
+    uint64_t keyReleasesAvoided = 0;
+    // Touch and touch fallback mouse events per second
+    int touchEventRate = 0;
+    uint64_t touchMovesSkipped = 0;
+    // Posted by the host, applied to controllers, and overwritten before
+    // being applied or aimed at a missing controller
+    uint64_t rumbleUpdates = 0;
+    uint64_t rumbleApplied = 0;
+    uint64_t rumbleCoalesced = 0;
 };
 
 class MoonlightInputManager : public Singleton<MoonlightInputManager> {
   public:
     MoonlightInputManager();
+    ~MoonlightInputManager() { stopSampling(); }
     void dropInput();
     void handleInput(bool ignoreTouch = false);
+    // Called from the connection thread, the values are applied by the
+    // thread polling the controllers
     void handleRumble(unsigned short controller, unsigned short lowFreqMotor, unsigned short highFreqMotor);
     void handleRumbleTriggers(unsigned short controller, unsigned short lowFreqMotor, unsigned short highFreqMotor);
+    void handleMotionEventState(uint16_t controller, uint8_t motionType, uint16_t reportRateHz);
+    // Forgets what the previous host asked for, before a new connection
+    void resetConnectionState();
     void updateTouchScreenPanDelta(brls::PanGestureStatus panStatus);
+    // Relative motion in host pixels and scrolling in PointerPipeline units,
+    // sent coalesced by the next flushPointer()
+    void addPointerMove(float x, float y) { pointer.addMove(x, y); }
+    void addPointerScroll(float x, float y) { pointer.addScroll(x, y); }
+    void flushPointer() { pointer.flush(); }
+
+    // Sends a key and tracks it as held until it is released or dropped,
+    // codes outside the 256 virtual keys are ignored
+    void sendKeyboardEvent(short vkKey, bool pressed, char modifiers = 0);
+    // Sends the on-screen keyboard keys that differ from `sent`, then
+    // updates it
+    void sendKeyboardChanges(KeyboardView* keyboard, const KeyboardState& state,
+                             KeyboardState& sent);
+    // Recompiles the mapping after the layout, a combo or another input
+    // setting changed
     void reloadButtonMappingLayout();
+    const CompiledInputMapping& compiledMapping() const {
+        return compiledMappings[activeMapping];
+    }
     void setInputEnabled(bool enabled) { inputEnabled = enabled; }
+
+    // Records every frame and platform event handled by handleInput() until
+    // stopRecording(), see InputReplay
+    bool startRecording(const std::string& path);
+    void stopRecording();
+    // While replaying platform input is ignored and only replayEvent() and
+    // replayFrame() reach the pipeline
+    void setReplaying(bool replaying);
+    void replayEvent(const InputEvent& event);
+    void replayFrame(const InputFrame& frame);
+
+    // Controllers are polled and sent from their own thread at
+    // Settings::input_sampling_rate() where the platform can be read off the
+    // UI thread, otherwise once per frame from handleInput()
+    void startSampling();
+    void stopSampling();
+    InputLatencyStats latencyStats();
+
     static void leftMouseClick();
     static void rightMouseClick();
 
   private:
+    // Latest motor values from the host per controller
+    struct RumbleMailbox {
+        // Low, high, left trigger and right trigger motors, 16 bits each
+        std::atomic<uint64_t> motors = 0;
+        std::atomic<bool> pending = false;
+    };
+    RumbleMailbox rumbleMailboxes[GAMEPADS_MAX];
+    // Last values applied, owned by the thread polling the controllers
     RumbleValues rumbleCache[GAMEPADS_MAX];
+    std::atomic<uint64_t> rumblePosts = 0;
+    std::atomic<uint64_t> rumbleApplied = 0;
+    std::atomic<uint64_t> rumbleCoalesced = 0;
+    std::atomic<uint64_t> rumbleDropped = 0;
+    // Last state sent per controller
     GamepadState lastGamepadStates[GAMEPADS_MAX];
-    brls::ControllerButton mappingButtons[brls::_BUTTON_MAX];
-    std::optional<brls::PanGestureStatus> panStatus;
-    std::map<uint32_t, bool> activeTouchIDs;
-    brls::Point desktopMouseRemainder = {0, 0};
+    std::chrono::steady_clock::time_point lastGamepadSends[GAMEPADS_MAX];
+    // Double buffered, the sampling thread may be mapping while the overlay
+    // changes the guide combo
+    CompiledInputMapping compiledMappings[2];
+    std::atomic<int> activeMapping = 0;
+    std::optional<brls::Point> panDelta;
+    struct TouchSlot {
+        bool active = false;
+        // A position was sent for the finger
+        bool moved = false;
+        uint32_t fingerId = 0;
+        float x = 0;
+        float y = 0;
+    };
+    static constexpr int TOUCH_SLOTS = 10;
+    TouchSlot touchSlots[TOUCH_SLOTS];
+    // Set once the host rejects a touch event, set back per connection
+    std::atomic<bool> hostTouchUnsupported = false;
+    uint64_t touchEventsSent = 0;
+    uint64_t touchMovesSkipped = 0;
+    PointerPipeline pointer;
+    // Virtual key codes currently held on the host
+    uint64_t heldKeys[4] = {};
+    uint64_t keyEventsSent = 0;
+    uint64_t keyReleasesAvoided = 0;
+    MotionForwarder motionForwarder;
     bool inputDropped = false;
-    bool inputEnabled = true;
+    std::atomic<bool> inputEnabled = true;
+    int lastControllerCount = 0;
+    MouseStateS lastMouseState;
+    InputClock::time_point scrollTimeStamp;
+
+    InputRecorder recorder;
+    // Platform events since the last recorded frame
+    std::vector<InputEvent> pendingEvents;
+    bool replaying = false;
+    InputFrame currentFrame;
+    InputClock::time_point controllersReadAt;
+    std::vector<brls::RawTouchState> rawTouchStates;
+
+    std::thread samplingThread;
+    std::atomic<bool> samplingRunning = false;
+    // Written by the UI thread every frame, read by the sampling thread
+    std::atomic<bool> specialKeyActive = false;
+    std::atomic<uint64_t> polls = 0;
+    std::atomic<uint64_t> sends = 0;
+    std::atomic<uint64_t> suppressedSends = 0;
+    std::atomic<uint64_t> pollToSendTotalUs = 0;
+    std::atomic<uint64_t> pollToSendMaxUs = 0;
+    std::chrono::steady_clock::time_point statsWindowStart;
+    uint64_t statsWindowPolls = 0;
+    int measuredSamplingRate = 0;
+    uint64_t statsWindowTouchEvents = 0;
+    int measuredTouchEventRate = 0;
+
+    void samplingLoop(std::chrono::steady_clock::duration period);
+    void recordPollToSend(std::chrono::steady_clock::time_point polled);
+
+    void handlePlatformEvent(InputEvent event);
+    void handleEvent(const InputEvent& event);
+    void readFrame(InputFrame& frame, bool ignoreTouch);
+    void processFrame(const InputFrame& frame);
+    // Replaces the motors selected by `mask` in the controller's mailbox
+    void postRumble(unsigned short controller, uint64_t motors, uint64_t mask);
+    void applyRumble(int controllersCount);
+    // The slot tracking `fingerId`, a free one taken for it when `allocate`
+    TouchSlot* touchSlot(uint32_t fingerId, bool allocate);
+    // Cancels tracked fingers that are not down over the stream in `frame`,
+    // all of them unless `handled`
+    void releaseMissingTouches(const InputFrame& frame, bool handled);
+    void sendTouch(const InputTouch& touch, bool primary, const InputFrame& frame);
 
-    brls::ControllerState mapController(brls::ControllerState controller);
+    // -1 for keys without a virtual key
     static short glfwKeyToVKKey(brls::BrlsKeyboardScancode key);
-    void sendRelativeMouseMove(brls::Point offset);
 
-    GamepadState getControllerState(int controllerNum, bool specialKey);
-    void handleControllers(bool specialKey);
+    GamepadState getControllerState(int controllerNum,
+                                    const brls::ControllerState& controller,
+                                    bool specialKey);
+    // Reads the controllers from `frame` when given, else from the platform.
+    // `readAt` is when the frame's controllers were read.
+    void handleControllers(bool specialKey, const InputFrame* frame = nullptr,
+                           InputClock::time_point readAt = {});
+    static void filterAxes(GamepadState& state, const GamepadState& sent);
+    static bool canSampleOffUIThread();
+    // Setups only the UI thread's controller path handles
+    static bool controllersNeedUIThread();
 
-    static short controllersToMap();
+    static short controllersToMap(int controllersCount);
 };
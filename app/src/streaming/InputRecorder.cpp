@@ -0,0 +1,325 @@
+#include "InputRecorder.hpp"
+#include "InputClock.hpp"
+#include "InputManager.hpp"
+#include "InputSink.hpp"
+#include <cstring>
+
+namespace {
+constexpr uint32_t RECORDING_MAGIC = 0x524c4d49; // "IMLR"
+constexpr uint32_t RECORDING_VERSION = 1;
+// Sanity limits for counts read from a recording
+constexpr uint32_t MAX_ITEMS = 4096;
+
+class RecordingWriter {
+  public:
+    explicit RecordingWriter(std::ofstream& file) : file(file) {}
+
+    template <typename T> void value(T value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void controller(const brls::ControllerState& state) {
+        for (int i = 0; i < brls::_BUTTON_MAX; i++)
+            value<uint8_t>(state.buttons[i]);
+        for (int i = 0; i < brls::_AXES_MAX; i++)
+            value<float>(state.axes[i]);
+    }
+
+  private:
+    std::ofstream& file;
+};
+
+class RecordingReader {
+  public:
+    explicit RecordingReader(const std::string& bytes) : bytes(bytes) {}
+
+    template <typename T> bool value(T& value) {
+        if (sizeof(value) > bytes.size() - offset)
+            return false;
+        std::memcpy(&value, bytes.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    }
+
+    bool flag(bool& value) {
+        uint8_t raw = 0;
+        if (!this->value(raw))
+            return false;
+        value = raw != 0;
+        return true;
+    }
+
+    bool count(uint32_t& value) {
+        return this->value(value) && value <= MAX_ITEMS;
+    }
+
+    bool controller(brls::ControllerState& state) {
+        state = brls::ControllerState{};
+        for (int i = 0; i < brls::_BUTTON_MAX; i++) {
+            if (!flag(state.buttons[i]))
+                return false;
+        }
+        for (int i = 0; i < brls::_AXES_MAX; i++) {
+            if (!value(state.axes[i]))
+                return false;
+        }
+        return true;
+    }
+
+    bool finished() const { return offset == bytes.size(); }
+
+  private:
+    const std::string& bytes;
+    size_t offset = 0;
+};
+
+bool readEvent(RecordingReader& reader, InputEvent& event) {
+    uint8_t type = 0;
+    if (!reader.value(type) || type > (uint8_t)InputEvent::Type::PAN)
+        return false;
+    event.type = (InputEvent::Type)type;
+    return reader.value(event.timeUs) && reader.value(event.x) &&
+           reader.value(event.y) && reader.value(event.z) &&
+           reader.value(event.code) && reader.value(event.mods) &&
+           reader.flag(event.pressed) && reader.value(event.controller);
+}
+
+bool readFrame(RecordingReader& reader, InputFrame& frame) {
+    uint32_t controllers = 0;
+    if (!reader.value(frame.timeUs) || !reader.flag(frame.ignoreTouch) ||
+        !reader.value(frame.contentWidth) ||
+        !reader.value(frame.contentHeight) || !reader.count(controllers))
+        return false;
+
+    frame.controllers.resize(controllers);
+    for (auto& controller : frame.controllers) {
+        if (!reader.controller(controller))
+            return false;
+    }
+
+    uint32_t touches = 0;
+    int32_t touchStates = 0;
+    frame.mouse = brls::RawMouseState{};
+    if (!reader.controller(frame.unified) ||
+        !reader.flag(frame.mouse.leftButton) ||
+        !reader.flag(frame.mouse.middleButton) ||
+        !reader.flag(frame.mouse.rightButton) ||
+        !reader.value(touchStates) || !reader.count(touches))
+        return false;
+    frame.touchStates = touchStates;
+
+    frame.touches.resize(touches);
+    for (auto& touch : frame.touches) {
+        uint8_t phase = 0;
+        if (!reader.value(touch.fingerId) || !reader.value(touch.x) ||
+            !reader.value(touch.y) || !reader.value(phase) ||
+            !reader.flag(touch.blocked))
+            return false;
+        touch.phase = (brls::TouchPhase)phase;
+    }
+
+    uint32_t events = 0;
+    if (!reader.count(events))
+        return false;
+    frame.events.resize(events);
+    for (auto& event : frame.events) {
+        if (!readEvent(reader, event))
+            return false;
+    }
+    return true;
+}
+
+std::vector<std::string> readLines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::ifstream file(path);
+    for (std::string line; std::getline(file, line);)
+        lines.push_back(line);
+    return lines;
+}
+
+void writeLines(const std::string& path, const std::vector<std::string>& lines) {
+    std::ofstream file(path, std::ios::trunc);
+    for (const auto& line : lines)
+        file << line << '\n';
+}
+}
+
+// MARK: - InputRecorder
+
+bool InputRecorder::open(const std::string& path) {
+    close();
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        brls::Logger::error("InputRecorder: Failed to open {}", path);
+        return false;
+    }
+
+    RecordingWriter writer(file);
+    writer.value(RECORDING_MAGIC);
+    writer.value(RECORDING_VERSION);
+    writer.value<uint32_t>(brls::_BUTTON_MAX);
+    writer.value<uint32_t>(brls::_AXES_MAX);
+
+    started = std::chrono::steady_clock::now();
+    brls::Logger::info("InputRecorder: Recording input to {}", path);
+    return true;
+}
+
+void InputRecorder::close() {
+    if (file.is_open())
+        file.close();
+}
+
+void InputRecorder::flush() {
+    if (file.is_open())
+        file.flush();
+}
+
+uint64_t InputRecorder::elapsedUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - started)
+        .count();
+}
+
+void InputRecorder::write(const InputFrame& frame) {
+    RecordingWriter writer(file);
+    writer.value(frame.timeUs);
+    writer.value<uint8_t>(frame.ignoreTouch);
+    writer.value(frame.contentWidth);
+    writer.value(frame.contentHeight);
+
+    writer.value<uint32_t>((uint32_t)frame.controllers.size());
+    for (const auto& controller : frame.controllers)
+        writer.controller(controller);
+
+    writer.controller(frame.unified);
+    writer.value<uint8_t>(frame.mouse.leftButton);
+    writer.value<uint8_t>(frame.mouse.middleButton);
+    writer.value<uint8_t>(frame.mouse.rightButton);
+    writer.value<int32_t>(frame.touchStates);
+
+    writer.value<uint32_t>((uint32_t)frame.touches.size());
+    for (const auto& touch : frame.touches) {
+        writer.value(touch.fingerId);
+        writer.value(touch.x);
+        writer.value(touch.y);
+        writer.value<uint8_t>((uint8_t)touch.phase);
+        writer.value<uint8_t>(touch.blocked);
+    }
+
+    writer.value<uint32_t>((uint32_t)frame.events.size());
+    for (const auto& event : frame.events) {
+        writer.value<uint8_t>((uint8_t)event.type);
+        writer.value(event.timeUs);
+        writer.value(event.x);
+        writer.value(event.y);
+        writer.value(event.z);
+        writer.value(event.code);
+        writer.value(event.mods);
+        writer.value<uint8_t>(event.pressed);
+        writer.value(event.controller);
+    }
+}
+
+// MARK: - InputReplay
+
+bool InputReplay::load(const std::string& path,
+                       std::vector<InputFrame>& frames) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        brls::Logger::error("InputReplay: Failed to open {}", path);
+        return false;
+    }
+
+    std::string bytes(size_t(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(bytes.data(), (std::streamsize)bytes.size());
+
+    RecordingReader reader(bytes);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t buttons = 0;
+    uint32_t axes = 0;
+    if (!reader.value(magic) || magic != RECORDING_MAGIC ||
+        !reader.value(version) || version != RECORDING_VERSION ||
+        !reader.value(buttons) || buttons != brls::_BUTTON_MAX ||
+        !reader.value(axes) || axes != brls::_AXES_MAX) {
+        brls::Logger::error("InputReplay: {} is not a recording of this build",
+                            path);
+        return false;
+    }
+
+    frames.clear();
+    while (!reader.finished()) {
+        InputFrame frame;
+        if (!readFrame(reader, frame)) {
+            // A recording cut short keeps its complete frames
+            brls::Logger::warning("InputReplay: Truncated frame {} in {}",
+                                  frames.size(), path);
+            break;
+        }
+        frames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+bool InputReplay::run(const std::string& path) {
+    std::vector<InputFrame> frames;
+    if (!load(path, frames))
+        return false;
+
+    auto& input = MoonlightInputManager::instance();
+    input.setReplaying(true);
+    InputSink::startCapture();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> timing;
+    timing.reserve(frames.size());
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        const auto& frame = frames[i];
+        const size_t emittedBefore = InputSink::capturedCount();
+        const auto processingStart = std::chrono::steady_clock::now();
+
+        for (const auto& event : frame.events) {
+            InputClock::pin(start + std::chrono::microseconds(event.timeUs));
+            input.replayEvent(event);
+        }
+        InputClock::pin(start + std::chrono::microseconds(frame.timeUs));
+        input.replayFrame(frame);
+
+        const auto processing = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - processingStart);
+        timing.push_back(fmt::format("frame {} {} us {} events", i,
+                                     processing.count(),
+                                     InputSink::capturedCount() - emittedBefore));
+    }
+
+    InputClock::unpin();
+    auto emitted = InputSink::stopCapture();
+    input.setReplaying(false);
+
+    writeLines(path + ".events", emitted);
+    writeLines(path + ".timing", timing);
+    brls::Logger::info("InputReplay: {} frames replayed, {} events emitted",
+                       frames.size(), emitted.size());
+
+    const auto golden = readLines(path + ".golden");
+    if (golden.empty())
+        return true;
+
+    for (size_t i = 0; i < std::max(golden.size(), emitted.size()); i++) {
+        const std::string expected = i < golden.size() ? golden[i] : "<end>";
+        const std::string actual = i < emitted.size() ? emitted[i] : "<end>";
+        if (expected != actual) {
+            brls::Logger::error("InputReplay: Event {} differs from golden, "
+                                "expected '{}' got '{}'",
+                                i, expected, actual);
+            return false;
+        }
+    }
+
+    brls::Logger::info("InputReplay: Matches {}.golden", path);
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <borealis.hpp>
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A touch as the input pipeline sees it
+struct InputTouch {
+    uint32_t fingerId = 0;
+    float x = 0;
+    float y = 0;
+    brls::TouchPhase phase = brls::TouchPhase::NONE;
+    // Over a view other than the stream, e.g. the on-screen keyboard
+    bool blocked = false;
+};
+
+// An input delivered by a platform event between two frames
+struct InputEvent {
+    enum class Type : uint8_t {
+        MOUSE_OFFSET,
+        MOUSE_SCROLL,
+        KEY,
+        SENSOR,
+        PAN,
+    };
+
+    Type type = Type::MOUSE_OFFSET;
+    uint64_t timeUs = 0;
+    float x = 0;
+    float y = 0;
+    float z = 0;
+    // Scancode for keys, brls::SensorEventType for sensors
+    int32_t code = 0;
+    int32_t mods = 0;
+    bool pressed = false;
+    uint8_t controller = 0;
+};
+
+// Everything MoonlightInputManager reads from the platform for one
+// handleInput() call
+struct InputFrame {
+    // Since the start of the recording
+    uint64_t timeUs = 0;
+    bool ignoreTouch = false;
+    float contentWidth = 0;
+    float contentHeight = 0;
+    std::vector<brls::ControllerState> controllers;
+    brls::ControllerState unified{};
+    brls::RawMouseState mouse{};
+    int touchStates = 0;
+    std::vector<InputTouch> touches;
+    std::vector<InputEvent> events;
+};
+
+// Writes frames to a recording, see InputReplay for playing it back
+class InputRecorder {
+  public:
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+    // Microseconds since open()
+    uint64_t elapsedUs() const;
+    void write(const InputFrame& frame);
+    void flush();
+
+  private:
+    std::ofstream file;
+    std::chrono::steady_clock::time_point started;
+};
+
+// Plays a recording back through MoonlightInputManager with the LiSend*
+// calls captured by InputSink and the input clock pinned to the recorded
+// times. The emitted stream is written to <recording>.events and compared
+// with <recording>.golden when that exists, per frame processing times go
+// to <recording>.timing.
+//
+// The stream also depends on the settings in effect, goldens have to be
+// recorded and replayed with the same settings.
+// tools/input_replay/run.sh replays the checked-in sessions with the default
+// settings.
+class InputReplay {
+  public:
+    static bool load(const std::string& path, std::vector<InputFrame>& frames);
+    // True when the replay ran and matched the golden file, if any
+    static bool run(const std::string& path);
+};
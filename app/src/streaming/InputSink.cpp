@@ -0,0 +1,138 @@
+#include "InputSink.hpp"
+#include "Limelight.h"
+#include <borealis.hpp>
+
+void InputSink::startCapture() {
+    std::lock_guard<std::mutex> lock(captureMutex);
+    captured.clear();
+    captureActive = true;
+}
+
+std::vector<std::string> InputSink::stopCapture() {
+    std::lock_guard<std::mutex> lock(captureMutex);
+    captureActive = false;
+    return std::move(captured);
+}
+
+size_t InputSink::capturedCount() {
+    std::lock_guard<std::mutex> lock(captureMutex);
+    return captured.size();
+}
+
+void InputSink::capture(std::string line) {
+    std::lock_guard<std::mutex> lock(captureMutex);
+    captured.push_back(std::move(line));
+}
+
+int InputSink::sendMultiControllerEvent(short controllerNumber,
+                                        short activeGamepadMask,
+                                        int buttonFlags,
+                                        unsigned char leftTrigger,
+                                        unsigned char rightTrigger,
+                                        short leftStickX, short leftStickY,
+                                        short rightStickX, short rightStickY) {
+    if (captureActive) {
+        capture(fmt::format("controller {} {} {:#x} {} {} {} {} {} {}",
+                            controllerNumber, activeGamepadMask, buttonFlags,
+                            leftTrigger, rightTrigger, leftStickX, leftStickY,
+                            rightStickX, rightStickY));
+        return 0;
+    }
+    return LiSendMultiControllerEvent(controllerNumber, activeGamepadMask,
+                                      buttonFlags, leftTrigger, rightTrigger,
+                                      leftStickX, leftStickY, rightStickX,
+                                      rightStickY);
+}
+
+int InputSink::sendControllerArrivalEvent(uint8_t controllerNumber,
+                                          uint16_t activeGamepadMask,
+                                          uint8_t type,
+                                          uint32_t supportedButtonFlags,
+                                          uint16_t capabilities) {
+    if (captureActive) {
+        capture(fmt::format("arrival {} {} {} {:#x} {:#x}", controllerNumber,
+                            activeGamepadMask, type, supportedButtonFlags,
+                            capabilities));
+        return 0;
+    }
+    return LiSendControllerArrivalEvent(controllerNumber, activeGamepadMask,
+                                        type, supportedButtonFlags,
+                                        capabilities);
+}
+
+int InputSink::sendControllerMotionEvent(uint8_t controllerNumber,
+                                         uint8_t motionType, float x, float y,
+                                         float z) {
+    if (captureActive) {
+        capture(fmt::format("motion {} {} {:.4f} {:.4f} {:.4f}",
+                            controllerNumber, motionType, x, y, z));
+        return 0;
+    }
+    return LiSendControllerMotionEvent(controllerNumber, motionType, x, y, z);
+}
+
+int InputSink::sendMouseMoveEvent(short deltaX, short deltaY) {
+    if (captureActive) {
+        capture(fmt::format("mouse_move {} {}", deltaX, deltaY));
+        return 0;
+    }
+    return LiSendMouseMoveEvent(deltaX, deltaY);
+}
+
+int InputSink::sendMousePositionEvent(short x, short y, short referenceWidth,
+                                      short referenceHeight) {
+    if (captureActive) {
+        capture(fmt::format("mouse_position {} {} {} {}", x, y,
+                            referenceWidth, referenceHeight));
+        return 0;
+    }
+    return LiSendMousePositionEvent(x, y, referenceWidth, referenceHeight);
+}
+
+int InputSink::sendMouseButtonEvent(char action, int button) {
+    if (captureActive) {
+        capture(fmt::format("mouse_button {} {}", int(action), button));
+        return 0;
+    }
+    return LiSendMouseButtonEvent(action, button);
+}
+
+int InputSink::sendHighResScrollEvent(short scrollAmount) {
+    if (captureActive) {
+        capture(fmt::format("scroll {}", scrollAmount));
+        return 0;
+    }
+    return LiSendHighResScrollEvent(scrollAmount);
+}
+
+int InputSink::sendHighResHScrollEvent(short scrollAmount) {
+    if (captureActive) {
+        capture(fmt::format("hscroll {}", scrollAmount));
+        return 0;
+    }
+    return LiSendHighResHScrollEvent(scrollAmount);
+}
+
+int InputSink::sendKeyboardEvent(short keyCode, char keyAction,
+                                 char modifiers) {
+    if (captureActive) {
+        capture(fmt::format("key {:#x} {} {:#x}", keyCode, int(keyAction),
+                            int(modifiers)));
+        return 0;
+    }
+    return LiSendKeyboardEvent(keyCode, keyAction, modifiers);
+}
+
+int InputSink::sendTouchEvent(uint8_t eventType, uint32_t pointerId, float x,
+                              float y, float pressureOrDistance,
+                              float contactAreaMajor, float contactAreaMinor,
+                              uint16_t rotation) {
+    if (captureActive) {
+        capture(fmt::format("touch {} {} {:.4f} {:.4f} {:.4f} {:.4f} {:.4f} {}",
+                            eventType, pointerId, x, y, pressureOrDistance,
+                            contactAreaMajor, contactAreaMinor, rotation));
+        return 0;
+    }
+    return LiSendTouchEvent(eventType, pointerId, x, y, pressureOrDistance,
+                            contactAreaMajor, contactAreaMinor, rotation);
+}
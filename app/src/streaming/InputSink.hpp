@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Every LiSend* call of the input pipeline goes through here. Calls are
+// forwarded to moonlight-common-c, except while capturing: then nothing is
+// sent and each call is kept as a line of text, the stream an input replay
+// compares against its golden file.
+class InputSink {
+  public:
+    static void startCapture();
+    // Lines captured since startCapture(), capturing stops
+    static std::vector<std::string> stopCapture();
+    static bool capturing() { return captureActive; }
+    static size_t capturedCount();
+
+    static int sendMultiControllerEvent(short controllerNumber,
+                                        short activeGamepadMask,
+                                        int buttonFlags,
+                                        unsigned char leftTrigger,
+                                        unsigned char rightTrigger,
+                                        short leftStickX, short leftStickY,
+                                        short rightStickX, short rightStickY);
+    static int sendControllerArrivalEvent(uint8_t controllerNumber,
+                                          uint16_t activeGamepadMask,
+                                          uint8_t type,
+                                          uint32_t supportedButtonFlags,
+                                          uint16_t capabilities);
+    static int sendControllerMotionEvent(uint8_t controllerNumber,
+                                         uint8_t motionType, float x, float y,
+                                         float z);
+    static int sendMouseMoveEvent(short deltaX, short deltaY);
+    static int sendMousePositionEvent(short x, short y, short referenceWidth,
+                                      short referenceHeight);
+    static int sendMouseButtonEvent(char action, int button);
+    static int sendHighResScrollEvent(short scrollAmount);
+    static int sendHighResHScrollEvent(short scrollAmount);
+    static int sendKeyboardEvent(short keyCode, char keyAction,
+                                 char modifiers);
+    static int sendTouchEvent(uint8_t eventType, uint32_t pointerId, float x,
+                              float y, float pressureOrDistance,
+                              float contactAreaMajor, float contactAreaMinor,
+                              uint16_t rotation);
+
+  private:
+    static void capture(std::string line);
+
+    inline static std::atomic<bool> captureActive = false;
+    inline static std::mutex captureMutex;
+    inline static std::vector<std::string> captured;
+};
@@ -148,7 +148,15 @@ void MoonlightSession::connection_rumble_triggers(uint16_t controllerNumber,
                                                   uint16_t leftTriggerMotor, 
                                                   uint16_t rightTriggerMotor) 
 {
-    // MoonlightInputManager::instance().handleRumbleTriggers(controllerNumber, leftTriggerMotor, rightTriggerMotor);                                                
+    MoonlightInputManager::instance().handleRumbleTriggers(
+        controllerNumber, leftTriggerMotor, rightTriggerMotor);
+}
+
+void MoonlightSession::connection_set_motion_event_state(uint16_t controllerNumber,
+                                                         uint8_t motionType,
+                                                         uint16_t reportRateHz) {
+    MoonlightInputManager::instance().handleMotionEventState(
+        controllerNumber, motionType, reportRateHz);
 }
 
 void MoonlightSession::connection_status_update(int connection_status) {
@@ -305,6 +313,8 @@ void MoonlightSession::start(ServerCallback<bool> callback, bool is_sunshine) {
         break;
     }
 
+    MoonlightInputManager::instance().resetConnectionState();
+
     LiInitializeConnectionCallbacks(&m_connection_callbacks);
     m_connection_callbacks.stageStarting = connection_stage_starting;
     m_connection_callbacks.stageComplete = connection_stage_complete;
@@ -314,6 +324,7 @@ void MoonlightSession::start(ServerCallback<bool> callback, bool is_sunshine) {
     m_connection_callbacks.logMessage = connection_log_message;
     m_connection_callbacks.rumble = connection_rumble;
     m_connection_callbacks.rumbleTriggers = connection_rumble_triggers;
+    m_connection_callbacks.setMotionEventState = connection_set_motion_event_state;
     m_connection_callbacks.connectionStatusUpdate = connection_status_update;
     m_connection_callbacks.setHdrMode = connection_set_hdr_mode;
 
@@ -53,6 +53,9 @@ class MoonlightSession {
                                   unsigned short);
     static void connection_rumble_triggers(uint16_t controllerNumber,
                                            uint16_t leftTriggerMotor, uint16_t rightTriggerMotor);
+    static void connection_set_motion_event_state(uint16_t controllerNumber,
+                                                  uint8_t motionType,
+                                                  uint16_t reportRateHz);
     static void connection_status_update(int);
     static void connection_set_hdr_mode(bool);
 
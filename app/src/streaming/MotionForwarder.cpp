@@ -0,0 +1,141 @@
+#include "MotionForwarder.hpp"
+#include "InputClock.hpp"
+#include "InputSink.hpp"
+#include "Limelight.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Hosts that never ask for a rate still get motion, at a sensible pace
+constexpr uint16_t DEFAULT_REPORT_RATE_HZ = 100;
+// Readings closer than this to the last report are not sent again
+constexpr float UNCHANGED_EPSILON = 0.001f;
+// After a longer gap between samples the next one starts a fresh window
+constexpr auto MAX_SAMPLE_GAP = std::chrono::milliseconds(50);
+}
+
+MotionForwarder::MotionForwarder() { resetReportRates(); }
+
+MotionForwarder::Channel* MotionForwarder::channel(uint16_t controller,
+                                                   uint8_t motionType) {
+    if (controller >= GAMEPADS_MAX ||
+        (motionType != LI_MOTION_TYPE_ACCEL && motionType != LI_MOTION_TYPE_GYRO))
+        return nullptr;
+    return &channels[controller][motionType == LI_MOTION_TYPE_ACCEL ? 0 : 1];
+}
+
+void MotionForwarder::setReportRate(uint16_t controller, uint8_t motionType,
+                                    uint16_t reportRateHz) {
+    Channel* target = channel(controller, motionType);
+    if (!target) {
+        brls::Logger::warning("MotionForwarder: Ignoring report rate for controller {} sensor {}",
+                              controller, motionType);
+        return;
+    }
+
+    brls::Logger::info("MotionForwarder: Host requested {} Hz for controller {} sensor {}",
+                       reportRateHz, controller, motionType);
+    target->reportRateHz = reportRateHz;
+}
+
+void MotionForwarder::resetReportRates() {
+    for (auto& controller : channels) {
+        for (auto& sensor : controller)
+            sensor.reportRateHz = DEFAULT_REPORT_RATE_HZ;
+    }
+}
+
+void MotionForwarder::reset() {
+    for (auto& controller : channels) {
+        for (auto& sensor : controller) {
+            sensor.hasSample = false;
+            sensor.count = 0;
+            std::fill(sensor.sum, sensor.sum + 3, 0.f);
+            sensor.hasSent = false;
+        }
+    }
+}
+
+void MotionForwarder::addSample(uint8_t controller, uint8_t motionType,
+                                float x, float y, float z) {
+    Channel* target = channel(controller, motionType);
+    if (!target)
+        return;
+
+    const uint16_t rate = target->reportRateHz;
+    if (rate == 0)
+        return;
+
+    const auto now = InputClock::now();
+    const float sample[3] = {x, y, z};
+
+    if (!target->hasSample || now - target->sampleTime > MAX_SAMPLE_GAP) {
+        target->hasSample = true;
+        target->count = 0;
+        std::fill(target->sum, target->sum + 3, 0.f);
+        target->sampleTime = now;
+        target->windowStart = now;
+    }
+
+    if (motionType == LI_MOTION_TYPE_GYRO) {
+        // The reading is the rate over the interval it ends
+        const float held =
+            std::chrono::duration<float>(now - target->sampleTime).count();
+        for (int i = 0; i < 3; i++)
+            target->sum[i] += sample[i] * held;
+    } else {
+        for (int i = 0; i < 3; i++)
+            target->sum[i] += sample[i];
+    }
+
+    std::copy(sample, sample + 3, target->sample);
+    target->sampleTime = now;
+    target->count++;
+
+    const auto period = std::chrono::duration<double>(1.0 / rate);
+    if (!target->hasSent || now - target->windowStart >= period)
+        send(controller, motionType, *target, now);
+}
+
+void MotionForwarder::send(uint8_t controller, uint8_t motionType,
+                           Channel& channel,
+                           std::chrono::steady_clock::time_point now) {
+    float value[3];
+    if (motionType == LI_MOTION_TYPE_GYRO) {
+        const float window =
+            std::chrono::duration<float>(now - channel.windowStart).count();
+        for (int i = 0; i < 3; i++)
+            value[i] = window > 0 ? channel.sum[i] / window : channel.sample[i];
+    } else {
+        for (int i = 0; i < 3; i++)
+            value[i] = channel.sum[i] / float(channel.count);
+    }
+
+    std::fill(channel.sum, channel.sum + 3, 0.f);
+    channel.count = 0;
+    channel.windowStart = now;
+
+    if (channel.hasSent &&
+        std::fabs(value[0] - channel.sent[0]) < UNCHANGED_EPSILON &&
+        std::fabs(value[1] - channel.sent[1]) < UNCHANGED_EPSILON &&
+        std::fabs(value[2] - channel.sent[2]) < UNCHANGED_EPSILON)
+        return;
+
+    InputSink::sendControllerMotionEvent(controller, motionType, value[0],
+                                         value[1], value[2]);
+    std::copy(value, value + 3, channel.sent);
+    channel.hasSent = true;
+    sends++;
+}
+
+int MotionForwarder::effectiveSendRate() {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - statsWindowStart >= std::chrono::seconds(1)) {
+        const auto window =
+            std::chrono::duration<float>(now - statsWindowStart).count();
+        measuredSendRate = int(float(sends - statsWindowSends) / window);
+        statsWindowSends = sends;
+        statsWindowStart = now;
+    }
+    return measuredSendRate;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <borealis.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Resamples controller motion to the report rate the host asked for with
+// setMotionEventState. Gyro readings are integrated over the report
+// interval, accelerometer readings averaged, and a report equal to the last
+// one sent is skipped.
+//
+// Samples are added and sent from the UI thread, report rates are changed
+// from the connection thread.
+class MotionForwarder {
+  public:
+    MotionForwarder();
+
+    // A rate of 0 stops reports for the sensor
+    void setReportRate(uint16_t controller, uint8_t motionType,
+                       uint16_t reportRateHz);
+    // Back to the default rate, before a new connection
+    void resetReportRates();
+
+    // Gyro in deg/s, accelerometer in m/s^2
+    void addSample(uint8_t controller, uint8_t motionType, float x, float y,
+                   float z);
+    // Drops accumulated samples and the last sent readings
+    void reset();
+
+    // Reports per second over the last full second, all controllers
+    int effectiveSendRate();
+
+  private:
+    struct Channel {
+        std::atomic<uint16_t> reportRateHz;
+        bool hasSample = false;
+        float sample[3] = {};
+        // Gyro: time-weighted sum, accelerometer: plain sum
+        float sum[3] = {};
+        int count = 0;
+        std::chrono::steady_clock::time_point sampleTime;
+        std::chrono::steady_clock::time_point windowStart;
+        bool hasSent = false;
+        float sent[3] = {};
+    };
+
+    static constexpr int SENSORS = 2;
+
+    Channel* channel(uint16_t controller, uint8_t motionType);
+    void send(uint8_t controller, uint8_t motionType, Channel& channel,
+              std::chrono::steady_clock::time_point now);
+
+    Channel channels[GAMEPADS_MAX][SENSORS];
+
+    uint64_t sends = 0;
+    uint64_t statsWindowSends = 0;
+    std::chrono::steady_clock::time_point statsWindowStart;
+    int measuredSendRate = 0;
+};
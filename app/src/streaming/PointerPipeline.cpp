@@ -0,0 +1,55 @@
+#include "PointerPipeline.hpp"
+#include "InputSink.hpp"
+#include <cmath>
+#include <limits>
+
+namespace {
+// Whole units to send, the fraction stays in the accumulator
+short take(float& accumulated) {
+    const float whole = std::trunc(accumulated);
+    const float limit = std::numeric_limits<short>::max();
+    const float sent = std::fmax(-limit, std::fmin(limit, whole));
+    accumulated -= sent;
+    return short(sent);
+}
+}
+
+void PointerPipeline::addMove(float x, float y) {
+    moveX += x;
+    moveY += y;
+    addedInputs++;
+}
+
+void PointerPipeline::addScroll(float x, float y) {
+    scrollX += x;
+    scrollY += y;
+    addedInputs++;
+}
+
+void PointerPipeline::flush() {
+    const short deltaX = take(moveX);
+    const short deltaY = take(moveY);
+    if (deltaX != 0 || deltaY != 0) {
+        InputSink::sendMouseMoveEvent(deltaX, deltaY);
+        sentEvents++;
+    }
+
+    const short scrollDeltaY = take(scrollY);
+    if (scrollDeltaY != 0) {
+        InputSink::sendHighResScrollEvent(scrollDeltaY);
+        sentEvents++;
+    }
+
+    const short scrollDeltaX = take(scrollX);
+    if (scrollDeltaX != 0) {
+        InputSink::sendHighResHScrollEvent(scrollDeltaX);
+        sentEvents++;
+    }
+}
+
+void PointerPipeline::reset() {
+    moveX = 0;
+    moveY = 0;
+    scrollX = 0;
+    scrollY = 0;
+}
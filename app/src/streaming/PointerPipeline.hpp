@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// Collects relative pointer motion and scrolling from every source (mouse,
+// touch pan, stick emulation) as floats and sends at most one move and one
+// scroll per axis per flush. The fractional rest carries over to the next
+// flush, so slow motion is not lost and fast motion does not drift.
+//
+// UI thread only.
+class PointerPipeline {
+  public:
+    // One wheel notch in high resolution scroll units
+    static constexpr float NOTCH = 120;
+
+    // Host pixels
+    void addMove(float x, float y);
+    // High resolution units, 120 is one wheel notch, positive is up/right
+    void addScroll(float x, float y);
+
+    // Sends what accumulated since the last flush
+    void flush();
+    // Drops the accumulated motion and remainders
+    void reset();
+
+    uint64_t inputs() const { return addedInputs; }
+    uint64_t sends() const { return sentEvents; }
+
+  private:
+    float moveX = 0;
+    float moveY = 0;
+    float scrollX = 0;
+    float scrollY = 0;
+
+    uint64_t addedInputs = 0;
+    uint64_t sentEvents = 0;
+};
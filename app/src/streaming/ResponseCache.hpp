@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct ResponseCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t coalesced = 0;
+};
+
+// Thread-safe cache of host responses keyed by (host, endpoint, parameters).
+// Only successful results are stored. Identical requests issued while one is
+// already running wait for it instead of hitting the host again.
+// Result is a GSResult-like type exposing isSuccess().
+template <typename Result> class ResponseCache {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Fetch = std::function<Result()>;
+
+    enum class Freshness { MISSING, FRESH, STALE };
+
+    static std::string key(const std::string& host, const std::string& endpoint,
+                           const std::string& params = "") {
+        return host + "|" + endpoint + "|" + params;
+    }
+
+    // Copies the cached result into `out`. A STALE result should still be
+    // served, but the caller is expected to refresh it. Results older than
+    // maxStale are treated as missing.
+    Freshness lookup(const std::string& key, Clock::duration maxAge,
+                     Clock::duration maxStale, Result& out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end() || !it->second.hasValue) {
+            return Freshness::MISSING;
+        }
+
+        const auto age = Clock::now() - it->second.storedAt;
+        if (age >= maxStale) {
+            return Freshness::MISSING;
+        }
+
+        m_hits++;
+        out = it->second.value;
+        return age < maxAge ? Freshness::FRESH : Freshness::STALE;
+    }
+
+    // Runs `fetch` on the calling thread, or waits for the identical request
+    // already in flight and returns its result. A failed fetch drops the
+    // cached result so the host is not reported with outdated data.
+    Result fetch(const std::string& key, const Fetch& fetch) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto& entry = m_entries[key];
+        if (entry.inFlight) {
+            m_coalesced++;
+            auto flight = entry.inFlight;
+            m_flight_finished.wait(lock, [&flight] { return flight->done; });
+            return flight->result;
+        }
+
+        m_misses++;
+        auto flight = std::make_shared<Flight>();
+        flight->generation = entry.generation;
+        entry.inFlight = flight;
+        lock.unlock();
+
+        Result result = fetch();
+
+        lock.lock();
+        auto& finished = m_entries[key];
+        if (!result.isSuccess()) {
+            finished.hasValue = false;
+        } else if (finished.generation == flight->generation) {
+            finished.value = result;
+            finished.hasValue = true;
+            finished.storedAt = Clock::now();
+        }
+        finished.inFlight.reset();
+        flight->result = result;
+        flight->done = true;
+        lock.unlock();
+
+        m_flight_finished.notify_all();
+        return result;
+    }
+
+    // True when the caller should start a background refresh for `key`,
+    // false if one is already running.
+    bool should_refresh(const std::string& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end() && it->second.inFlight) {
+            m_coalesced++;
+            return false;
+        }
+        return true;
+    }
+
+    void store(const std::string& key, const Result& result) {
+        if (!result.isSuccess()) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_entries[key];
+        entry.value = result;
+        entry.hasValue = true;
+        entry.storedAt = Clock::now();
+    }
+
+    // Drops every entry whose key starts with `prefix`, results of requests
+    // still in flight for them are not stored.
+    void invalidate(const std::string& prefix) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& [key, entry] : m_entries) {
+            if (key.compare(0, prefix.size(), prefix) == 0) {
+                entry.hasValue = false;
+                entry.generation++;
+            }
+        }
+    }
+
+    // Same as invalidate(), for every entry whose key `matches`
+    template <typename Predicate> void invalidate_if(Predicate matches) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& [key, entry] : m_entries) {
+            if (matches(key)) {
+                entry.hasValue = false;
+                entry.generation++;
+            }
+        }
+    }
+
+    ResponseCacheStats stats() const {
+        ResponseCacheStats stats;
+        stats.hits = m_hits;
+        stats.misses = m_misses;
+        stats.coalesced = m_coalesced;
+        return stats;
+    }
+
+  private:
+    struct Flight {
+        bool done = false;
+        uint64_t generation = 0;
+        Result result;
+    };
+
+    struct Entry {
+        bool hasValue = false;
+        Result value;
+        Clock::time_point storedAt;
+        uint64_t generation = 0;
+        std::shared_ptr<Flight> inFlight;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_flight_finished;
+    std::map<std::string, Entry> m_entries;
+
+    std::atomic<uint64_t> m_hits = 0;
+    std::atomic<uint64_t> m_misses = 0;
+    std::atomic<uint64_t> m_coalesced = 0;
+};
@@ -5,9 +5,12 @@
 #include <algorithm>
 #include <array>
 #include <cerrno>
+#include <chrono>
 #include <cctype>
 #include <cstring>
+#include <map>
 #include <string>
+#include <thread>
 #include <vector>
 
 #if defined(__linux) || defined(__APPLE__) || defined(__SWITCH__) || defined(__vita__)
@@ -46,6 +49,9 @@ constexpr std::array<unsigned short, 5> DYNAMIC_WOL_PORTS = {
     48002,
     48010,
 };
+// Magic packets are UDP, repeat the whole batch in case some get dropped
+constexpr int WAKE_PACKET_REPEATS = 3;
+constexpr auto WAKE_PACKET_REPEAT_INTERVAL = std::chrono::milliseconds(100);
 
 std::string normalize_mac_address(const std::string& mac) {
     std::string normalized;
@@ -218,6 +224,8 @@ void populate_port(sockaddr_storage& address, unsigned short port) {
 #if defined(UNIX_SOCKS)
 using SocketHandle = int;
 
+constexpr SocketHandle INVALID_SOCKET_HANDLE = -1;
+
 bool is_invalid_socket(SocketHandle socket) { return socket == -1; }
 
 void close_socket(SocketHandle socket) { close(socket); }
@@ -226,6 +234,8 @@ std::string last_socket_error_string() { return std::string(strerror(errno)); }
 #elif defined(WIN32_SOCKS)
 using SocketHandle = SOCKET;
 
+constexpr SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+
 bool is_invalid_socket(SocketHandle socket) { return socket == INVALID_SOCKET; }
 
 void close_socket(SocketHandle socket) { closesocket(socket); }
@@ -235,13 +245,16 @@ std::string last_socket_error_string() {
 }
 #endif
 
-GSResult<bool> send_magic_packets(const Host& host, const Data& payload) {
-    if (payload.is_empty()) {
-        return GSResult<bool>::failure("Magic packet payload is empty");
-    }
+struct WakeTarget {
+    sockaddr_storage address;
+    size_t length;
+};
 
-    std::string lastError = "Failed to resolve any wake address";
-    size_t packetsSent = 0;
+// Resolves every address/port candidate up front so the packets can go out
+// back to back
+std::vector<WakeTarget> resolve_wake_targets(const Host& host,
+                                             std::string& lastError) {
+    std::vector<WakeTarget> targets;
 
     for (const auto& candidate : wake_address_candidates(host)) {
         std::string rawAddress;
@@ -273,71 +286,121 @@ GSResult<bool> send_magic_packets(const Host& host, const Data& payload) {
 
         for (addrinfo* current = result; current != nullptr;
              current = current->ai_next) {
-            SocketHandle socketHandle =
-                socket(current->ai_family, SOCK_DGRAM, IPPROTO_UDP);
-            if (is_invalid_socket(socketHandle)) {
-                lastError =
-                    "Failed to create wake socket: " + last_socket_error_string();
-                brls::Logger::warning("WakeOnLanManager: {}", lastError);
+            if (current->ai_family != AF_INET &&
+                current->ai_family != AF_INET6) {
                 continue;
             }
 
-            if (current->ai_family == AF_INET) {
-                int broadcast = 1;
-                if (setsockopt(socketHandle, SOL_SOCKET, SO_BROADCAST,
+            for (const auto port : wake_port_candidates(basePort)) {
+                WakeTarget target{};
+                memcpy(&target.address, current->ai_addr, current->ai_addrlen);
+                target.length = current->ai_addrlen;
+                populate_port(target.address, port);
+                targets.push_back(target);
+            }
+        }
+
+        freeaddrinfo(result);
+    }
+
+    return targets;
+}
+
+SocketHandle open_wake_socket(int family, std::string& lastError) {
+    SocketHandle socketHandle = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    if (is_invalid_socket(socketHandle)) {
+        lastError =
+            "Failed to create wake socket: " + last_socket_error_string();
+        brls::Logger::warning("WakeOnLanManager: {}", lastError);
+        return socketHandle;
+    }
+
+    if (family == AF_INET) {
+        int broadcast = 1;
+        if (setsockopt(socketHandle, SOL_SOCKET, SO_BROADCAST,
 #if defined(WIN32_SOCKS)
-                               reinterpret_cast<const char*>(&broadcast),
+                       reinterpret_cast<const char*>(&broadcast),
 #else
-                               &broadcast,
+                       &broadcast,
 #endif
-                               sizeof(broadcast)) == -1) {
-                    lastError = "Failed to enable broadcast: " +
-                                last_socket_error_string();
-                    brls::Logger::warning("WakeOnLanManager: {}", lastError);
-                    close_socket(socketHandle);
-                    continue;
-                }
-            }
+                       sizeof(broadcast)) == -1) {
+            lastError =
+                "Failed to enable broadcast: " + last_socket_error_string();
+            brls::Logger::warning("WakeOnLanManager: {}", lastError);
 
-            sockaddr_storage target{};
-            memcpy(&target, current->ai_addr, current->ai_addrlen);
+            // Broadcast targets would fail on it, the batch skips the family
+            close_socket(socketHandle);
+            return INVALID_SOCKET_HANDLE;
+        }
+    }
 
-            for (const auto port : wake_port_candidates(basePort)) {
-                populate_port(target, port);
+    return socketHandle;
+}
+
+GSResult<bool> send_magic_packets(const Host& host, const Data& payload) {
+    if (payload.is_empty()) {
+        return GSResult<bool>::failure("Magic packet payload is empty");
+    }
+
+    std::string lastError = "Failed to resolve any wake address";
+    const auto targets = resolve_wake_targets(host, lastError);
+
+    // One socket per address family for the whole batch
+    std::map<int, SocketHandle> sockets;
+    for (const auto& target : targets) {
+        const int family = target.address.ss_family;
+        if (sockets.count(family) == 0) {
+            sockets[family] = open_wake_socket(family, lastError);
+        }
+    }
 
-                const int sendResult = sendto(
-                    socketHandle,
+    size_t packetsSent = 0;
+    for (int round = 0; round < WAKE_PACKET_REPEATS; round++) {
+        if (round > 0) {
+            std::this_thread::sleep_for(WAKE_PACKET_REPEAT_INTERVAL);
+        }
+
+        for (const auto& target : targets) {
+            SocketHandle socketHandle = sockets[target.address.ss_family];
+            if (is_invalid_socket(socketHandle)) {
+                continue;
+            }
+
+            const int sendResult = sendto(
+                socketHandle,
 #if defined(WIN32_SOCKS)
-                    reinterpret_cast<const char*>(payload.bytes()),
+                reinterpret_cast<const char*>(payload.bytes()),
 #else
-                    payload.bytes(),
+                payload.bytes(),
 #endif
-                    static_cast<int>(payload.size()), 0,
-                    reinterpret_cast<sockaddr*>(&target),
+                static_cast<int>(payload.size()), 0,
+                reinterpret_cast<const sockaddr*>(&target.address),
 #if defined(WIN32_SOCKS)
-                    static_cast<int>(current->ai_addrlen));
+                static_cast<int>(target.length));
 #else
-                    static_cast<socklen_t>(current->ai_addrlen));
+                static_cast<socklen_t>(target.length));
 #endif
 
-                if (sendResult >= 0) {
-                    packetsSent++;
-                    brls::Logger::info(
-                        "WakeOnLanManager: Sent magic packet to '{}' on port {}",
-                        rawAddress, port);
-                } else {
-                    lastError = "Failed to send magic packet: " +
-                                last_socket_error_string();
-                    brls::Logger::warning("WakeOnLanManager: {}", lastError);
-                }
+            if (sendResult >= 0) {
+                packetsSent++;
+            } else {
+                lastError = "Failed to send magic packet: " +
+                            last_socket_error_string();
             }
+        }
+    }
 
+    for (const auto& [family, socketHandle] : sockets) {
+        if (!is_invalid_socket(socketHandle)) {
             close_socket(socketHandle);
         }
-
-        freeaddrinfo(result);
     }
 
+    brls::Logger::info(
+        "WakeOnLanManager: Sent {} magic packet(s) to {} target(s) in {} "
+        "round(s)",
+        packetsSent, targets.size(), WAKE_PACKET_REPEATS);
+
     if (packetsSent == 0) {
         return GSResult<bool>::failure(lastError);
     }
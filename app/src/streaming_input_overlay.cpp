@@ -6,6 +6,7 @@
 //
 
 #include "streaming_input_overlay.hpp"
+#include "InputManager.hpp"
 #include <Limelight.h>
 
 using namespace brls;
@@ -44,6 +45,12 @@ StreamingInputOverlay::StreamingInputOverlay(StreamingView* streamView)
                           });
 }
 
+StreamingInputOverlay::~StreamingInputOverlay() {
+    // Pooled, it must not go down with the overlay
+    if (keyboard)
+        KeyboardView::release(keyboard);
+}
+
 void StreamingInputOverlay::onFocusGained() {
     View::onFocusGained();
     Application::giveFocus(this);
@@ -55,17 +62,8 @@ void StreamingInputOverlay::draw(NVGcontext* vg, float x, float y, float width,
 
     // Keyboard
     if (keyboard) {
-        static KeyboardState oldKeyboardState;
-        KeyboardState keyboardState = keyboard->getKeyboardState();
-
-        for (int i = 0; i < _VK_KEY_MAX; i++) {
-            if (keyboardState.keys[i] != oldKeyboardState.keys[i]) {
-                oldKeyboardState.keys[i] = keyboardState.keys[i];
-                LiSendKeyboardEvent(
-                    keyboard->getKeyCode((KeyboardKeys)i),
-                    keyboardState.keys[i] ? KEY_ACTION_DOWN : KEY_ACTION_UP, 0);
-            }
-        }
+        MoonlightInputManager::instance().sendKeyboardChanges(
+            keyboard, keyboard->getKeyboardState(), sentKeyboardState);
     }
 
     if (!isKeyboardOpen) {
@@ -97,7 +95,8 @@ void StreamingInputOverlay::draw(NVGcontext* vg, float x, float y, float width,
                 Settings::instance().get_mouse_speed_multiplier() / 100.f *
                     1.5f +
                 0.5f;
-            LiSendMouseMoveEvent(x * multiplier, y * multiplier);
+            MoonlightInputManager::instance().addPointerMove(x * multiplier,
+                                                             y * multiplier);
         }
 
         static bool old_l_pressed;
@@ -145,9 +144,11 @@ void StreamingInputOverlay::draw(NVGcontext* vg, float x, float y, float width,
                             .count();
         if (scroll_y != 0 && duration > 550 - abs(scroll_y) * 500) {
             timeStamp = timeNow;
-            brls::Logger::info("Scroll sended: {}", scroll_y);
-            LiSendScrollEvent(scroll_y > 0 ? 1 : -1);
+            MoonlightInputManager::instance().addPointerScroll(
+                0, scroll_y > 0 ? PointerPipeline::NOTCH : -PointerPipeline::NOTCH);
         }
+
+        MoonlightInputManager::instance().flushPointer();
     }
 }
 
@@ -175,11 +176,12 @@ void StreamingInputOverlay::refreshKeyboard() {
 
     // Show/Hide keyboard
     if (!isKeyboardOpen) {
-        inner->removeView(keyboard);
+        if (keyboard)
+            KeyboardView::release(keyboard);
         keyboard = nullptr;
         Application::giveFocus(this);
-    } else {
-        keyboard = new KeyboardView(true);
+    } else if (!keyboard) {
+        keyboard = KeyboardView::acquire(true);
         inner->addView(keyboard);
     }
 
@@ -224,9 +226,9 @@ void StreamingInputOverlay::populateHintWithDefaultItems() {
 }
 
 void sendClick(char key) {
-    LiSendKeyboardEvent(key, KEY_ACTION_DOWN, 0);
+    MoonlightInputManager::instance().sendKeyboardEvent(key, true);
     brls::delay(100, [key]() {
-    LiSendKeyboardEvent(key, KEY_ACTION_UP, 0);
+    MoonlightInputManager::instance().sendKeyboardEvent(key, false);
     });
 }
 
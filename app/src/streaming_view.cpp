@@ -11,6 +11,7 @@
 
 #include "streaming_view.hpp"
 #include "AVFrameHolder.hpp"
+#include "HostMonitor.hpp"
 #include "InputManager.hpp"
 #include "click_gesture_recognizer.hpp"
 #include "helper.hpp"
@@ -69,6 +70,8 @@ void overrideButtonsIfNeeded(bool value) {
 
 StreamingView::StreamingView(const Host& host, const AppInfo& app) : host(host), app(app) {
     Application::getPlatform()->disableScreenDimming(true);
+    // No probes or serverinfo polling competing with the stream
+    HostMonitor::instance().stop();
 
     setFocusable(true);
     setHideHighlight(true);
@@ -191,16 +194,15 @@ StreamingView::StreamingView(const Host& host, const AppInfo& app) : host(host),
                 if (Settings::instance().touchscreen_mouse_mode()) return;
 
                 if (state.state == brls::GestureState::START)
-                    this->touchScrollCounter = 0;
+                    this->touchScrollOffset = 0;
 
-                int threshold = int(state.delta.y / 25);
-                if (threshold != this->touchScrollCounter) {
-                    Logger::debug("Scroll on: {}",
-                                  threshold - this->touchScrollCounter);
+                // 25 points of finger travel per wheel notch
+                float offset = state.delta.y / 25 * PointerPipeline::NOTCH;
+                if (offset != this->touchScrollOffset) {
                     int invert = Settings::instance().swap_mouse_scroll() ? -1 : 1;
-                    char scrollCount = threshold - this->touchScrollCounter;
-                    LiSendScrollEvent(scrollCount * invert);
-                    this->touchScrollCounter = threshold;
+                    MoonlightInputManager::instance().addPointerScroll(
+                        0, (offset - this->touchScrollOffset) * invert);
+                    this->touchScrollOffset = offset;
                 }
             });
     addGestureRecognizer(scrollTouchRecognizer);
@@ -365,6 +367,31 @@ void StreamingView::draw(NVGcontext* vg, float x, float y, float width,
                 /*stats->video_render_stats.rendered_frames*/);
         }
 
+        auto inputStats = MoonlightInputManager::instance().latencyStats();
+        statistics += fmt::format("Controller polls: {} Hz\n"
+                                  "Input poll to send average | max: {:.{}f} | {:.{}f} ms\n"
+                                  "Controller events sent | suppressed: {} | {}\n"
+                                  "Motion reports: {} Hz\n"
+                                  "Pointer inputs | events sent: {} | {}\n"
+                                  "Key events sent | releases avoided: {} | {}\n"
+                                  "Touch events: {}/s | moves skipped {}\n"
+                                  "Rumble updates | applied | coalesced: {} | {} | {}\n",
+                                  inputStats.samplingRate,
+                                  inputStats.averagePollToSendMs, 2,
+                                  inputStats.maxPollToSendMs, 2,
+                                  inputStats.eventsSent,
+                                  inputStats.eventsSuppressed,
+                                  inputStats.motionSendRate,
+                                  inputStats.pointerInputs,
+                                  inputStats.pointerSends,
+                                  inputStats.keyEventsSent,
+                                  inputStats.keyReleasesAvoided,
+                                  inputStats.touchEventRate,
+                                  inputStats.touchMovesSkipped,
+                                  inputStats.rumbleUpdates,
+                                  inputStats.rumbleApplied,
+                                  inputStats.rumbleCoalesced);
+
         statistics += fmt::format("Frames queue underflows | skipped: {} | {}\n"
                                   "Queue empty | startup holds: {} | {}\n"
                                   "Queue overflow | paced skips: {} | {}\n"
@@ -408,7 +435,7 @@ void StreamingView::addKeyboard() {
     if (keyboard)
         return;
 
-    keyboard = new KeyboardView(false);
+    keyboard = KeyboardView::acquire(false);
     keyboardHolder->addView(keyboard);
 }
 
@@ -416,7 +443,7 @@ void StreamingView::removeKeyboard() {
     if (!keyboard)
         return;
 
-    keyboard->removeFromSuperView();
+    KeyboardView::release(keyboard);
     keyboard = nullptr;
     Application::giveFocus(this);
 }
@@ -447,23 +474,15 @@ void StreamingView::handleInput() {
     }
 
     if (keyboard) {
-        static KeyboardState oldKeyboardState;
-        KeyboardState keyboardState = keyboard->getKeyboardState();
-
-        for (int i = 0; i < _VK_KEY_MAX; i++) {
-            if (keyboardState.keys[i] != oldKeyboardState.keys[i]) {
-                oldKeyboardState.keys[i] = keyboardState.keys[i];
-                LiSendKeyboardEvent(
-                    keyboard->getKeyCode((KeyboardKeys)i),
-                    keyboardState.keys[i] ? KEY_ACTION_DOWN : KEY_ACTION_UP, 0);
-            }
-        }
+        MoonlightInputManager::instance().sendKeyboardChanges(
+            keyboard, keyboard->getKeyboardState(), sentKeyboardState);
 
         // Drop input if keyboard overlay presented
 //        MoonlightInputManager::instance().dropInput();
     }
 //    else {
     MoonlightInputManager::instance().handleInput(keyboard != nullptr);
+    MoonlightInputManager::instance().flushPointer();
 //    }
 
     if (!Application::currentTouchState.empty()) {
@@ -485,7 +504,7 @@ void StreamingView::handleOverlayCombo() {
     if (!this->focused)
         return;
 
-    KeyComboOptions options = Settings::instance().overlay_options();
+    const auto& mapping = MoonlightInputManager::instance().compiledMapping();
 
     static ControllerState controller;
     Application::getPlatform()->getInputManager()->updateUnifiedControllerState(
@@ -498,10 +517,8 @@ void StreamingView::handleOverlayCombo() {
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::high_resolution_clock::now() - clock_counter);
 
-    bool buttonsPressed = true;
-    for (auto button : options.buttons) {
-        buttonsPressed &= controller.buttons[button];
-    }
+    bool buttonsPressed = ControllerMapping::comboPressed(
+        ControllerMapping::packButtons(controller), mapping.overlayCombo);
 
     if (!buttonState && buttonsPressed) {
         buttonState = true;
@@ -509,7 +526,7 @@ void StreamingView::handleOverlayCombo() {
     } else if (buttonState && !buttonsPressed) {
         buttonState = false;
         used = false;
-    } else if (buttonState && duration.count() >= options.holdTime && !used) {
+    } else if (buttonState && duration.count() >= mapping.overlayHoldTime && !used) {
         used = true;
 
         auto overlay = new IngameOverlay(this);
@@ -539,8 +556,8 @@ void StreamingView::handleMouseInputCombo() {
     if (!this->focused)
         return;
 
-    KeyComboOptions options = Settings::instance().mouse_input_options();
-    if (options.buttons.empty())
+    const auto& mapping = MoonlightInputManager::instance().compiledMapping();
+    if (mapping.mouseInputCombo == 0)
         return;
 
     static ControllerState controller;
@@ -554,10 +571,8 @@ void StreamingView::handleMouseInputCombo() {
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::high_resolution_clock::now() - clock_counter);
 
-    bool buttonsPressed = true;
-    for (auto button : options.buttons) {
-        buttonsPressed &= controller.buttons[button];
-    }
+    bool buttonsPressed = ControllerMapping::comboPressed(
+        ControllerMapping::packButtons(controller), mapping.mouseInputCombo);
 
     if (!buttonState && buttonsPressed) {
         buttonState = true;
@@ -565,7 +580,7 @@ void StreamingView::handleMouseInputCombo() {
     } else if (buttonState && !buttonsPressed) {
         buttonState = false;
         used = false;
-    } else if (buttonState && duration.count() >= options.holdTime && !used) {
+    } else if (buttonState && duration.count() >= mapping.mouseInputHoldTime && !used) {
         used = true;
 
         auto overlay = new StreamingInputOverlay(this);
@@ -594,6 +609,12 @@ StreamingView::~StreamingView() {
         ->getInputManager()
         ->getKeyboardKeyStateChanged()
         ->unsubscribe(keysSubscription);
+    MoonlightInputManager::instance().stopSampling();
     session->stop(false);
     delete session;
+    HostMonitor::instance().start();
+
+    // Pooled, it must not go down with the view
+    if (keyboard)
+        KeyboardView::release(keyboard);
 }
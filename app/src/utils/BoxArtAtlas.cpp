@@ -0,0 +1,366 @@
+#include "BoxArtAtlas.hpp"
+#include "nanovg.h"
+#include <borealis.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Edge pixels are repeated into the padding so filtering at tile borders
+// does not pick up the neighbours
+constexpr int TILE_PADDING = 1;
+// A shelf is only reused by tiles at least this share of its height
+constexpr float SHELF_FIT = 0.8f;
+// Below this share of the page area in use, removals trigger a repack
+constexpr float COMPACT_OCCUPANCY = 0.5f;
+constexpr auto RETIRED_IMAGE_DELAY = std::chrono::milliseconds(250);
+}
+
+BoxArtAtlas::BoxArtAtlas(int page_width, int page_height)
+    : m_page_width(page_width), m_page_height(page_height) {}
+
+void BoxArtAtlas::set_max_pages(size_t max_pages) {
+    m_max_pages = std::max<size_t>(max_pages, 1);
+}
+
+bool BoxArtAtlas::allocate(Page& page, int width, int height, Rect& slot) {
+    Shelf* best = nullptr;
+    int bestSpan = -1;
+
+    // The shortest shelf that fits wastes the least height
+    for (auto& shelf : page.shelves) {
+        if (shelf.height < height ||
+            float(height) < float(shelf.height) * SHELF_FIT) {
+            continue;
+        }
+        if (best && shelf.height >= best->height) {
+            continue;
+        }
+
+        for (int i = 0; i < (int)shelf.free.size(); i++) {
+            if (shelf.free[i].second >= width) {
+                best = &shelf;
+                bestSpan = i;
+                break;
+            }
+        }
+
+        if (best != &shelf && shelf.used + width <= m_page_width) {
+            best = &shelf;
+            bestSpan = -1;
+        }
+    }
+
+    if (!best) {
+        if (page.shelves_bottom + height > m_page_height) {
+            return false;
+        }
+
+        Shelf shelf;
+        shelf.y = page.shelves_bottom;
+        shelf.height = height;
+        page.shelves_bottom += height;
+        page.shelves.push_back(shelf);
+        best = &page.shelves.back();
+    }
+
+    slot.y = best->y;
+    slot.width = width;
+    slot.height = height;
+
+    if (bestSpan >= 0) {
+        auto& span = best->free[bestSpan];
+        slot.x = span.first;
+        span.first += width;
+        span.second -= width;
+        if (span.second == 0) {
+            best->free.erase(best->free.begin() + bestSpan);
+        }
+    } else {
+        slot.x = best->used;
+        best->used += width;
+    }
+
+    page.tiles++;
+    return true;
+}
+
+void BoxArtAtlas::release(Page& page, const Rect& slot) {
+    page.tiles--;
+
+    auto shelf = std::find_if(
+        page.shelves.begin(), page.shelves.end(),
+        [&slot](const Shelf& shelf) { return shelf.y == slot.y; });
+    if (shelf == page.shelves.end()) {
+        return;
+    }
+
+    shelf->free.emplace_back(slot.x, slot.width);
+    std::sort(shelf->free.begin(), shelf->free.end());
+
+    std::vector<std::pair<int, int>> merged;
+    for (const auto& span : shelf->free) {
+        if (!merged.empty() &&
+            merged.back().first + merged.back().second == span.first) {
+            merged.back().second += span.second;
+        } else {
+            merged.push_back(span);
+        }
+    }
+
+    // A span reaching the end of the shelf just moves it back
+    if (!merged.empty() &&
+        merged.back().first + merged.back().second == shelf->used) {
+        shelf->used = merged.back().first;
+        merged.pop_back();
+    }
+    shelf->free = std::move(merged);
+
+    // Empty shelves at the bottom give their height back
+    while (!page.shelves.empty() && page.shelves.back().used == 0) {
+        page.shelves_bottom = page.shelves.back().y;
+        page.shelves.pop_back();
+    }
+}
+
+void BoxArtAtlas::copy_in(Page& page, const Rect& slot, int width, int height,
+                          const uint8_t* rgba) {
+    const size_t rowBytes = size_t(width) * 4;
+    const size_t pageRowBytes = size_t(m_page_width) * 4;
+
+    auto pixel = [&page, pageRowBytes](int x, int y) {
+        return page.pixels.data() + size_t(y) * pageRowBytes + size_t(x) * 4;
+    };
+
+    for (int y = 0; y < slot.height; y++) {
+        const int sourceY =
+            std::clamp(y - TILE_PADDING, 0, height - 1);
+        const uint8_t* source = rgba + size_t(sourceY) * rowBytes;
+        uint8_t* row = pixel(slot.x, slot.y + y);
+
+        std::memcpy(row + TILE_PADDING * 4, source, rowBytes);
+        for (int x = 0; x < TILE_PADDING; x++) {
+            std::memcpy(row + x * 4, source, 4);
+            std::memcpy(row + (TILE_PADDING + width + x) * 4,
+                        source + rowBytes - 4, 4);
+        }
+    }
+
+    page.dirty.push_back(slot);
+}
+
+void BoxArtAtlas::copy_out(const Tile& tile, std::vector<uint8_t>& rgba) const {
+    const size_t rowBytes = size_t(tile.width) * 4;
+    const size_t pageRowBytes = size_t(m_page_width) * 4;
+
+    rgba.resize(rowBytes * size_t(tile.height));
+    for (int y = 0; y < tile.height; y++) {
+        const uint8_t* row =
+            tile.page->pixels.data() +
+            size_t(tile.slot.y + TILE_PADDING + y) * pageRowBytes +
+            size_t(tile.slot.x + TILE_PADDING) * 4;
+        std::memcpy(rgba.data() + size_t(y) * rowBytes, row, rowBytes);
+    }
+}
+
+bool BoxArtAtlas::place(const std::string& key, int width, int height,
+                        const uint8_t* rgba, bool may_add_page) {
+    const int slotWidth = width + 2 * TILE_PADDING;
+    const int slotHeight = height + 2 * TILE_PADDING;
+
+    Rect slot;
+    Page* target = nullptr;
+    for (auto& page : m_pages) {
+        if (allocate(*page, slotWidth, slotHeight, slot)) {
+            target = page.get();
+            break;
+        }
+    }
+
+    if (!target && may_add_page && m_pages.size() < m_max_pages) {
+        auto page = std::make_unique<Page>();
+        page->pixels.assign(size_t(m_page_width) * size_t(m_page_height) * 4,
+                            0);
+        if (allocate(*page, slotWidth, slotHeight, slot)) {
+            target = page.get();
+            m_pages.push_back(std::move(page));
+        }
+    }
+
+    if (!target) {
+        return false;
+    }
+
+    copy_in(*target, slot, width, height, rgba);
+
+    Tile tile;
+    tile.page = target;
+    tile.slot = slot;
+    tile.width = width;
+    tile.height = height;
+    m_tiles[key] = tile;
+    return true;
+}
+
+bool BoxArtAtlas::insert(const std::string& key, int width, int height,
+                         const uint8_t* rgba) {
+    remove(key);
+
+    if (width <= 0 || height <= 0 ||
+        width + 2 * TILE_PADDING > m_page_width ||
+        height + 2 * TILE_PADDING > m_page_height) {
+        return false;
+    }
+
+    return place(key, width, height, rgba, true);
+}
+
+void BoxArtAtlas::remove(const std::string& key) {
+    auto it = m_tiles.find(key);
+    if (it == m_tiles.end()) {
+        return;
+    }
+
+    Page* page = it->second.page;
+    release(*page, it->second.slot);
+    m_tiles.erase(it);
+    m_removed_since_compact = true;
+
+    if (page->tiles == 0 && m_pages.size() > 1) {
+        erase_page(page);
+    }
+}
+
+bool BoxArtAtlas::contains(const std::string& key) const {
+    return m_tiles.count(key) > 0;
+}
+
+bool BoxArtAtlas::region(const std::string& key, AtlasRegion& region) const {
+    auto it = m_tiles.find(key);
+    if (it == m_tiles.end() || it->second.page->image == 0) {
+        return false;
+    }
+
+    const auto& tile = it->second;
+    region.image = tile.page->image;
+    region.x = tile.slot.x + TILE_PADDING;
+    region.y = tile.slot.y + TILE_PADDING;
+    region.width = tile.width;
+    region.height = tile.height;
+    region.page_width = m_page_width;
+    region.page_height = m_page_height;
+    return true;
+}
+
+void BoxArtAtlas::retire(Page& page) {
+    if (page.image != 0) {
+        m_retired_images.emplace_back(page.image,
+                                      std::chrono::steady_clock::now());
+        page.image = 0;
+    }
+}
+
+void BoxArtAtlas::erase_page(Page* page) {
+    retire(*page);
+    m_pages.erase(std::find_if(m_pages.begin(), m_pages.end(),
+                               [page](const std::unique_ptr<Page>& item) {
+                                   return item.get() == page;
+                               }));
+}
+
+void BoxArtAtlas::compact() {
+    if (!m_removed_since_compact || m_pages.size() < 2) {
+        return;
+    }
+
+    size_t area = 0;
+    std::map<Page*, size_t> pageAreas;
+    for (const auto& [key, tile] : m_tiles) {
+        const size_t tileArea =
+            size_t(tile.slot.width) * size_t(tile.slot.height);
+        area += tileArea;
+        pageAreas[tile.page] += tileArea;
+    }
+
+    const size_t pagesArea =
+        m_pages.size() * size_t(m_page_width) * size_t(m_page_height);
+    if (float(area) >= float(pagesArea) * COMPACT_OCCUPANCY) {
+        m_removed_since_compact = false;
+        return;
+    }
+
+    Page* emptiest = m_pages.front().get();
+    for (const auto& page : m_pages) {
+        if (pageAreas[page.get()] < pageAreas[emptiest]) {
+            emptiest = page.get();
+        }
+    }
+
+    // Taken out of the page first so place() only finds room elsewhere,
+    // tallest first like a fresh pack
+    struct Moved {
+        std::string key;
+        int width;
+        int height;
+        std::vector<uint8_t> rgba;
+    };
+    std::vector<Moved> moved;
+    for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+        if (it->second.page == emptiest) {
+            Moved item{it->first, it->second.width, it->second.height, {}};
+            copy_out(it->second, item.rgba);
+            moved.push_back(std::move(item));
+            it = m_tiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    erase_page(emptiest);
+
+    std::sort(moved.begin(), moved.end(), [](const Moved& l, const Moved& r) {
+        return l.height != r.height ? l.height > r.height : l.width > r.width;
+    });
+
+    size_t dropped = 0;
+    for (const auto& item : moved) {
+        if (!place(item.key, item.width, item.height, item.rgba.data(),
+                   false)) {
+            dropped++;
+        }
+    }
+
+    brls::Logger::debug("BoxArtAtlas: Moved {} tiles off a page, {} "
+                        "dropped, {} pages left",
+                        moved.size() - dropped, dropped, m_pages.size());
+}
+
+void BoxArtAtlas::upload(NVGcontext* ctx) {
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = m_retired_images.begin(); it != m_retired_images.end();) {
+        if (now - it->second >= RETIRED_IMAGE_DELAY) {
+            nvgDeleteImage(ctx, it->first);
+            it = m_retired_images.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    NVGparams* params = nvgInternalParams(ctx);
+    for (auto& page : m_pages) {
+        if (page->image == 0) {
+            page->image =
+                nvgCreateImageRGBA(ctx, m_page_width, m_page_height,
+                                   NVG_IMAGE_PREMULTIPLIED,
+                                   page->pixels.data());
+            page->dirty.clear();
+            continue;
+        }
+
+        // Only the changed rectangles, nvgUpdateImage would send the page
+        for (const auto& rect : page->dirty) {
+            params->renderUpdateTexture(params->userPtr, page->image, rect.x,
+                                        rect.y, rect.width, rect.height,
+                                        page->pixels.data());
+        }
+        page->dirty.clear();
+    }
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#pragma once
+
+struct NVGcontext;
+
+// Where a tile lives: its image is the whole page, the rectangle is in page
+// pixels
+struct AtlasRegion {
+    int image = 0;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    int page_width = 0;
+    int page_height = 0;
+};
+
+// Packs box art into a few large pages so a grid of cells draws from a
+// handful of textures instead of one per app. Pages are filled by a shelf
+// packer and mirrored in memory, NanoVG cannot read textures back and only
+// the changed rectangles of the mirror are uploaded.
+//
+// Not thread-safe, BoxArtManager only calls it under its lock.
+class BoxArtAtlas {
+  public:
+    BoxArtAtlas(int page_width, int page_height);
+
+    void set_max_pages(size_t max_pages);
+    size_t max_pages() const { return m_max_pages; }
+    size_t page_count() const { return m_pages.size(); }
+
+    // False when no page has room, the caller is expected to remove
+    // something and retry
+    bool insert(const std::string& key, int width, int height,
+                const uint8_t* rgba);
+    void remove(const std::string& key);
+    bool contains(const std::string& key) const;
+    // False until the page of the tile was uploaded
+    bool region(const std::string& key, AtlasRegion& region) const;
+
+    // When removals left the pages mostly empty, moves the tiles of the
+    // emptiest page into the others and retires it. One page per call so
+    // the re-uploads are spread over frames, tiles that no longer fit are
+    // dropped and come back through the owner's regular uploads.
+    void compact();
+
+    // UI thread only: creates new pages, uploads new tiles and deletes
+    // retired pages a little later
+    void upload(NVGcontext* ctx);
+
+  private:
+    struct Rect {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Shelf {
+        int y = 0;
+        int height = 0;
+        int used = 0;
+        // Released spans (x, width) left of `used`
+        std::vector<std::pair<int, int>> free;
+    };
+
+    struct Page {
+        int image = 0;
+        std::vector<uint8_t> pixels;
+        std::vector<Shelf> shelves;
+        int shelves_bottom = 0;
+        std::vector<Rect> dirty;
+        size_t tiles = 0;
+    };
+
+    struct Tile {
+        Page* page = nullptr;
+        // Includes the padding around the art
+        Rect slot;
+        int width = 0;
+        int height = 0;
+    };
+
+    bool allocate(Page& page, int width, int height, Rect& slot);
+    void release(Page& page, const Rect& slot);
+    bool place(const std::string& key, int width, int height,
+               const uint8_t* rgba, bool may_add_page);
+    void copy_in(Page& page, const Rect& slot, int width, int height,
+                 const uint8_t* rgba);
+    void copy_out(const Tile& tile, std::vector<uint8_t>& rgba) const;
+    void retire(Page& page);
+    void erase_page(Page* page);
+
+    int m_page_width;
+    int m_page_height;
+    size_t m_max_pages = 1;
+    std::vector<std::unique_ptr<Page>> m_pages;
+    std::map<std::string, Tile> m_tiles;
+    bool m_removed_since_compact = false;
+    // Retired pages may still be used by the frame being drawn
+    std::vector<std::pair<int, std::chrono::steady_clock::time_point>>
+        m_retired_images;
+};
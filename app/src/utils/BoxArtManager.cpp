@@ -2,88 +2,616 @@
 #include "Data.hpp"
 #include "Settings.hpp"
 #include "nanovg.h"
-#include <mutex>
 #include <CImg.h>
+#include <borealis.hpp>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
-
-std::mutex m_mutex;
+#include <fstream>
+#include <jansson.h>
+#include <thread>
 
 namespace {
-std::string boxart_path(int app_id) {
-    return (std::filesystem::path(Settings::instance().boxart_dir()) /
-            (std::to_string(app_id) + ".png"))
-            .string();
+namespace fs = std::filesystem;
+
+constexpr int WORKER_COUNT = 2;
+constexpr int DISPLAY_WIDTH = 300;
+constexpr int DISPLAY_HEIGHT = 400;
+constexpr uint32_t PIXELS_MAGIC = 0x31415842; // "BXA1"
+// Upload time allowed per ~frame, the rest waits for the next one
+constexpr auto UPLOAD_WINDOW = std::chrono::milliseconds(16);
+constexpr auto UPLOAD_BUDGET = std::chrono::milliseconds(3);
+constexpr int ATLAS_PAGE_SIZE = 2048;
+
+std::string boxart_path(const std::string& hash) {
+    return (fs::path(Settings::instance().boxart_dir()) / (hash + ".png"))
+        .string();
+}
+
+// Downscaled copy of <hash>.png for the forwarder icon, the original keeps
+// matching its hash
+std::string icon_path(const std::string& hash) {
+    return (fs::path(Settings::instance().boxart_dir()) / (hash + ".icon.png"))
+        .string();
+}
+
+std::string pixels_path(const std::string& hash) {
+    return (fs::path(Settings::instance().boxart_dir()) / (hash + ".rgba"))
+        .string();
+}
+
+bool read_pixels(const std::string& path, int& width, int& height,
+                 std::vector<uint8_t>& rgba) {
+    std::ifstream file(path, std::ios::binary);
+    uint32_t header[3] = {};
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        header[0] != PIXELS_MAGIC || header[1] == 0 || header[2] == 0 ||
+        header[1] > 4096 || header[2] > 4096) {
+        return false;
+    }
+
+    width = (int)header[1];
+    height = (int)header[2];
+    rgba.resize(size_t(width) * size_t(height) * 4);
+    return (bool)file.read(reinterpret_cast<char*>(rgba.data()),
+                           (std::streamsize)rgba.size());
+}
+
+void write_pixels(const std::string& path, int width, int height,
+                  const std::vector<uint8_t>& rgba) {
+    const auto temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        const uint32_t header[3] = {PIXELS_MAGIC, (uint32_t)width,
+                                    (uint32_t)height};
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(rgba.data()),
+                   (std::streamsize)rgba.size());
+        if (!file) {
+            return;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(temporary, path, error);
+}
+
+std::string index_path() {
+    return (fs::path(Settings::instance().boxart_dir()) / "index.json")
+        .string();
+}
+
+// FNV-1a, only used to tell images apart
+std::string content_hash(const Data& data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < data.size(); i++) {
+        hash ^= data.bytes()[i];
+        hash *= 1099511628211ULL;
+    }
+
+    char buffer[17] = {};
+    snprintf(buffer, sizeof(buffer), "%016" PRIx64, hash);
+    return buffer;
+}
+
+std::string host_id(const Host& host) {
+    if (!host.mac.empty()) {
+        return host.mac;
+    }
+    return host.preferred_address();
+}
+
+// Keeps the center of art larger than the display size, views aspect fill
+// anyway and smaller tiles pack tighter
+void crop_to_display(int& width, int& height, std::vector<uint8_t>& rgba) {
+    if (width <= DISPLAY_WIDTH && height <= DISPLAY_HEIGHT) {
+        return;
+    }
+
+    const int croppedWidth = std::min(width, DISPLAY_WIDTH);
+    const int croppedHeight = std::min(height, DISPLAY_HEIGHT);
+    const int left = (width - croppedWidth) / 2;
+    const int top = (height - croppedHeight) / 2;
+
+    std::vector<uint8_t> cropped(size_t(croppedWidth) * size_t(croppedHeight) *
+                                 4);
+    for (int y = 0; y < croppedHeight; y++) {
+        std::memcpy(cropped.data() + size_t(y) * croppedWidth * 4,
+                    rgba.data() +
+                        (size_t(top + y) * width + size_t(left)) * 4,
+                    size_t(croppedWidth) * 4);
+    }
+
+    width = croppedWidth;
+    height = croppedHeight;
+    rgba = std::move(cropped);
+}
+}
+
+std::string BoxArtManager::index_key(const Host& host, int app_id) {
+    return host_id(host) + "/" + std::to_string(app_id);
 }
+
+void BoxArtManager::load_index_locked() {
+    if (m_index_loaded) {
+        return;
+    }
+    m_index_loaded = true;
+
+    json_t* root = json_load_file(index_path().c_str(), 0, nullptr);
+    if (!root) {
+        // Interrupted between removing the old index and the rename
+        root = json_load_file((index_path() + ".tmp").c_str(), 0, nullptr);
+    }
+    if (!root) {
+        return;
+    }
+
+    if (json_typeof(root) == JSON_OBJECT) {
+        const char* key;
+        json_t* value;
+        json_object_foreach(root, key, value) {
+            if (json_typeof(value) == JSON_STRING) {
+                m_index[key] = json_string_value(value);
+            }
+        }
+    }
+    json_decref(root);
 }
 
-bool BoxArtManager::has_boxart(int app_id) {
-    if (m_has_boxart.count(app_id)) {
-        return m_has_boxart[app_id];
+void BoxArtManager::save_index() {
+    std::map<std::string, std::string> index;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        index = m_index;
+        version = m_index_version;
+    }
+
+    // Disk work stays off m_mutex, the UI thread takes it every frame
+    std::lock_guard<std::mutex> write_guard(m_index_write_mutex);
+    if (version <= m_index_written) {
+        // Another worker already wrote this or a newer index
+        return;
+    }
+
+    json_t* root = json_object();
+    for (const auto& [key, hash] : index) {
+        json_object_set_new(root, key.c_str(), json_string(hash.c_str()));
+    }
+
+    // Written aside and renamed over, a crash never leaves half an index
+    const auto path = index_path();
+    const auto temporary = path + ".tmp";
+    std::error_code error;
+    const bool written = json_dump_file(root, temporary.c_str(), 0) == 0;
+    json_decref(root);
+    if (written) {
+        fs::rename(temporary, path, error);
+        // Some filesystems refuse to rename over an existing file
+        if (error && fs::exists(path)) {
+            fs::remove(path, error);
+            fs::rename(temporary, path, error);
+        }
+    }
+    if (!written || error) {
+        brls::Logger::error("BoxArtManager: Failed to save the box art index");
+        return;
     }
+    m_index_written = version;
+
+    prune_files(index);
+}
+
+void BoxArtManager::prune_files(const std::map<std::string, std::string>& index) {
+    std::set<std::string> referenced;
+    for (const auto& [key, hash] : index) {
+        referenced.insert(hash);
+    }
+
+    // Only <hash>.png, <hash>.icon.png, <hash>.rgba and leftover temporary
+    // files are ours
+    std::error_code error;
+    std::vector<std::pair<std::string, fs::path>> candidates;
+    for (fs::directory_iterator it(Settings::instance().boxart_dir(), error),
+         end;
+         !error && it != end; it.increment(error)) {
+        const auto name = it->path().filename().string();
+        const auto hash = name.substr(0, name.find('.'));
+        const auto extension = name.substr(hash.size());
+        if (hash.size() != 16 ||
+            hash.find_first_not_of("0123456789abcdef") != std::string::npos ||
+            (extension != ".png" && extension != ".icon.png" &&
+             extension != ".icon.tmp.png" && extension != ".rgba" &&
+             extension != ".rgba.tmp")) {
+            continue;
+        }
+        if (!referenced.count(hash)) {
+            candidates.emplace_back(hash, it->path());
+        }
+    }
+    if (candidates.empty()) {
+        return;
+    }
+
+    // The index may have moved on while scanning, keep what it refers to now
+    std::vector<std::pair<std::string, fs::path>> unreferenced;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        referenced = m_storing;
+        for (const auto& [key, hash] : m_index) {
+            referenced.insert(hash);
+        }
+        for (auto& candidate : candidates) {
+            if (!referenced.count(candidate.first)) {
+                unreferenced.push_back(std::move(candidate));
+            }
+        }
+    }
+
+    for (const auto& [hash, path] : unreferenced) {
+        fs::remove(path, error);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (const auto& [hash, path] : unreferenced) {
+            m_file_exists.erase(hash);
+        }
+    }
+    brls::Logger::debug("BoxArtManager: Pruned {} unreferenced files",
+                        unreferenced.size());
+}
+
+std::string BoxArtManager::hash_locked(const Host& host, int app_id) {
+    load_index_locked();
+
+    auto it = m_index.find(index_key(host, app_id));
+    return it == m_index.end() ? "" : it->second;
+}
 
-    std::string path = boxart_path(app_id);
-    Data data = Data::read_from_file(path);
-    m_has_boxart[app_id] = !data.is_empty();
+bool BoxArtManager::file_exists_locked(const std::string& hash) {
+    if (auto it = m_file_exists.find(hash); it != m_file_exists.end()) {
+        return it->second;
+    }
 
-    return m_has_boxart[app_id];
+    std::error_code error;
+    const bool exists = fs::is_regular_file(boxart_path(hash), error);
+    m_file_exists[hash] = exists;
+    return exists;
 }
 
-void BoxArtManager::set_data(Data data, int app_id) {
+bool BoxArtManager::has_boxart(const Host& host, int app_id) {
     std::lock_guard<std::mutex> guard(m_mutex);
 
-    std::string path = boxart_path(app_id);
+    const auto hash = hash_locked(host, app_id);
+    return !hash.empty() && file_exists_locked(hash);
+}
+
+void BoxArtManager::set_data(const Host& host, int app_id, Data data) {
+    const auto key = index_key(host, app_id);
+
+    enqueue([this, key, data]() mutable {
+        const auto hash = content_hash(data);
+
+        // The same art for several apps, or sent twice, is written once
+        bool store;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            store = !file_exists_locked(hash) && !m_requested.count(hash) &&
+                    !m_storing.count(hash);
+            if (store) {
+                m_requested.insert(hash);
+                m_storing.insert(hash);
+            }
+        }
+
+        if (store) {
+            data.write_to_file(boxart_path(hash));
+            prepare(hash);
+        }
+
+        bool changed = false;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            load_index_locked();
+            if (store) {
+                m_file_exists.erase(hash);
+                m_storing.erase(hash);
+            }
+            if (m_index[key] != hash) {
+                m_index[key] = hash;
+                m_index_version++;
+                changed = true;
+            }
+        }
+
+        if (changed) {
+            save_index();
+        }
+    });
+}
+
+void BoxArtManager::retain_apps(const Host& host,
+                                const std::set<int>& app_ids) {
+    const auto prefix = host_id(host) + "/";
+
+    // Pruning touches the disk, keep it off the UI thread
+    enqueue([this, prefix, app_ids] {
+        bool changed = false;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            load_index_locked();
 
-    data.write_to_file(path);
-    compress_texture(path);
+            for (auto it = m_index.lower_bound(prefix);
+                 it != m_index.end() && it->first.rfind(prefix, 0) == 0;) {
+                if (!app_ids.count(atoi(it->first.c_str() + prefix.size()))) {
+                    it = m_index.erase(it);
+                    changed = true;
+                } else {
+                    ++it;
+                }
+            }
+            if (changed) {
+                m_index_version++;
+            }
+        }
+
+        if (changed) {
+            save_index();
+        }
+    });
+}
 
-    m_has_boxart[app_id] = true;
+void BoxArtManager::remove_host(const Host& host) {
+    retain_apps(host, {});
 }
 
-void BoxArtManager::compress_texture(const std::string& path) {
+bool BoxArtManager::decode_png(const std::string& hash, Pixels& pixels) {
     using namespace cimg_library;
 
-    /*
-     * target width == 300
-     * target height == 400
-     * 0.75 == 300 / 400
-     */
+    CImg<unsigned char> pic;
+    try {
+        pic.assign(boxart_path(hash).c_str());
+    } catch (...) {
+        return false;
+    }
+
+    if (pic.width() <= 0 || pic.height() <= 0) {
+        return false;
+    }
 
-    CImg<unsigned char> pic(path.c_str());
-    if (float(pic.width()) / float(pic.height()) < 0.75f) {
-        pic = pic.resize(300, int(float(pic.height()) * 300.0f / float(pic.width())), 1, 3);
+    // Cover DISPLAY_WIDTH x DISPLAY_HEIGHT keeping the aspect ratio
+    if (float(pic.width()) / float(pic.height()) <
+        float(DISPLAY_WIDTH) / float(DISPLAY_HEIGHT)) {
+        pic.resize(DISPLAY_WIDTH,
+                   int(float(pic.height()) * DISPLAY_WIDTH / float(pic.width())),
+                   1, -100, 3);
     } else {
-        pic = pic.resize(int(float(pic.width()) * 400.0f / float(pic.height())), 400, 1, 3);
+        pic.resize(int(float(pic.width()) * DISPLAY_HEIGHT / float(pic.height())),
+                   DISPLAY_HEIGHT, 1, -100, 3);
     }
-    pic.save(path.c_str());
+
+    pixels.width = pic.width();
+    pixels.height = pic.height();
+    pixels.rgba.resize(size_t(pixels.width) * size_t(pixels.height) * 4);
+
+    const int channels = pic.spectrum();
+    uint8_t* out = pixels.rgba.data();
+    for (int y = 0; y < pixels.height; y++) {
+        for (int x = 0; x < pixels.width; x++) {
+            const unsigned char r = pic(x, y, 0, 0);
+            const unsigned char g = channels > 2 ? pic(x, y, 0, 1) : r;
+            const unsigned char b = channels > 2 ? pic(x, y, 0, 2) : r;
+            const unsigned char a =
+                channels > 3 ? pic(x, y, 0, 3)
+                             : (channels == 2 ? pic(x, y, 0, 1) : 255);
+
+            out[0] = uint8_t((r * a + 127) / 255);
+            out[1] = uint8_t((g * a + 127) / 255);
+            out[2] = uint8_t((b * a + 127) / 255);
+            out[3] = a;
+            out += 4;
+        }
+    }
+
+    // The forwarder icon doesn't need the full size art
+    std::error_code error;
+    const auto icon = icon_path(hash);
+    if (!fs::is_regular_file(icon, error)) {
+        const auto temporary = (fs::path(Settings::instance().boxart_dir()) /
+                                (hash + ".icon.tmp.png"))
+                                   .string();
+        try {
+            pic.save(temporary.c_str());
+            fs::rename(temporary, icon, error);
+        } catch (...) {
+            fs::remove(temporary, error);
+        }
+    }
+    return true;
 }
 
-std::string BoxArtManager::get_texture_path(int app_id) {
-    return boxart_path(app_id);
+BoxArtManager::BoxArtManager() : m_atlas(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE) {
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        m_workers.emplace_back([this] { worker(); });
+    }
 }
 
-void BoxArtManager::make_texture_from_boxart(NVGcontext* ctx, int app_id) {
-    std::lock_guard<std::mutex> guard(m_mutex);
+BoxArtManager::~BoxArtManager() { shutdown(); }
+
+void BoxArtManager::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_jobs_mutex);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_jobs_changed.notify_all();
+
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void BoxArtManager::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_jobs_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobs_changed.notify_one();
+}
+
+void BoxArtManager::worker() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_jobs_mutex);
+            m_jobs_changed.wait(
+                lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void BoxArtManager::prepare(const std::string& hash) {
+    Pixels pixels;
+    pixels.hash = hash;
+
+    const bool cached = read_pixels(pixels_path(hash), pixels.width,
+                                    pixels.height, pixels.rgba);
+    const bool decoded = cached || decode_png(hash, pixels);
 
-    std::string path = boxart_path(app_id);
-    Data data = Data::read_from_file(path);
+    // Cropped before caching so the .rgba holds only what gets uploaded,
+    // caches written uncropped by older versions are cropped on read
+    if (decoded) {
+        crop_to_display(pixels.width, pixels.height, pixels.rgba);
+    }
+    if (decoded && !cached) {
+        write_pixels(pixels_path(hash), pixels.width, pixels.height,
+                     pixels.rgba);
+    }
 
-    if (data.is_empty()) {
-        m_has_boxart[app_id] = false;
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!decoded) {
+        brls::Logger::warning("BoxArtManager: Failed to decode {}", hash);
+        m_file_exists[hash] = false;
+        m_requested.erase(hash);
         return;
     }
+    m_ready.push_back(std::move(pixels));
+}
 
-    int handle = nvgCreateImageMem(ctx, 0, data.bytes(), (int)data.size());
+std::string BoxArtManager::get_texture_path(const Host& host, int app_id) {
+    std::lock_guard<std::mutex> guard(m_mutex);
 
-    if (handle > 0) {
-        m_texture_handle[app_id] = handle;
-    } else {
-        m_has_boxart[app_id] = false;
+    const auto hash = hash_locked(host, app_id);
+    if (hash.empty() || !file_exists_locked(hash)) {
+        return "";
     }
+
+    std::error_code error;
+    const auto icon = icon_path(hash);
+    return fs::is_regular_file(icon, error) ? icon : boxart_path(hash);
 }
 
-int BoxArtManager::texture_id(int app_id) {
-    if (m_texture_handle.count(app_id)) {
-        return m_texture_handle[app_id];
+void BoxArtManager::request_texture(const Host& host, int app_id) {
+    std::string hash;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        hash = hash_locked(host, app_id);
+        if (hash.empty() || m_textures.count(hash) ||
+            m_requested.count(hash) || !file_exists_locked(hash)) {
+            return;
+        }
+        m_requested.insert(hash);
     }
-    return -1;
+
+    enqueue([this, hash] { prepare(hash); });
+}
+
+void BoxArtManager::upload_pending(NVGcontext* ctx) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_upload_window_start >= UPLOAD_WINDOW) {
+        m_upload_window_start = now;
+        m_upload_window_used = std::chrono::steady_clock::duration::zero();
+    }
+
+    const size_t pageBytes = size_t(ATLAS_PAGE_SIZE) * ATLAS_PAGE_SIZE * 4;
+    const int budgetMb = Settings::instance().boxart_texture_budget_mb();
+    m_atlas.set_max_pages(size_t(std::max(budgetMb, 1)) * 1024 * 1024 /
+                          pageBytes);
+
+    while (!m_ready.empty() && m_upload_window_used < UPLOAD_BUDGET) {
+        const auto started = std::chrono::steady_clock::now();
+
+        Pixels pixels = std::move(m_ready.front());
+        m_ready.pop_front();
+        m_requested.erase(pixels.hash);
+
+        if (m_textures.count(pixels.hash)) {
+            continue;
+        }
+
+        // The most recent tile always stays, even if the atlas is too small
+        bool packed = false;
+        while (!(packed = m_atlas.insert(pixels.hash, pixels.width,
+                                         pixels.height, pixels.rgba.data())) &&
+               !m_lru.empty()) {
+            evict_oldest_locked();
+        }
+
+        if (packed) {
+            m_lru.push_front(pixels.hash);
+            m_textures[pixels.hash] = m_lru.begin();
+        }
+
+        m_upload_window_used += std::chrono::steady_clock::now() - started;
+    }
+
+    m_atlas.compact();
+    m_atlas.upload(ctx);
+}
+
+void BoxArtManager::evict_oldest_locked() {
+    const auto hash = m_lru.back();
+    m_lru.pop_back();
+    m_textures.erase(hash);
+    m_atlas.remove(hash);
+}
+
+bool BoxArtManager::texture_region(const Host& host, int app_id,
+                                   AtlasRegion& region) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    const auto hash = hash_locked(host, app_id);
+    auto it = m_textures.find(hash);
+    if (it == m_textures.end()) {
+        return false;
+    }
+
+    if (!m_atlas.region(hash, region)) {
+        // Dropped by compact(), request_texture() brings it back
+        if (!m_atlas.contains(hash)) {
+            m_lru.erase(it->second);
+            m_textures.erase(it);
+        }
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return true;
 }
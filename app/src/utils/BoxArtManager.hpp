@@ -1,24 +1,113 @@
+#include "BoxArtAtlas.hpp"
 #include "Singleton.hpp"
-#include <map>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 #pragma once
 
 struct NVGcontext;
 struct Data;
+struct Host;
 
+// Box art cache keyed by (host, app id). Images are stored once per
+// content hash as <boxart_dir>/<hash>.png, index.json maps host/app pairs
+// to hashes. Art on the GPU lives in a BoxArtAtlas whose pages are kept
+// within a budget, tiles are evicted LRU.
+//
+// Decoding happens on a small worker pool: every image is decoded and
+// resized once to premultiplied RGBA at display size and kept next to the
+// PNG as <hash>.rgba. The UI thread only packs ready pixels into the atlas,
+// a few per frame, from upload_pending() which the main loop calls once
+// per frame.
 class BoxArtManager : public Singleton<BoxArtManager> {
   public:
-    bool has_boxart(int app_id);
+    BoxArtManager();
+    ~BoxArtManager();
+
+    bool has_boxart(const Host& host, int app_id);
+
+    // Stores and preprocesses downloaded art on the worker pool
+    void set_data(const Host& host, int app_id, Data data);
+    // The downscaled icon once the art has been decoded, else the original
+    // art. Empty string when no art is cached for the app
+    std::string get_texture_path(const Host& host, int app_id);
 
-    void set_data(Data data, int app_id);
-    static std::string get_texture_path(int app_id);
-    void make_texture_from_boxart(NVGcontext* ctx, int app_id);
-    int texture_id(int app_id);
+    // Forget art of apps the host no longer lists, or of the whole host.
+    // Images nothing refers to anymore are deleted with the next index save.
+    void retain_apps(const Host& host, const std::set<int>& app_ids);
+    void remove_host(const Host& host);
+
+    // Queues decoding of cached art, the region shows up in
+    // texture_region() after a later upload_pending()
+    void request_texture(const Host& host, int app_id);
+    // UI thread only, once per frame. Packs decoded images within a time
+    // budget.
+    void upload_pending(NVGcontext* ctx);
+    bool texture_region(const Host& host, int app_id, AtlasRegion& region);
+
+    // Stops and joins the workers, queued jobs are dropped
+    void shutdown();
 
   private:
-    std::map<int, bool> m_has_boxart;
-    std::map<int, int> m_texture_handle;
-    static void compress_texture(const std::string& path);
+    struct Pixels {
+        std::string hash;
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    static std::string index_key(const Host& host, int app_id);
+    // Decodes <hash>.png, which is never written back
+    static bool decode_png(const std::string& hash, Pixels& pixels);
+
+    void load_index_locked();
+    // Writes a snapshot of the index, then deletes images it no longer
+    // refers to. Workers only, never with m_mutex held.
+    void save_index();
+    void prune_files(const std::map<std::string, std::string>& index);
+    std::string hash_locked(const Host& host, int app_id);
+    bool file_exists_locked(const std::string& hash);
+    void evict_oldest_locked();
+
+    void enqueue(std::function<void()> job);
+    void worker();
+    void prepare(const std::string& hash);
+
+    std::mutex m_mutex;
+    bool m_index_loaded = false;
+    std::map<std::string, std::string> m_index;
+    // Bumped by every index change, m_index_written is the last one saved
+    uint64_t m_index_version = 0;
+    std::mutex m_index_write_mutex;
+    uint64_t m_index_written = 0;
+    std::map<std::string, bool> m_file_exists;
+    // Written by set_data() but not in the index yet, pruning skips them
+    std::set<std::string> m_storing;
+
+    BoxArtAtlas m_atlas;
+    // Hashes in the atlas, most recently drawn first
+    std::map<std::string, std::list<std::string>::iterator> m_textures;
+    std::list<std::string> m_lru;
+
+    std::set<std::string> m_requested;
+    std::deque<Pixels> m_ready;
+    std::chrono::steady_clock::time_point m_upload_window_start;
+    std::chrono::steady_clock::duration m_upload_window_used{};
+
+    std::mutex m_jobs_mutex;
+    std::condition_variable m_jobs_changed;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
 };
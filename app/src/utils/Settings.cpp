@@ -5,6 +5,12 @@
 #include <iomanip>
 #include <climits>
 #include <filesystem>
+#include <set>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
 
 using namespace brls;
 using namespace brls::literals;
@@ -37,12 +43,22 @@ void merge_host(Host& target, const Host& source) {
         target.mac = source.mac;
 }
 
+// Hint keys carry the HTTP port when it isn't the default one
+std::string hint_host_address(const std::string& address) {
+    return address.substr(0, address.find(':'));
+}
+
 std::string make_preferred_path(const fs::path& path) {
     auto preferred = path;
     preferred.make_preferred();
     return preferred.string();
 }
 
+// Quiet time after the last save() before writing, and the longest a save
+// can be held back by further ones
+constexpr auto SAVE_DEBOUNCE = std::chrono::milliseconds(500);
+constexpr auto SAVE_MAX_DELAY = std::chrono::seconds(3);
+
 std::string settings_file_path(const std::string& working_dir) {
     return make_preferred_path(fs::path(working_dir) / "settings.json");
 }
@@ -67,6 +83,7 @@ void Settings::set_working_dir(const std::string& working_dir) {
     m_working_dir = base_path.string();
     m_key_dir = make_preferred_path(base_path / "key");
     m_boxart_dir = make_preferred_path(base_path / "boxart");
+    m_host_cache_dir = make_preferred_path(base_path / "host_cache");
     m_log_path = make_preferred_path(base_path / "log.log");
     m_gamepad_mapping_path =
             make_preferred_path(base_path / "gamepad_mapping_v1.2.0.json");
@@ -75,6 +92,7 @@ void Settings::set_working_dir(const std::string& working_dir) {
     fs::create_directories(base_path, error);
     fs::create_directories(fs::path(m_key_dir), error);
     fs::create_directories(fs::path(m_boxart_dir), error);
+    fs::create_directories(fs::path(m_host_cache_dir), error);
     
     load();
 }
@@ -95,11 +113,109 @@ void Settings::remove_host(const Host& host) {
     });
     
     if (it != m_hosts.end()) {
+        {
+            std::lock_guard<std::mutex> lock(m_server_info_hints_mutex);
+            for (const auto& address : it->connection_addresses()) {
+                m_server_info_hints.erase(address);
+            }
+        }
+
         m_hosts.erase(it);
         save();
     }
 }
 
+bool Settings::server_info_hint(const std::string& address, ServerInfoHint* hint) {
+    std::lock_guard<std::mutex> lock(m_server_info_hints_mutex);
+    auto it = m_server_info_hints.find(address);
+    if (it == m_server_info_hints.end()) {
+        return false;
+    }
+
+    *hint = it->second;
+    return true;
+}
+
+void Settings::set_server_info_hint(const std::string& address, const ServerInfoHint& hint) {
+    if (address.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_server_info_hints_mutex);
+        auto it = m_server_info_hints.find(address);
+        if (it != m_server_info_hints.end() && it->second == hint) {
+            return;
+        }
+        m_server_info_hints[address] = hint;
+    }
+
+    // Called from gs_init worker threads
+    brls::sync([] { Settings::instance().save(); });
+}
+
+void Settings::prune_server_info_hints(const std::vector<Host>& discovered) {
+    std::set<std::string> known;
+    auto add_known = [&known](const std::vector<Host>& hosts) {
+        for (const auto& host : hosts) {
+            for (const auto& address : host.connection_addresses()) {
+                known.insert(hint_host_address(address));
+            }
+        }
+    };
+    add_known(m_hosts);
+    add_known(discovered);
+
+    bool pruned = false;
+    {
+        std::lock_guard<std::mutex> lock(m_server_info_hints_mutex);
+        for (auto it = m_server_info_hints.begin(); it != m_server_info_hints.end();) {
+            if (known.count(hint_host_address(it->first))) {
+                ++it;
+            } else {
+                it = m_server_info_hints.erase(it);
+                pruned = true;
+            }
+        }
+    }
+
+    if (pruned) {
+        save();
+    }
+}
+
+std::string Settings::preferred_connection_address(const std::string& network,
+                                                   const std::string& host_key) {
+    std::lock_guard<std::mutex> lock(m_preferred_addresses_mutex);
+    auto network_it = m_preferred_addresses.find(network);
+    if (network_it == m_preferred_addresses.end()) {
+        return "";
+    }
+
+    auto host_it = network_it->second.find(host_key);
+    return host_it != network_it->second.end() ? host_it->second : "";
+}
+
+void Settings::set_preferred_connection_address(const std::string& network,
+                                                const std::string& host_key,
+                                                const std::string& address) {
+    if (network.empty() || host_key.empty() || address.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_preferred_addresses_mutex);
+        auto& current = m_preferred_addresses[network][host_key];
+        if (current == address) {
+            return;
+        }
+        current = address;
+    }
+
+    // Called from connection worker threads
+    brls::sync([] { Settings::instance().save(); });
+}
+
 void Settings::add_favorite(const Host& host, const App& app) {
     if (Host* existing = find_host(m_hosts, host)) {
         auto app_it = std::find_if(existing->favorites.begin(), existing->favorites.end(), [app](auto h){
@@ -151,7 +267,23 @@ bool Settings::has_any_favorite() {
 void Settings::load() {
     loadBaseLayouts();
 
-    json_t* root = json_load_file(settings_file_path(m_working_dir).c_str(), 0, nullptr);
+    const auto path = settings_file_path(m_working_dir);
+    json_t* root = json_load_file(path.c_str(), 0, nullptr);
+    if (!root || json_typeof(root) != JSON_OBJECT) {
+        // A write interrupted between removing the old file and the rename
+        // leaves only the temporary one, it is complete once it parses
+        const auto temporary = path + ".tmp";
+        if (json_t* written = json_load_file(temporary.c_str(), 0, nullptr)) {
+            brls::Logger::warning("Settings: Recovering {}", temporary);
+            if (root)
+                json_decref(root);
+            root = written;
+
+            std::error_code error;
+            fs::remove(path, error);
+            fs::rename(temporary, path, error);
+        }
+    }
     
     if (root && json_typeof(root) == JSON_OBJECT) {
         if (json_t* hosts = json_object_get(root, "hosts")) {
@@ -220,6 +352,53 @@ void Settings::load() {
             }
         }
         
+        if (json_t* hints = json_object_get(root, "server_info_hints")) {
+            const char *address;
+            json_t *value;
+            std::lock_guard<std::mutex> lock(m_server_info_hints_mutex);
+            json_object_foreach(hints, address, value) {
+                if (json_typeof(value) != JSON_OBJECT) {
+                    continue;
+                }
+
+                ServerInfoHint hint;
+                if (json_t* https_port = json_object_get(value, "https_port")) {
+                    if (json_typeof(https_port) == JSON_INTEGER) {
+                        hint.https_port = (unsigned short)json_integer_value(https_port);
+                    }
+                }
+
+                if (json_t* paired = json_object_get(value, "paired")) {
+                    hint.paired = json_typeof(paired) == JSON_TRUE;
+                }
+
+                if (json_t* https = json_object_get(value, "https")) {
+                    hint.https = json_typeof(https) == JSON_TRUE;
+                }
+
+                m_server_info_hints[address] = hint;
+            }
+        }
+        
+        if (json_t* preferred_addresses = json_object_get(root, "preferred_addresses")) {
+            const char *network;
+            json_t *hosts;
+            std::lock_guard<std::mutex> lock(m_preferred_addresses_mutex);
+            json_object_foreach(preferred_addresses, network, hosts) {
+                if (json_typeof(hosts) != JSON_OBJECT) {
+                    continue;
+                }
+
+                const char *host_key;
+                json_t *address;
+                json_object_foreach(hosts, host_key, address) {
+                    if (json_typeof(address) == JSON_STRING) {
+                        m_preferred_addresses[network][host_key] = json_string_value(address);
+                    }
+                }
+            }
+        }
+
         if (json_t* settings = json_object_get(root, "settings")) {
             if (json_t* resolution = json_object_get(settings, "resolution")) {
                 if (json_typeof(resolution) == JSON_INTEGER) {
@@ -396,6 +575,30 @@ void Settings::load() {
                 }
             }
 
+            if (json_t* stun_server = json_object_get(settings, "stun_server")) {
+                if (json_typeof(stun_server) == JSON_STRING) {
+                    m_stun_server = json_string_value(stun_server);
+                }
+            }
+
+            if (json_t* boxart_texture_budget = json_object_get(settings, "boxart_texture_budget_mb")) {
+                if (json_typeof(boxart_texture_budget) == JSON_INTEGER) {
+                    m_boxart_texture_budget_mb = (int)json_integer_value(boxart_texture_budget);
+                }
+            }
+
+            if (json_t* input_sampling_rate = json_object_get(settings, "input_sampling_rate")) {
+                if (json_typeof(input_sampling_rate) == JSON_INTEGER) {
+                    m_input_sampling_rate = (int)json_integer_value(input_sampling_rate);
+                }
+            }
+
+            if (json_t* input_min_send_interval = json_object_get(settings, "input_min_send_interval_ms")) {
+                if (json_typeof(input_min_send_interval) == JSON_INTEGER) {
+                    m_input_min_send_interval_ms = (int)json_integer_value(input_min_send_interval);
+                }
+            }
+
             if (json_t* current_mapping_layout = json_object_get(settings, "current_mapping_layout")) {
                 if (json_typeof(current_mapping_layout) == JSON_INTEGER) {
                     m_current_mapping_layout = (int)json_integer_value(current_mapping_layout);
@@ -500,10 +703,14 @@ void Settings::load() {
         }
         
         json_decref(root);
+
+        // Nothing has been discovered yet this session
+        prune_server_info_hints({});
     }
 }
 
 void Settings::save() {
+    const auto started = std::chrono::steady_clock::now();
     json_t* root = json_object();
     
     if (root) {
@@ -529,6 +736,32 @@ void Settings::save() {
             }
             json_object_set_new(root, "hosts", hosts);
         }
+
+        if (json_t* hints = json_object()) {
+            std::lock_guard<std::mutex> lock(m_server_info_hints_mutex);
+            for (const auto& [address, hint]: m_server_info_hints) {
+                if (json_t* json = json_object()) {
+                    json_object_set_new(json, "https_port", json_integer(hint.https_port));
+                    json_object_set_new(json, "paired", hint.paired ? json_true() : json_false());
+                    json_object_set_new(json, "https", hint.https ? json_true() : json_false());
+                    json_object_set_new(hints, address.c_str(), json);
+                }
+            }
+            json_object_set_new(root, "server_info_hints", hints);
+        }
+
+        if (json_t* preferred_addresses = json_object()) {
+            std::lock_guard<std::mutex> lock(m_preferred_addresses_mutex);
+            for (const auto& [network, hosts]: m_preferred_addresses) {
+                if (json_t* json = json_object()) {
+                    for (const auto& [host_key, address]: hosts) {
+                        json_object_set_new(json, host_key.c_str(), json_string(address.c_str()));
+                    }
+                    json_object_set_new(preferred_addresses, network.c_str(), json);
+                }
+            }
+            json_object_set_new(root, "preferred_addresses", preferred_addresses);
+        }
         
         if (json_t* settings = json_object()) {
             json_object_set_new(settings, "resolution", json_integer(m_resolution));
@@ -564,6 +797,10 @@ void Settings::save() {
             json_object_set_new(settings, "deadzone_stick_left", json_integer(int(m_deadzone_stick_left * 100.f)));
             json_object_set_new(settings, "deadzone_stick_right", json_integer(int(m_deadzone_stick_right * 100.f)));
             json_object_set_new(settings, "rumble_force", json_integer(m_rumble_force));
+            json_object_set_new(settings, "stun_server", json_string(m_stun_server.c_str()));
+            json_object_set_new(settings, "boxart_texture_budget_mb", json_integer(m_boxart_texture_budget_mb));
+            json_object_set_new(settings, "input_sampling_rate", json_integer(m_input_sampling_rate));
+            json_object_set_new(settings, "input_min_send_interval_ms", json_integer(m_input_min_send_interval_ms));
             json_object_set_new(settings, "current_mapping_layout", json_integer(m_current_mapping_layout));
             json_object_set_new(settings, "keyboard_type", json_integer(m_keyboard_type));
             json_object_set_new(settings, "keyboard_fingers", json_integer(m_keyboard_fingers));
@@ -612,11 +849,135 @@ void Settings::save() {
             json_object_set_new(root, "mapping_layouts", hosts);
         }
         
-        json_dump_file(root, settings_file_path(m_working_dir).c_str(), JSON_INDENT(4));
-        json_decref(root);
+        {
+            std::unique_lock<std::mutex> lock(m_save_mutex);
+            if (m_writer_stopped) {
+                // After flush() nothing writes in the background anymore
+                lock.unlock();
+                std::lock_guard<std::mutex> write_lock(m_write_mutex);
+                write_settings_file(root);
+                return;
+            }
+
+            // Only the latest snapshot is worth writing
+            if (m_pending_save)
+                json_decref(m_pending_save);
+            m_pending_save = root;
+            m_last_save_request = std::chrono::steady_clock::now();
+
+            if (!m_writer.joinable())
+                m_writer = std::thread([this] { write_pending_saves(); });
+        }
+        m_save_requested.notify_all();
+
+        brls::Logger::debug("Settings: Save queued in {} us",
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started).count());
     }
 }
 
+void Settings::write_pending_saves() {
+    std::unique_lock<std::mutex> lock(m_save_mutex);
+    while (true) {
+        m_save_requested.wait(lock, [this] {
+            return m_pending_save != nullptr || m_writer_stopped;
+        });
+        // flush() writes whatever is still pending
+        if (m_writer_stopped)
+            return;
+
+        // Coalesce bursts, a save that keeps getting replaced still lands
+        // within SAVE_MAX_DELAY
+        const auto first_request = m_last_save_request;
+        while (m_pending_save && !m_writer_stopped) {
+            const auto deadline = std::min(m_last_save_request + SAVE_DEBOUNCE,
+                                           first_request + SAVE_MAX_DELAY);
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            m_save_requested.wait_until(lock, deadline);
+        }
+
+        if (m_writer_stopped)
+            return;
+
+        json_t* root = m_pending_save;
+        m_pending_save = nullptr;
+        if (!root)
+            continue;
+
+        std::lock_guard<std::mutex> write_lock(m_write_mutex);
+        lock.unlock();
+        write_settings_file(root);
+        lock.lock();
+    }
+}
+
+Settings::~Settings() {
+    flush();
+}
+
+void Settings::flush() {
+    std::thread writer;
+    {
+        std::lock_guard<std::mutex> lock(m_save_mutex);
+        m_writer_stopped = true;
+        writer = std::move(m_writer);
+    }
+    m_save_requested.notify_all();
+
+    // Also waits for a write the background thread already started
+    if (writer.joinable())
+        writer.join();
+
+    json_t* root;
+    {
+        std::lock_guard<std::mutex> lock(m_save_mutex);
+        root = m_pending_save;
+        m_pending_save = nullptr;
+    }
+
+    std::lock_guard<std::mutex> write_lock(m_write_mutex);
+    if (root)
+        write_settings_file(root);
+}
+
+void Settings::write_settings_file(json_t* root) {
+    const auto started = std::chrono::steady_clock::now();
+    const auto path = settings_file_path(m_working_dir);
+    const auto temporary = path + ".tmp";
+
+    // Written aside and renamed over, a crash never leaves half a file
+    bool written = false;
+    if (FILE* file = fopen(temporary.c_str(), "wb")) {
+        written = json_dumpf(root, file, JSON_INDENT(4)) == 0 && fflush(file) == 0;
+#if !defined(_WIN32)
+        written = written && fsync(fileno(file)) == 0;
+#endif
+        written = fclose(file) == 0 && written;
+    }
+    json_decref(root);
+
+    std::error_code error;
+    if (written) {
+        fs::rename(temporary, path, error);
+        // Some filesystems, the Switch SD card among them, refuse to rename
+        // over an existing file
+        if (error == std::errc::file_exists) {
+            fs::remove(path, error);
+            fs::rename(temporary, path, error);
+        }
+    }
+
+    if (!written || error) {
+        brls::Logger::error("Settings: Failed to write {}", path);
+        return;
+    }
+
+    brls::Logger::debug("Settings: Written in background in {} us",
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count());
+}
+
 void Settings::loadBaseLayouts() {
     KeyMappingLayout defaultLayout {
         .title = "settings/keys_mapping_default"_i18n,
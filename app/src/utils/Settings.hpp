@@ -2,12 +2,18 @@
 
 #include "Singleton.hpp"
 #include <borealis.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <cstdio>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+struct json_t;
+
 enum VideoCodec : int { H264, H265, AV1 };
 std::string getVideoCodecName(VideoCodec codec);
 
@@ -66,6 +72,19 @@ struct Host {
     }
 };
 
+// What the last successful serverinfo exchange with an address looked like,
+// so gs_init can go straight to the request that is known to work.
+struct ServerInfoHint {
+    unsigned short https_port = 0;
+    bool paired = false;
+    bool https = false;
+
+    bool operator==(const ServerInfoHint& other) const {
+        return https_port == other.https_port && paired == other.paired &&
+               https == other.https;
+    }
+};
+
 inline bool hosts_match(const Host& lhs, const Host& rhs) {
     if (!lhs.mac.empty() && !rhs.mac.empty())
         return lhs.mac == rhs.mac;
@@ -80,6 +99,8 @@ inline bool hosts_match(const Host& lhs, const Host& rhs) {
 
 class Settings : public Singleton<Settings> {
   public:
+    ~Settings();
+
     [[nodiscard]] std::string working_dir() const { return m_working_dir; }
 
     void set_working_dir(const std::string& working_dir);
@@ -91,6 +112,8 @@ class Settings : public Singleton<Settings> {
 
     [[nodiscard]] std::string boxart_dir() const { return m_boxart_dir; }
 
+    [[nodiscard]] std::string host_cache_dir() const { return m_host_cache_dir; }
+
     [[nodiscard]] std::string log_path() const { return m_log_path; }
 
     [[nodiscard]] std::string gamepad_mapping_path() const { return m_gamepad_mapping_path; }
@@ -100,6 +123,15 @@ class Settings : public Singleton<Settings> {
     void add_host(const Host& host);
     void remove_host(const Host& host);
 
+    bool server_info_hint(const std::string& address, ServerInfoHint* hint);
+    void set_server_info_hint(const std::string& address, const ServerInfoHint& hint);
+    // Drops hints for addresses that are neither saved nor in `discovered`
+    void prune_server_info_hints(const std::vector<Host>& discovered);
+
+    std::string preferred_connection_address(const std::string& network, const std::string& host_key);
+    void set_preferred_connection_address(const std::string& network, const std::string& host_key,
+                                          const std::string& address);
+
     void add_favorite(const Host& host, const App& app);
     void remove_favorite(const Host& host, int app_id);
     bool is_favorite(const Host& host, int app_id);
@@ -310,23 +342,59 @@ class Settings : public Singleton<Settings> {
     void set_deadzone_stick_right(float deadzone) { m_deadzone_stick_right = deadzone; }
     [[nodiscard]] float get_deadzone_stick_right() const { return m_deadzone_stick_right; }
 
+    void set_stun_server(const std::string& stun_server) { m_stun_server = stun_server; }
+    [[nodiscard]] std::string stun_server() const { return m_stun_server; }
+
+    void set_boxart_texture_budget_mb(int budget) { m_boxart_texture_budget_mb = budget; }
+    [[nodiscard]] int boxart_texture_budget_mb() const { return m_boxart_texture_budget_mb; }
+
+    void set_input_sampling_rate(int rate) { m_input_sampling_rate = rate; }
+    [[nodiscard]] int input_sampling_rate() const { return m_input_sampling_rate; }
+
+    void set_input_min_send_interval_ms(int interval) { m_input_min_send_interval_ms = interval; }
+    [[nodiscard]] int input_min_send_interval_ms() const { return m_input_min_send_interval_ms; }
+
     int get_current_mapping_layout();
     void set_current_mapping_layout(int layout) { m_current_mapping_layout = layout; }
 
     std::vector<KeyMappingLayout>* get_mapping_laouts() { return &m_mapping_laouts; }
 
     void load();
+    // Snapshots the settings and hands them to a background writer, which
+    // waits for a burst of saves to settle before writing once
     void save();
+    // Stops the background writer and writes a pending save right away,
+    // call before exiting. Later saves are written synchronously.
+    void flush();
 
   private:
     std::string m_working_dir;
     std::string m_launch_path;
     std::string m_key_dir;
     std::string m_boxart_dir;
+    std::string m_host_cache_dir;
     std::string m_log_path;
     std::string m_gamepad_mapping_path;
 
+    void write_pending_saves();
+    void write_settings_file(json_t* root);
+
+    std::mutex m_save_mutex;
+    std::condition_variable m_save_requested;
+    json_t* m_pending_save = nullptr;
+    std::chrono::steady_clock::time_point m_last_save_request;
+    std::thread m_writer;
+    bool m_writer_stopped = false;
+    // Held while writing so a synchronous save and the writer never write
+    // together
+    std::mutex m_write_mutex;
+
     std::vector<Host> m_hosts;
+    std::mutex m_server_info_hints_mutex;
+    std::map<std::string, ServerInfoHint> m_server_info_hints;
+    std::mutex m_preferred_addresses_mutex;
+    // network -> host key -> address that answered first there
+    std::map<std::string, std::map<std::string, std::string>> m_preferred_addresses;
     int m_resolution = 720;
     int m_native_resolution_scale = 100;
     int m_fps = 60;
@@ -380,6 +448,13 @@ class Settings : public Singleton<Settings> {
         .buttons = {},
     };
 
+    std::string m_stun_server = "stun.moonlight-stream.org:3478";
+    int m_boxart_texture_budget_mb = 48;
+    // Controller polls per second on the input sampling thread
+    int m_input_sampling_rate = 500;
+    // Axis-only controller updates closer than this are coalesced
+    int m_input_min_send_interval_ms = 4;
+
     float m_deadzone_stick_left = 0;
     float m_deadzone_stick_right = 0;
 
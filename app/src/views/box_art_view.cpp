@@ -0,0 +1,57 @@
+//
+//  box_art_view.cpp
+//  Moonlight
+//
+
+#include "views/box_art_view.hpp"
+#include "BoxArtManager.hpp"
+#include <algorithm>
+
+BoxArtView::BoxArtView() = default;
+
+void BoxArtView::setApp(const Host& host, int appId) {
+    this->host = host;
+    this->appId = appId;
+    BoxArtManager::instance().request_texture(host, appId);
+}
+
+void BoxArtView::setImageCornerRadius(float radius) {
+    imageCornerRadius = radius;
+}
+
+void BoxArtView::draw(NVGcontext* vg, float x, float y, float width,
+                      float height, brls::Style style,
+                      brls::FrameContext* ctx) {
+    auto& manager = BoxArtManager::instance();
+
+    if (appId < 0) {
+        return;
+    }
+
+    AtlasRegion region;
+    if (!manager.texture_region(host, appId, region)) {
+        // Evicted or not decoded yet, no-op while a request is running
+        manager.request_texture(host, appId);
+        return;
+    }
+
+    // Aspect fill the tile, the pattern spans the whole atlas page so it is
+    // offset to put the tile where the view is
+    const float scale = std::max(width / float(region.width),
+                                 height / float(region.height));
+    const float left = x + (width - float(region.width) * scale) / 2;
+    const float top = y + (height - float(region.height) * scale) / 2;
+
+    NVGpaint paint = nvgImagePattern(
+        vg, left - float(region.x) * scale, top - float(region.y) * scale,
+        float(region.page_width) * scale, float(region.page_height) * scale,
+        0, region.image, getAlpha());
+    nvgBeginPath(vg);
+    nvgRoundedRect(vg, x, y, width, height, imageCornerRadius);
+    nvgFillPaint(vg, paint);
+    nvgFill(vg);
+}
+
+brls::View* BoxArtView::create() {
+    return new BoxArtView();
+}
@@ -0,0 +1,892 @@
+#include "FakeHost.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+static const size_t MAX_REQUEST_HEAD = 64 * 1024;
+static const int RTSP_PORT = 48010;
+
+// MARK: - Encoding and crypto helpers
+
+static std::string to_hex(const std::string& bytes) {
+    static const char* digits = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(bytes.size() * 2);
+    for (unsigned char byte : bytes) {
+        hex.push_back(digits[byte >> 4]);
+        hex.push_back(digits[byte & 0x0F]);
+    }
+    return hex;
+}
+
+static std::string from_hex(const std::string& hex) {
+    std::string bytes;
+    bytes.reserve(hex.size() / 2);
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        bytes.push_back((char)strtoul(hex.substr(i, 2).c_str(), nullptr, 16));
+    }
+    return bytes;
+}
+
+static std::string random_bytes(size_t size) {
+    std::string bytes(size, '\0');
+    RAND_bytes((unsigned char*)bytes.data(), (int)size);
+    return bytes;
+}
+
+static std::string digest(const EVP_MD* md, const std::string& data) {
+    unsigned char out[EVP_MAX_MD_SIZE];
+    unsigned int size = 0;
+    EVP_Digest(data.data(), data.size(), out, &size, md, nullptr);
+    return std::string((char*)out, size);
+}
+
+// Same block handling as the client: zero padded, no chaining
+static std::string aes_ecb(const std::string& key, std::string data,
+                           bool encrypt) {
+    data.resize((data.size() + 15) / 16 * 16, '\0');
+    std::string out(data.size(), '\0');
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_CipherInit_ex(ctx, EVP_aes_128_ecb(), nullptr,
+                      (const unsigned char*)key.data(), nullptr, encrypt);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    int size = 0;
+    EVP_CipherUpdate(ctx, (unsigned char*)out.data(), &size,
+                     (const unsigned char*)data.data(), (int)data.size());
+    EVP_CIPHER_CTX_free(ctx);
+    return out;
+}
+
+static std::string pem_of(X509* cert) {
+    BIO* bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, cert);
+    BUF_MEM* mem;
+    BIO_get_mem_ptr(bio, &mem);
+    std::string pem(mem->data, mem->length);
+    BIO_free(bio);
+    return pem;
+}
+
+static std::string der_of(X509* cert) {
+    unsigned char* der = nullptr;
+    int size = i2d_X509(cert, &der);
+    if (size <= 0)
+        return "";
+    std::string bytes((char*)der, size);
+    OPENSSL_free(der);
+    return bytes;
+}
+
+static X509* x509_from_pem(const std::string& pem) {
+    BIO* bio = BIO_new_mem_buf(pem.data(), (int)pem.size());
+    X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    return cert;
+}
+
+static std::string signature_of(X509* cert) {
+    const ASN1_BIT_STRING* signature;
+    X509_get0_signature(&signature, nullptr, cert);
+    return std::string((const char*)signature->data, signature->length);
+}
+
+static std::string sign(EVP_PKEY* key, const std::string& data) {
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    EVP_DigestSignInit(ctx, nullptr, EVP_sha256(), nullptr, key);
+    EVP_DigestSignUpdate(ctx, data.data(), data.size());
+    size_t size = 0;
+    EVP_DigestSignFinal(ctx, nullptr, &size);
+    std::string signature(size, '\0');
+    EVP_DigestSignFinal(ctx, (unsigned char*)signature.data(), &size);
+    signature.resize(size);
+    EVP_MD_CTX_free(ctx);
+    return signature;
+}
+
+static bool verify(X509* cert, const std::string& data,
+                   const std::string& signature) {
+    EVP_PKEY* key = X509_get_pubkey(cert);
+    if (!key)
+        return false;
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    EVP_DigestVerifyInit(ctx, nullptr, EVP_sha256(), nullptr, key);
+    EVP_DigestVerifyUpdate(ctx, data.data(), data.size());
+    int result =
+        EVP_DigestVerifyFinal(ctx, (const unsigned char*)signature.data(),
+                              signature.size());
+    EVP_MD_CTX_free(ctx);
+    EVP_PKEY_free(key);
+    return result == 1;
+}
+
+// MARK: - Box art
+
+static uint32_t crc32(const std::string& data) {
+    // Built once, before any caller reads it
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (unsigned char byte : data)
+        crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+}
+
+static void put_u32(std::string& out, uint32_t value) {
+    out.push_back((char)(value >> 24));
+    out.push_back((char)(value >> 16));
+    out.push_back((char)(value >> 8));
+    out.push_back((char)value);
+}
+
+static void put_chunk(std::string& out, const char* type,
+                      const std::string& data) {
+    put_u32(out, (uint32_t)data.size());
+    std::string body = std::string(type, 4) + data;
+    out += body;
+    put_u32(out, crc32(body));
+}
+
+// Valid PNG tinted per app, padded with a private ancillary chunk so
+// decoders skip the filler and the response reaches the scripted size
+static std::string box_art_png(int appId, size_t targetBytes) {
+    const uint32_t width = 60;
+    const uint32_t height = 80;
+
+    std::string raw;
+    for (uint32_t y = 0; y < height; y++) {
+        raw.push_back(0); // no filter
+        for (uint32_t x = 0; x < width; x++) {
+            raw.push_back((char)(appId * 47));
+            raw.push_back((char)(y * 255 / height));
+            raw.push_back((char)(x * 255 / width));
+        }
+    }
+
+    // zlib stream built from stored deflate blocks
+    std::string zlib = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+        uint16_t size = (uint16_t)std::min<size_t>(65535, raw.size() - offset);
+        zlib.push_back(offset + size == raw.size() ? 1 : 0);
+        zlib.push_back((char)(size & 0xFF));
+        zlib.push_back((char)(size >> 8));
+        zlib.push_back((char)(~size & 0xFF));
+        zlib.push_back((char)((uint16_t)~size >> 8));
+        zlib += raw.substr(offset, size);
+    }
+    put_u32(zlib, (b << 16) | a);
+
+    std::string header;
+    put_u32(header, width);
+    put_u32(header, height);
+    header += {8, 2, 0, 0, 0}; // 8 bit RGB
+
+    std::string png = "\x89PNG\r\n\x1a\n";
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib);
+
+    const size_t trailer = 12; // IEND
+    const size_t overhead = 12;
+    if (png.size() + trailer + overhead < targetBytes) {
+        put_chunk(png, "fkPd",
+                  std::string(targetBytes - png.size() - trailer - overhead,
+                              '\0'));
+    }
+    put_chunk(png, "IEND", "");
+    return png;
+}
+
+// MARK: - Responses
+
+static std::string xml(const std::string& content, int status = 200,
+                       const std::string& message = "OK") {
+    return "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+           "<root status_code=\"" +
+           std::to_string(status) + "\" status_message=\"" + message +
+           "\">" + content + "</root>";
+}
+
+static std::string tag(const std::string& name, const std::string& value) {
+    return "<" + name + ">" + value + "</" + name + ">";
+}
+
+static const char* reason(int status) {
+    switch (status) {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 401:
+        return "Unauthorized";
+    case 404:
+        return "Not Found";
+    default:
+        return "Service Unavailable";
+    }
+}
+
+static int accept_any_certificate(int, X509_STORE_CTX*) { return 1; }
+
+// MARK: - Options
+
+// "endpoint:value" with the endpoint defaulting to every endpoint
+static void parse_script(const std::string& value,
+                         std::map<std::string, int>* script) {
+    const size_t separator = value.rfind(':');
+    if (separator == std::string::npos)
+        (*script)["*"] = atoi(value.c_str());
+    else
+        (*script)[value.substr(0, separator)] =
+            atoi(value.c_str() + separator + 1);
+}
+
+bool fake_host_parse_option(const std::string& option,
+                            FakeHostConfig* config) {
+    const size_t separator = option.find('=');
+    if (option.rfind("--", 0) != 0 || separator == std::string::npos)
+        return false;
+
+    const std::string name = option.substr(2, separator - 2);
+    const std::string value = option.substr(separator + 1);
+
+    if (name == "bind")
+        config->bindAddress = value;
+    else if (name == "http-port")
+        config->httpPort = (unsigned short)atoi(value.c_str());
+    else if (name == "https-port")
+        config->httpsPort = (unsigned short)atoi(value.c_str());
+    else if (name == "pin")
+        config->pin = value;
+    else if (name == "hostname")
+        config->hostname = value;
+    else if (name == "app-version")
+        config->appVersion = value;
+    else if (name == "apps")
+        config->appCount = atoi(value.c_str());
+    else if (name == "asset-bytes")
+        config->assetBytes = (size_t)atoll(value.c_str());
+    else if (name == "latency")
+        parse_script(value, &config->latencyMs);
+    else if (name == "fail")
+        parse_script(value, &config->failures);
+    else
+        return false;
+    return true;
+}
+
+const char* fake_host_options_usage() {
+    return "  --bind=ADDRESS          listen address (127.0.0.1)\n"
+           "  --http-port=PORT        HTTP port, 0 picks one (47989)\n"
+           "  --https-port=PORT       HTTPS port, 0 picks one (47984)\n"
+           "  --pin=PIN               pairing PIN (1234)\n"
+           "  --hostname=NAME         reported hostname\n"
+           "  --app-version=VERSION   reported appversion (7.1.431.-1)\n"
+           "  --apps=COUNT            applist size (8)\n"
+           "  --asset-bytes=BYTES     box art response size (65536)\n"
+           "  --latency=[ENDPOINT:]MS delay before answering\n"
+           "  --fail=[ENDPOINT:]COUNT answer the next COUNT requests with 503\n";
+}
+
+// MARK: - FakeHost
+
+FakeHost::FakeHost(FakeHostConfig config) : m_config(std::move(config)) {}
+
+FakeHost::~FakeHost() {
+    stop();
+    if (m_ssl)
+        SSL_CTX_free(m_ssl);
+    if (m_cert)
+        X509_free(m_cert);
+    if (m_key)
+        EVP_PKEY_free(m_key);
+}
+
+bool FakeHost::createCertificate(std::string* error) {
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+    if (!ctx || EVP_PKEY_keygen_init(ctx) <= 0 ||
+        EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0 ||
+        EVP_PKEY_keygen(ctx, &m_key) <= 0) {
+        EVP_PKEY_CTX_free(ctx);
+        *error = "Unable to generate the host key";
+        return false;
+    }
+    EVP_PKEY_CTX_free(ctx);
+
+    m_cert = X509_new();
+    X509_set_version(m_cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(m_cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(m_cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(m_cert), 60L * 60 * 24 * 365 * 10);
+    X509_set_pubkey(m_cert, m_key);
+
+    X509_NAME* name = X509_get_subject_name(m_cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               (const unsigned char*)"Fake GameStream Host",
+                               -1, -1, 0);
+    X509_set_issuer_name(m_cert, name);
+
+    if (!X509_sign(m_cert, m_key, EVP_sha256())) {
+        *error = "Unable to sign the host certificate";
+        return false;
+    }
+    m_cert_pem = pem_of(m_cert);
+
+    m_ssl = SSL_CTX_new(TLS_server_method());
+    if (!m_ssl || SSL_CTX_use_certificate(m_ssl, m_cert) != 1 ||
+        SSL_CTX_use_PrivateKey(m_ssl, m_key) != 1) {
+        *error = "Unable to set up TLS";
+        return false;
+    }
+
+    // Any client certificate is accepted, pairing decides what it may do
+    SSL_CTX_set_verify(m_ssl, SSL_VERIFY_PEER, accept_any_certificate);
+    return true;
+}
+
+bool FakeHost::listen(unsigned short port, int* fd, unsigned short* boundPort,
+                      std::string* error) {
+    *fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (*fd < 0) {
+        *error = strerror(errno);
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(*fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, m_config.bindAddress.c_str(), &address.sin_addr);
+
+    if (bind(*fd, (sockaddr*)&address, sizeof(address)) != 0 ||
+        ::listen(*fd, 64) != 0) {
+        *error = "Unable to listen on port " + std::to_string(port) + ": " +
+                 strerror(errno);
+        close(*fd);
+        *fd = -1;
+        return false;
+    }
+
+    socklen_t size = sizeof(address);
+    getsockname(*fd, (sockaddr*)&address, &size);
+    *boundPort = ntohs(address.sin_port);
+    return true;
+}
+
+bool FakeHost::start(std::string* error) {
+    if (m_running)
+        return true;
+
+    // Clients hanging up mid-response must not kill the host
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!m_ssl && !createCertificate(error))
+        return false;
+
+    if (!listen(m_config.httpPort, &m_http_fd, &m_http_port, error))
+        return false;
+    if (!listen(m_config.httpsPort, &m_https_fd, &m_https_port, error)) {
+        close(m_http_fd);
+        m_http_fd = -1;
+        return false;
+    }
+
+    m_running = true;
+    m_listeners.emplace_back(&FakeHost::acceptLoop, this, m_http_fd, false);
+    m_listeners.emplace_back(&FakeHost::acceptLoop, this, m_https_fd, true);
+    return true;
+}
+
+void FakeHost::stop() {
+    if (!m_running.exchange(false))
+        return;
+
+    for (auto& listener : m_listeners)
+        listener.join();
+    m_listeners.clear();
+
+    close(m_http_fd);
+    close(m_https_fd);
+    m_http_fd = m_https_fd = -1;
+
+    std::lock_guard<std::mutex> lock(m_connections_mutex);
+    for (auto& connection : m_connections)
+        connection.thread.join();
+    m_connections.clear();
+}
+
+void FakeHost::acceptLoop(int listenFd, bool https) {
+    while (m_running) {
+        pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+
+        timeval timeout = {5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::lock_guard<std::mutex> lock(m_connections_mutex);
+        for (auto it = m_connections.begin(); it != m_connections.end();) {
+            if (*it->done) {
+                it->thread.join();
+                it = m_connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        m_connections.push_back(
+            {std::thread(&FakeHost::serve, this, fd, https, done), done});
+    }
+}
+
+void FakeHost::serve(int fd, bool https,
+                     std::shared_ptr<std::atomic<bool>> done) {
+    SSL* ssl = nullptr;
+    if (https) {
+        ssl = SSL_new(m_ssl);
+        SSL_set_fd(ssl, fd);
+        if (SSL_accept(ssl) <= 0) {
+            ERR_clear_error();
+            SSL_free(ssl);
+            close(fd);
+            *done = true;
+            return;
+        }
+    }
+
+    auto receive = [&](char* buffer, int size) {
+        return ssl ? SSL_read(ssl, buffer, size)
+                   : (int)recv(fd, buffer, size, 0);
+    };
+    auto transmit = [&](const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            int size = ssl ? SSL_write(ssl, data.data() + sent,
+                                       (int)(data.size() - sent))
+                           : (int)send(fd, data.data() + sent,
+                                       data.size() - sent, MSG_NOSIGNAL);
+            if (size <= 0)
+                return;
+            sent += size;
+        }
+    };
+
+    std::string head;
+    char buffer[4096];
+    while (head.find("\r\n\r\n") == std::string::npos &&
+           head.size() < MAX_REQUEST_HEAD) {
+        int size = receive(buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+        head.append(buffer, size);
+    }
+
+    std::istringstream line(head.substr(0, head.find("\r\n")));
+    std::string method, target;
+    line >> method >> target;
+
+    if (method == "GET" && !target.empty()) {
+        Request request;
+        request.https = https;
+
+        const size_t queryStart = target.find('?');
+        request.path = target.substr(1, queryStart == std::string::npos
+                                            ? std::string::npos
+                                            : queryStart - 1);
+        if (queryStart != std::string::npos) {
+            std::istringstream query(target.substr(queryStart + 1));
+            std::string pair;
+            while (std::getline(query, pair, '&')) {
+                const size_t separator = pair.find('=');
+                if (separator == std::string::npos)
+                    request.query[pair] = "";
+                else
+                    request.query[pair.substr(0, separator)] =
+                        pair.substr(separator + 1);
+            }
+        }
+
+        if (ssl) {
+            X509* peer = SSL_get_peer_certificate(ssl);
+            if (peer) {
+                request.clientCert = der_of(peer);
+                X509_free(peer);
+            }
+        }
+
+        Response response = handle(request);
+        transmit("HTTP/1.1 " + std::to_string(response.status) + " " +
+                 reason(response.status) +
+                 "\r\nContent-Type: " + response.contentType +
+                 "\r\nContent-Length: " +
+                 std::to_string(response.body.size()) +
+                 "\r\nConnection: close\r\n\r\n" + response.body);
+    }
+
+    if (ssl) {
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+    }
+    close(fd);
+    *done = true;
+}
+
+FakeHost::Response FakeHost::handle(const Request& request) {
+    const std::string& endpoint = request.path;
+
+    int latency = scriptedLatency(endpoint);
+    if (latency > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+
+    Response response;
+    if (scriptedFailure(endpoint)) {
+        response.status = 503;
+        response.body = xml("", 503, "Scripted failure");
+    } else if (endpoint == "serverinfo") {
+        response = serverInfo(request);
+    } else if (endpoint == "pair") {
+        response = pair(request);
+    } else if (endpoint == "unpair") {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paired.erase(request.query.count("uniqueid")
+                           ? request.query.at("uniqueid")
+                           : "");
+        response.body = xml("");
+    } else if (endpoint == "applist" || endpoint == "appasset" ||
+               endpoint == "launch" || endpoint == "resume" ||
+               endpoint == "cancel") {
+        if (!isPaired(request)) {
+            response.status = 401;
+            response.body = xml("", 401, "The client is not authorized");
+        } else if (endpoint == "applist") {
+            response = appList();
+        } else if (endpoint == "appasset") {
+            response = appAsset(request);
+        } else if (endpoint == "cancel") {
+            response = cancel();
+        } else {
+            response = launch(request, endpoint == "resume");
+        }
+    } else {
+        response.status = 404;
+        response.body = xml("", 404, "Not Found");
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& stats = m_stats[endpoint];
+    stats.requests++;
+    stats.bytes += response.body.size();
+    if (response.status != 200)
+        stats.failures++;
+    return response;
+}
+
+FakeHost::Response FakeHost::serverInfo(const Request& request) {
+    Response response;
+
+    // Like GFE, HTTPS only answers paired clients and only HTTPS reports
+    // the pairing truthfully
+    const bool paired = request.https && isPaired(request);
+    if (request.https && !paired) {
+        response.status = 401;
+        response.body = xml("", 401, "The client is not authorized");
+        return response;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    response.body = xml(
+        tag("hostname", m_config.hostname) +
+        tag("appversion", m_config.appVersion) +
+        tag("GfeVersion", m_config.gfeVersion) +
+        tag("GsVersion", m_config.appVersion) +
+        tag("uniqueid", "FAKE-HOST-0000") +
+        tag("HttpsPort", std::to_string(m_https_port)) +
+        tag("ExternalPort", std::to_string(m_http_port)) +
+        tag("mac", m_config.mac) + tag("LocalIP", m_config.bindAddress) +
+        tag("MaxLumaPixelsHEVC", "1869449984") +
+        tag("ServerCodecModeSupport", "259") +
+        tag("gputype", m_config.gpuType) +
+        tag("PairStatus", paired ? "1" : "0") +
+        tag("currentgame", std::to_string(m_current_game)) +
+        tag("state", m_current_game ? "SUNSHINE_SERVER_BUSY"
+                                    : "SUNSHINE_SERVER_FREE"));
+    return response;
+}
+
+FakeHost::Response FakeHost::pair(const Request& request) {
+    Response response;
+    auto param = [&](const char* name) {
+        auto it = request.query.find(name);
+        return it == request.query.end() ? std::string() : it->second;
+    };
+
+    const std::string uniqueId = param("uniqueid");
+
+    // Stage 5 proves the client holds the key of the paired certificate
+    if (request.https) {
+        if (param("phrase") != "pairchallenge" || !isPaired(request)) {
+            response.status = 401;
+            response.body = xml("", 401, "The client is not authorized");
+        } else {
+            response.body = xml(tag("paired", "1"));
+        }
+        return response;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (param("phrase") == "getservercert") {
+        Pairing pairing;
+        pairing.aesKey = hash(from_hex(param("salt")) + m_config.pin)
+                             .substr(0, 16);
+        pairing.clientCertPem = from_hex(param("clientcert"));
+        pairing.serverSecret = random_bytes(16);
+        m_pairings[uniqueId] = pairing;
+
+        response.body =
+            xml(tag("paired", "1") + tag("plaincert", to_hex(m_cert_pem)));
+        return response;
+    }
+
+    auto it = m_pairings.find(uniqueId);
+    if (it == m_pairings.end()) {
+        response.body = xml(tag("paired", "0"));
+        return response;
+    }
+    Pairing& pairing = it->second;
+
+    if (!param("clientchallenge").empty()) {
+        const std::string challenge =
+            aes_ecb(pairing.aesKey, from_hex(param("clientchallenge")), false)
+                .substr(0, 16);
+        pairing.serverChallenge = random_bytes(16);
+
+        const std::string serverHash =
+            hash(challenge + signature_of(m_cert) + pairing.serverSecret);
+        response.body = xml(
+            tag("paired", "1") +
+            tag("challengeresponse",
+                to_hex(aes_ecb(pairing.aesKey,
+                               serverHash + pairing.serverChallenge, true))));
+    } else if (!param("serverchallengeresp").empty()) {
+        pairing.clientHash =
+            aes_ecb(pairing.aesKey, from_hex(param("serverchallengeresp")),
+                    false)
+                .substr(0, hash("").size());
+
+        response.body = xml(
+            tag("paired", "1") +
+            tag("pairingsecret",
+                to_hex(pairing.serverSecret +
+                       sign(m_key, pairing.serverSecret))));
+    } else if (!param("clientpairingsecret").empty()) {
+        const std::string secret = from_hex(param("clientpairingsecret"));
+        const std::string clientSecret = secret.substr(0, 16);
+        const std::string clientSignature =
+            secret.size() > 16 ? secret.substr(16) : "";
+
+        bool paired = false;
+        X509* clientCert = x509_from_pem(pairing.clientCertPem);
+        if (clientCert) {
+            // A wrong PIN yields a different AES key and so a different
+            // hash than the one the client sent in stage 3
+            paired = verify(clientCert, clientSecret, clientSignature) &&
+                     hash(pairing.serverChallenge + signature_of(clientCert) +
+                          clientSecret) == pairing.clientHash;
+            if (paired)
+                m_paired[uniqueId] = der_of(clientCert);
+            X509_free(clientCert);
+        }
+
+        m_pairings.erase(it);
+        response.body = xml(tag("paired", paired ? "1" : "0"));
+    } else {
+        response.status = 400;
+        response.body = xml("", 400, "Unknown pairing stage");
+    }
+    return response;
+}
+
+FakeHost::Response FakeHost::appList() {
+    Response response;
+    std::string apps;
+    for (int i = 0; i < m_config.appCount; i++) {
+        apps += "<App>" + tag("IsHdrSupported", "0") +
+                tag("AppTitle", "Game " + std::to_string(i + 1)) +
+                tag("ID", std::to_string(1000 + i)) + "</App>";
+    }
+    response.body = xml(apps);
+    return response;
+}
+
+FakeHost::Response FakeHost::appAsset(const Request& request) {
+    Response response;
+    auto it = request.query.find("appid");
+    const int appId = it == request.query.end() ? 0 : atoi(it->second.c_str());
+    if (appId < 1000 || appId >= 1000 + m_config.appCount) {
+        response.status = 404;
+        response.body = xml("", 404, "Unknown app");
+        return response;
+    }
+
+    response.contentType = "image/png";
+    response.body = box_art_png(appId, m_config.assetBytes);
+    return response;
+}
+
+FakeHost::Response FakeHost::launch(const Request& request, bool resume) {
+    Response response;
+    const std::string sessionUrl = "rtsp://" + m_config.bindAddress + ":" +
+                                   std::to_string(RTSP_PORT);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (resume) {
+        if (m_current_game == 0) {
+            response.body = xml(tag("resume", "0"), 503, "No running app");
+        } else {
+            response.body =
+                xml(tag("resume", "1") + tag("sessionUrl0", sessionUrl));
+        }
+        return response;
+    }
+
+    auto it = request.query.find("appid");
+    const int appId = it == request.query.end() ? 0 : atoi(it->second.c_str());
+    if (appId < 1000 || appId >= 1000 + m_config.appCount) {
+        response.body = xml(tag("gamesession", "0"), 404, "Unknown app");
+    } else if (m_current_game != 0 && m_current_game != appId) {
+        response.body =
+            xml(tag("gamesession", "0"), 400, "An app is already running");
+    } else {
+        m_current_game = appId;
+        response.body = xml(tag("sessionUrl0", sessionUrl) +
+                            tag("gamesession", "1"));
+    }
+    return response;
+}
+
+FakeHost::Response FakeHost::cancel() {
+    Response response;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current_game = 0;
+    response.body = xml(tag("cancel", "1"));
+    return response;
+}
+
+bool FakeHost::isPaired(const Request& request) {
+    if (!request.https || request.clientCert.empty())
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [uniqueId, cert] : m_paired) {
+        if (cert == request.clientCert)
+            return true;
+    }
+    return false;
+}
+
+int FakeHost::scriptedLatency(const std::string& endpoint) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_config.latencyMs.find(endpoint);
+    if (it == m_config.latencyMs.end())
+        it = m_config.latencyMs.find("*");
+    return it == m_config.latencyMs.end() ? 0 : it->second;
+}
+
+bool FakeHost::scriptedFailure(const std::string& endpoint) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const std::string& key : {endpoint, std::string("*")}) {
+        auto it = m_config.failures.find(key);
+        if (it != m_config.failures.end() && it->second > 0) {
+            it->second--;
+            return true;
+        }
+    }
+    return false;
+}
+
+int FakeHost::serverMajorVersion() const {
+    return atoi(m_config.appVersion.c_str());
+}
+
+// Gen 7 hosts hash the pairing exchange with SHA256, older ones with SHA1
+std::string FakeHost::hash(const std::string& data) const {
+    return digest(serverMajorVersion() >= 7 ? EVP_sha256() : EVP_sha1(), data);
+}
+
+void FakeHost::setLatency(const std::string& endpoint, int ms) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config.latencyMs[endpoint] = ms;
+}
+
+void FakeHost::failNext(const std::string& endpoint, int count) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config.failures[endpoint] = count;
+}
+
+void FakeHost::unpairAll() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_paired.clear();
+    m_pairings.clear();
+    m_current_game = 0;
+}
+
+std::map<std::string, FakeHostEndpointStats> FakeHost::stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+FakeHostEndpointStats FakeHost::totalStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FakeHostEndpointStats total;
+    for (const auto& [endpoint, stats] : m_stats) {
+        total.requests += stats.requests;
+        total.failures += stats.failures;
+        total.bytes += stats.bytes;
+    }
+    return total;
+}
+
+void FakeHost::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.clear();
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// Local stand-in for a GameStream/Sunshine host. Answers serverinfo, the
+// full pair challenge flow with a real RSA certificate, applist, appasset,
+// launch, resume and cancel over HTTP and HTTPS on localhost.
+struct FakeHostConfig {
+    std::string bindAddress = "127.0.0.1";
+    // 0 picks a free port, see FakeHost::httpPort()
+    unsigned short httpPort = 47989;
+    unsigned short httpsPort = 47984;
+
+    std::string pin = "1234";
+    std::string hostname = "FakeHost";
+    std::string mac = "00:11:22:33:44:55";
+    // Sunshine reports a negative fourth component
+    std::string appVersion = "7.1.431.-1";
+    std::string gfeVersion = "3.23.0.74";
+    std::string gpuType = "FakeGPU";
+
+    int appCount = 8;
+    size_t assetBytes = 64 * 1024;
+
+    // Endpoint -> delay before answering, "*" applies to every endpoint
+    std::map<std::string, int> latencyMs;
+    // Endpoint -> how many of its next requests answer 503, "*" for all
+    std::map<std::string, int> failures;
+};
+
+// Applies one --name=value command line option, false when unknown
+bool fake_host_parse_option(const std::string& option, FakeHostConfig* config);
+const char* fake_host_options_usage();
+
+struct FakeHostEndpointStats {
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    uint64_t bytes = 0;
+};
+
+class FakeHost {
+  public:
+    explicit FakeHost(FakeHostConfig config);
+    ~FakeHost();
+
+    FakeHost(const FakeHost&) = delete;
+    FakeHost& operator=(const FakeHost&) = delete;
+
+    bool start(std::string* error);
+    void stop();
+
+    unsigned short httpPort() const { return m_http_port; }
+    unsigned short httpsPort() const { return m_https_port; }
+
+    // Scripts can change while the host runs
+    void setLatency(const std::string& endpoint, int ms);
+    void failNext(const std::string& endpoint, int count);
+    void unpairAll();
+
+    std::map<std::string, FakeHostEndpointStats> stats();
+    FakeHostEndpointStats totalStats();
+    void resetStats();
+
+  private:
+    struct Request {
+        bool https = false;
+        std::string path;
+        std::map<std::string, std::string> query;
+        // DER of the TLS client certificate, empty over HTTP
+        std::string clientCert;
+    };
+
+    struct Response {
+        int status = 200;
+        std::string contentType = "application/xml";
+        std::string body;
+    };
+
+    // One in-flight pairing per uniqueid
+    struct Pairing {
+        std::string aesKey;
+        std::string clientCertPem;
+        std::string serverSecret;
+        std::string serverChallenge;
+        std::string clientHash;
+    };
+
+    struct Connection {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    bool createCertificate(std::string* error);
+    bool listen(unsigned short port, int* fd, unsigned short* boundPort,
+                std::string* error);
+    void acceptLoop(int listenFd, bool https);
+    void serve(int fd, bool https, std::shared_ptr<std::atomic<bool>> done);
+
+    Response handle(const Request& request);
+    Response serverInfo(const Request& request);
+    Response pair(const Request& request);
+    Response appList();
+    Response appAsset(const Request& request);
+    Response launch(const Request& request, bool resume);
+    Response cancel();
+
+    bool isPaired(const Request& request);
+    int scriptedLatency(const std::string& endpoint);
+    bool scriptedFailure(const std::string& endpoint);
+    int serverMajorVersion() const;
+    std::string hash(const std::string& data) const;
+
+    FakeHostConfig m_config;
+    unsigned short m_http_port = 0;
+    unsigned short m_https_port = 0;
+    int m_http_fd = -1;
+    int m_https_fd = -1;
+
+    SSL_CTX* m_ssl = nullptr;
+    X509* m_cert = nullptr;
+    EVP_PKEY* m_key = nullptr;
+    std::string m_cert_pem;
+
+    std::atomic<bool> m_running = false;
+    std::vector<std::thread> m_listeners;
+    std::mutex m_connections_mutex;
+    std::list<Connection> m_connections;
+
+    std::mutex m_mutex;
+    std::map<std::string, Pairing> m_pairings;
+    // uniqueid -> DER of the paired client certificate
+    std::map<std::string, std::string> m_paired;
+    int m_current_game = 0;
+    std::map<std::string, FakeHostEndpointStats> m_stats;
+};
@@ -0,0 +1,223 @@
+// Drives the real libgamestream client against an in-process fake host and
+// reports request counts and wall-clock time per flow. With --check every
+// flow must succeed within its request budget, which is what ctest runs.
+
+#include "FakeHost.hpp"
+
+#include "CryptoManager.hpp"
+#include "Settings.hpp"
+#include "client.h"
+#include "errors.h"
+#include "http.h"
+#include <borealis/core/logger.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct Phase {
+    std::string name;
+    int budget = 0;
+    uint64_t requests = 0;
+    uint64_t hostRequests = 0;
+    uint64_t bytes = 0;
+    double milliseconds = 0;
+    bool ok = false;
+};
+
+static bool is_png(const Data& data) {
+    return data.size() > 8 && memcmp(data.bytes(), "\x89PNG", 4) == 0;
+}
+
+int main(int argc, char** argv) {
+    FakeHostConfig config;
+    config.httpPort = 0;
+    config.httpsPort = 0;
+
+    bool check = false;
+    int iterations = 3;
+    for (int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+        if (option == "--check") {
+            check = true;
+        } else if (option == "--verbose") {
+            brls::Logger::enabled = true;
+        } else if (option.rfind("--iterations=", 0) == 0) {
+            iterations = std::max(1, atoi(option.c_str() + 13));
+        } else if (!fake_host_parse_option(option, &config)) {
+            fprintf(stderr,
+                    "Usage: %s [--check] [--verbose] [--iterations=N] "
+                    "[host options]\n%s",
+                    argv[0], fake_host_options_usage());
+            return option == "--help" ? 0 : 2;
+        }
+    }
+
+    char keyDir[] = "/tmp/gamestream-bench-XXXXXX";
+    if (!mkdtemp(keyDir)) {
+        fprintf(stderr, "Unable to create a key directory\n");
+        return 1;
+    }
+    Settings::instance().set_key_dir(keyDir);
+
+    FakeHost host(config);
+    std::string error;
+    if (!host.start(&error)) {
+        fprintf(stderr, "Unable to start the fake host: %s\n", error.c_str());
+        return 1;
+    }
+
+    const std::string address = "127.0.0.1:" + std::to_string(host.httpPort());
+    std::vector<Phase> phases;
+
+    auto measure = [&](const std::string& name, int budget,
+                       const std::function<bool()>& flow) {
+        Phase phase;
+        phase.name = name;
+        phase.budget = budget;
+
+        const HTTPStats before = http_stats();
+        const uint64_t hostBefore = host.totalStats().requests;
+        const auto startedAt = std::chrono::steady_clock::now();
+
+        const bool succeeded = flow();
+
+        phase.milliseconds =
+            std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - startedAt)
+                .count();
+        const HTTPStats after = http_stats();
+        phase.requests = after.requests - before.requests;
+        phase.bytes = after.bytes - before.bytes;
+        phase.hostRequests = host.totalStats().requests - hostBefore;
+        phase.ok = succeeded && phase.requests <= (uint64_t)budget &&
+                   phase.requests == phase.hostRequests;
+        phases.push_back(phase);
+    };
+
+    SERVER_DATA server;
+    char goodPin[16];
+    char badPin[16];
+    snprintf(goodPin, sizeof(goodPin), "%s", config.pin.c_str());
+    snprintf(badPin, sizeof(badPin), "%s", config.pin == "0000" ? "1111" : "0000");
+
+    // Unknown host: HTTP for the version, HTTPS refused until paired
+    measure("discovery", 2, [&] {
+        return gs_init(&server, address) == GS_OK && !server.paired;
+    });
+
+    // All five stages run, stage 5 is refused and the client unpairs
+    measure("pair wrong pin", 6, [&] {
+        return gs_pair(&server, badPin) != GS_OK && !server.paired;
+    });
+
+    measure("pair", 5, [&] { return gs_pair(&server, goodPin) == GS_OK; });
+
+    // Known paired host: one HTTPS serverinfo per connect
+    measure("connect", iterations, [&] {
+        for (int i = 0; i < iterations; i++) {
+            if (gs_init(&server, address) != GS_OK || !server.paired)
+                return false;
+        }
+        return true;
+    });
+
+    measure("applist", iterations, [&] {
+        for (int i = 0; i < iterations; i++) {
+            PAPP_LIST list = nullptr;
+            if (gs_applist(&server, &list) != GS_OK)
+                return false;
+
+            int count = 0;
+            while (list) {
+                PAPP_LIST next = list->next;
+                free(list->name);
+                free(list);
+                list = next;
+                count++;
+            }
+            if (count != config.appCount)
+                return false;
+        }
+        return true;
+    });
+
+    measure("appasset", config.appCount, [&] {
+        for (int i = 0; i < config.appCount; i++) {
+            Data boxArt;
+            if (gs_app_boxart(&server, 1000 + i, &boxArt) != GS_OK ||
+                !is_png(boxArt))
+                return false;
+        }
+        return true;
+    });
+
+    STREAM_CONFIGURATION stream = {};
+    stream.width = 1280;
+    stream.height = 720;
+    stream.fps = 60;
+    stream.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+
+    auto startApp = [&](int appId) {
+        const bool started =
+            gs_start_app(&server, &stream, appId, false, false, 1) == GS_OK &&
+            server.serverInfo.rtspSessionUrl != nullptr;
+        delete[] server.serverInfo.rtspSessionUrl;
+        server.serverInfo.rtspSessionUrl = nullptr;
+        return started;
+    };
+
+    measure("launch", 1, [&] {
+        server.currentGame = 0;
+        return startApp(1000) && server.currentGame == 1000;
+    });
+
+    // currentGame is set, so the client resumes instead of launching
+    measure("resume", 1, [&] { return startApp(1000); });
+
+    measure("cancel", 1, [&] { return gs_quit_app(&server) == GS_OK; });
+
+    // A refused HTTPS probe falls back to HTTP
+    measure("connect https failure", 2, [&] {
+        host.failNext("serverinfo", 1);
+        return gs_init(&server, address) == GS_OK;
+    });
+
+    measure("applist failure", 1, [&] {
+        host.failNext("applist", 1);
+        PAPP_LIST list = nullptr;
+        return gs_applist(&server, &list) == GS_IO_ERROR;
+    });
+
+    host.stop();
+
+    remove((std::string(keyDir) + "/" + CERTIFICATE_FILE_NAME).c_str());
+    remove((std::string(keyDir) + "/" + KEY_FILE_NAME).c_str());
+    rmdir(keyDir);
+
+    bool passed = true;
+    printf("%-22s %8s %8s %8s %10s %10s  %s\n", "flow", "requests", "budget",
+           "host", "bytes", "ms", "result");
+    for (const Phase& phase : phases) {
+        printf("%-22s %8llu %8d %8llu %10llu %10.2f  %s\n", phase.name.c_str(),
+               (unsigned long long)phase.requests, phase.budget,
+               (unsigned long long)phase.hostRequests,
+               (unsigned long long)phase.bytes, phase.milliseconds,
+               phase.ok ? "ok" : "FAILED");
+        passed = passed && phase.ok;
+    }
+
+    const HTTPStats total = http_stats();
+    printf("total: %llu requests, %llu failed, %llu bytes, %.2f ms in "
+           "requests\n",
+           (unsigned long long)total.requests,
+           (unsigned long long)total.failures,
+           (unsigned long long)total.bytes, total.microseconds / 1000.0);
+
+    return check && !passed ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+// Runs the per-poll controller mapping of the app (packButtons, mapButtons
+// and the whole state mapping) over generated controller states and reports
+// the time per poll. With --check the mapping results are verified first,
+// which is what ctest runs.
+
+#include "ControllerMapping.hpp"
+#include "Limelight.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t bit(int button) { return uint64_t(1) << button; }
+
+struct Flag {
+    int flag;
+    brls::ControllerButton button;
+};
+
+// What the app compiles for the default layout off the Switch
+constexpr Flag FLAGS[] = {
+    {UP_FLAG, brls::BUTTON_UP},       {DOWN_FLAG, brls::BUTTON_DOWN},
+    {LEFT_FLAG, brls::BUTTON_LEFT},   {RIGHT_FLAG, brls::BUTTON_RIGHT},
+    {A_FLAG, brls::BUTTON_A},         {B_FLAG, brls::BUTTON_B},
+    {X_FLAG, brls::BUTTON_X},         {Y_FLAG, brls::BUTTON_Y},
+    {BACK_FLAG, brls::BUTTON_BACK},   {PLAY_FLAG, brls::BUTTON_START},
+    {LB_FLAG, brls::BUTTON_LB},       {RB_FLAG, brls::BUTTON_RB},
+    {LS_CLK_FLAG, brls::BUTTON_LSB},  {RS_CLK_FLAG, brls::BUTTON_RSB},
+};
+
+// Every physical button raises the mapped button `layout` gives it
+CompiledInputMapping compile(const std::vector<int>& layout) {
+    CompiledInputMapping mapping;
+    for (int i = 0; i < brls::_BUTTON_MAX; i++) {
+        const int target = layout[i];
+        mapping.buttonTargets[i] = bit(target);
+        for (const auto& flag : FLAGS) {
+            if (flag.button == target)
+                mapping.buttonFlags[i] |= flag.flag;
+        }
+    }
+    mapping.leftStickDeadzone = 0.2f;
+    mapping.rightStickDeadzone = 0.2f;
+    return mapping;
+}
+
+std::vector<int> identity_layout() {
+    std::vector<int> layout(brls::_BUTTON_MAX);
+    for (int i = 0; i < brls::_BUTTON_MAX; i++)
+        layout[i] = i;
+    return layout;
+}
+
+brls::ControllerState pressed(std::initializer_list<brls::ControllerButton> buttons) {
+    brls::ControllerState state = {};
+    for (auto button : buttons)
+        state.buttons[button] = true;
+    return state;
+}
+
+int failures = 0;
+
+void expect(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+void check() {
+    const auto identity = compile(identity_layout());
+
+    auto state = pressed({brls::BUTTON_A, brls::BUTTON_UP});
+    expect(ControllerMapping::packButtons(state) ==
+               (bit(brls::BUTTON_A) | bit(brls::BUTTON_UP)),
+           "packButtons sets one bit per pressed button");
+
+    auto gamepad = ControllerMapping::mapState(state, identity, false, false);
+    expect(gamepad.buttonFlags == (A_FLAG | UP_FLAG),
+           "pressed buttons raise their Limelight flags");
+
+    auto swapped = identity_layout();
+    std::swap(swapped[brls::BUTTON_A], swapped[brls::BUTTON_B]);
+    int flags = 0;
+    const uint64_t mapped = ControllerMapping::mapButtons(
+        bit(brls::BUTTON_A), compile(swapped), flags);
+    expect(mapped == bit(brls::BUTTON_B) && flags == B_FLAG,
+           "a remapped button raises its target");
+
+    state = {};
+    state.axes[brls::LEFT_X] = 0.1f;
+    state.axes[brls::LEFT_Y] = 0.1f;
+    state.axes[brls::RIGHT_X] = 0.5f;
+    gamepad = ControllerMapping::mapState(state, identity, false, false);
+    expect(gamepad.leftStickX == 0 && gamepad.leftStickY == 0,
+           "sticks inside the deadzone are centered");
+    expect(gamepad.rightStickX == short(0x7FFF * 0.5f),
+           "sticks outside the deadzone pass through");
+
+    state = pressed({brls::BUTTON_LT});
+    gamepad = ControllerMapping::mapState(state, identity, false, false);
+    expect(gamepad.leftTrigger == 0xFF,
+           "a trigger without an axis is read from its button");
+
+    state.axes[brls::LEFT_X] = 1;
+    gamepad = ControllerMapping::mapState(state, identity, true, false);
+    expect(gamepad.leftTrigger == 0 && gamepad.leftStickX == 0,
+           "the special key holds back triggers and sticks");
+
+    auto guide = identity;
+    guide.guideCombo = bit(brls::BUTTON_START) | bit(brls::BUTTON_BACK);
+    state = pressed({brls::BUTTON_START, brls::BUTTON_BACK, brls::BUTTON_A});
+    gamepad = ControllerMapping::mapState(state, guide, false, false);
+    expect(gamepad.buttonFlags == SPECIAL_FLAG,
+           "the guide combo sends only guide");
+
+    state = pressed({brls::BUTTON_A});
+    gamepad = ControllerMapping::mapState(state, guide, false, true);
+    expect(gamepad.buttonFlags == 0,
+           "buttons stay released in the poll after guide");
+}
+
+struct Result {
+    std::string name;
+    double nanoseconds = 0;
+};
+
+Result measure(const std::string& name, int polls,
+               const std::function<uint64_t(int)>& poll) {
+    // The sum keeps the compiler from dropping the work
+    uint64_t sum = 0;
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < polls; i++)
+        sum += poll(i);
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+
+    static volatile uint64_t sink;
+    sink = sum;
+    return {name,
+            std::chrono::duration<double, std::nano>(elapsed).count() / polls};
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool checking = false;
+    int polls = 1000000;
+    for (int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+        if (option == "--check") {
+            checking = true;
+        } else if (option.rfind("--polls=", 0) == 0) {
+            polls = std::max(1, atoi(option.c_str() + 8));
+        } else {
+            fprintf(stderr, "Usage: %s [--check] [--polls=N]\n", argv[0]);
+            return option == "--help" ? 0 : 2;
+        }
+    }
+
+    if (checking) {
+        check();
+        if (failures > 0)
+            return 1;
+    }
+
+    // A few held buttons and moving sticks, like a controller mid game
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> axis(-1, 1);
+    std::vector<brls::ControllerState> states(1024);
+    for (auto& state : states) {
+        state = {};
+        for (int i = 0; i < 3; i++)
+            state.buttons[random() % brls::BUTTON_NAV_UP] = true;
+        for (float& value : state.axes)
+            value = axis(random);
+        state.axes[brls::LEFT_Z] = std::abs(state.axes[brls::LEFT_Z]);
+        state.axes[brls::RIGHT_Z] = std::abs(state.axes[brls::RIGHT_Z]);
+    }
+
+    auto mapping = compile(identity_layout());
+    mapping.guideCombo = bit(brls::BUTTON_START) | bit(brls::BUTTON_BACK);
+    const size_t mask = states.size() - 1;
+
+    const Result results[] = {
+        measure("packButtons", polls,
+                [&](int i) {
+                    return ControllerMapping::packButtons(states[i & mask]);
+                }),
+        measure("mapButtons", polls,
+                [&](int i) {
+                    int flags = 0;
+                    return ControllerMapping::mapButtons(
+                               ControllerMapping::packButtons(states[i & mask]),
+                               mapping, flags) +
+                           flags;
+                }),
+        measure("controller state", polls,
+                [&](int i) {
+                    const auto state = ControllerMapping::mapState(
+                        states[i & mask], mapping, false, false);
+                    return uint64_t(uint16_t(state.buttonFlags)) +
+                           uint64_t(uint16_t(state.leftStickX));
+                }),
+    };
+
+    printf("%-18s %10s\n", "step", "ns/poll");
+    for (const auto& result : results)
+        printf("%-18s %10.2f\n", result.name.c_str(), result.nanoseconds);
+    printf("%d polls\n", polls);
+    return 0;
+}
@@ -0,0 +1,52 @@
+// Runs the fake GameStream host until interrupted, so Moonlight can add
+// 127.0.0.1 as a host and pair with the configured PIN.
+
+#include "FakeHost.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void on_signal(int) { interrupted = 1; }
+
+int main(int argc, char** argv) {
+    FakeHostConfig config;
+    for (int i = 1; i < argc; i++) {
+        if (!fake_host_parse_option(argv[i], &config)) {
+            fprintf(stderr, "Usage: %s [options]\n%s", argv[0],
+                    fake_host_options_usage());
+            return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    FakeHost host(config);
+    std::string error;
+    if (!host.start(&error)) {
+        fprintf(stderr, "Unable to start: %s\n", error.c_str());
+        return 1;
+    }
+
+    printf("Fake host '%s' on %s, http %u, https %u, PIN %s\n",
+           config.hostname.c_str(), config.bindAddress.c_str(),
+           host.httpPort(), host.httpsPort(), config.pin.c_str());
+    fflush(stdout);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    while (!interrupted)
+        pause();
+
+    host.stop();
+
+    printf("\n%-12s %10s %10s %12s\n", "endpoint", "requests", "failures",
+           "bytes");
+    for (const auto& [endpoint, stats] : host.stats()) {
+        printf("%-12s %10llu %10llu %12llu\n", endpoint.c_str(),
+               (unsigned long long)stats.requests,
+               (unsigned long long)stats.failures,
+               (unsigned long long)stats.bytes);
+    }
+    return 0;
+}
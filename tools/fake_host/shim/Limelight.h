@@ -0,0 +1,59 @@
+#pragma once
+
+// Subset of moonlight-common-c's Limelight.h that libgamestream and the
+// controller mapping use, the benchmarks never stream so the rest of the
+// library is not linked
+
+#include <cstring>
+
+typedef struct _SERVER_INFORMATION {
+    const char* address;
+    const char* serverInfoAppVersion;
+    const char* serverInfoGfeVersion;
+    const char* rtspSessionUrl;
+    int serverCodecModeSupport;
+} SERVER_INFORMATION, *PSERVER_INFORMATION;
+
+#define MAKE_AUDIO_CONFIGURATION(channelCount, channelMask)                    \
+    (((channelMask) << 16) | (channelCount << 8) | 0xCA)
+#define AUDIO_CONFIGURATION_STEREO MAKE_AUDIO_CONFIGURATION(2, 0x3)
+
+typedef struct _STREAM_CONFIGURATION {
+    int width;
+    int height;
+    int fps;
+    int bitrate;
+    int packetSize;
+    int streamingRemotely;
+    int audioConfiguration;
+    int supportedVideoFormats;
+    int clientRefreshRateX100;
+    int colorSpace;
+    int colorRange;
+    int encryptionFlags;
+    char remoteInputAesKey[16];
+    char remoteInputAesIv[16];
+} STREAM_CONFIGURATION, *PSTREAM_CONFIGURATION;
+
+// Gamepad button flags
+#define UP_FLAG 0x0001
+#define DOWN_FLAG 0x0002
+#define LEFT_FLAG 0x0004
+#define RIGHT_FLAG 0x0008
+#define PLAY_FLAG 0x0010
+#define BACK_FLAG 0x0020
+#define LS_CLK_FLAG 0x0040
+#define RS_CLK_FLAG 0x0080
+#define LB_FLAG 0x0100
+#define RB_FLAG 0x0200
+#define SPECIAL_FLAG 0x0400
+#define A_FLAG 0x1000
+#define B_FLAG 0x2000
+#define X_FLAG 0x4000
+#define Y_FLAG 0x8000
+
+inline void LiInitializeServerInformation(PSERVER_INFORMATION serverInfo) {
+    memset(serverInfo, 0, sizeof(*serverInfo));
+}
+
+inline const char* LiGetLaunchUrlQueryParameters() { return "&corever=1"; }
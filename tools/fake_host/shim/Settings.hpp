@@ -0,0 +1,55 @@
+#pragma once
+
+// Stand-in for app/src/utils/Settings.hpp with only what libgamestream and
+// the crypto managers use, so the benchmark links without the UI
+
+#include <map>
+#include <mutex>
+#include <string>
+
+struct ServerInfoHint {
+    unsigned short https_port = 0;
+    bool paired = false;
+    bool https = false;
+
+    bool operator==(const ServerInfoHint& other) const {
+        return https_port == other.https_port && paired == other.paired &&
+               https == other.https;
+    }
+};
+
+class Settings {
+  public:
+    static Settings& instance() {
+        static Settings settings;
+        return settings;
+    }
+
+    std::string key_dir() const { return m_key_dir; }
+    void set_key_dir(const std::string& key_dir) { m_key_dir = key_dir; }
+
+    bool server_info_hint(const std::string& address, ServerInfoHint* hint) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_server_info_hints.find(address);
+        if (it == m_server_info_hints.end())
+            return false;
+        *hint = it->second;
+        return true;
+    }
+
+    void set_server_info_hint(const std::string& address,
+                              const ServerInfoHint& hint) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_server_info_hints[address] = hint;
+    }
+
+    void clear_server_info_hints() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_server_info_hints.clear();
+    }
+
+  private:
+    std::string m_key_dir = ".";
+    std::mutex m_mutex;
+    std::map<std::string, ServerInfoHint> m_server_info_hints;
+};
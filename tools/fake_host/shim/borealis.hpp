@@ -0,0 +1,4 @@
+#pragma once
+
+#include <borealis/core/input.hpp>
+#include <borealis/core/logger.hpp>
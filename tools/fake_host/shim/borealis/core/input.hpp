@@ -0,0 +1,48 @@
+#pragma once
+
+// Stand-in for the controller types of borealis's input manager, in the
+// same order so button bits match the app
+
+namespace brls {
+
+enum ControllerButton {
+    BUTTON_LT = 0,
+    BUTTON_LB,
+    BUTTON_LSB,
+    BUTTON_UP,
+    BUTTON_RIGHT,
+    BUTTON_DOWN,
+    BUTTON_LEFT,
+    BUTTON_BACK,
+    BUTTON_GUIDE,
+    BUTTON_START,
+    BUTTON_RSB,
+    BUTTON_Y,
+    BUTTON_B,
+    BUTTON_A,
+    BUTTON_X,
+    BUTTON_RB,
+    BUTTON_RT,
+    BUTTON_NAV_UP,
+    BUTTON_NAV_RIGHT,
+    BUTTON_NAV_DOWN,
+    BUTTON_NAV_LEFT,
+    _BUTTON_MAX,
+};
+
+enum ControllerAxis {
+    LEFT_X,
+    LEFT_Y,
+    RIGHT_X,
+    RIGHT_Y,
+    LEFT_Z,
+    RIGHT_Z,
+    _AXES_MAX,
+};
+
+struct ControllerState {
+    bool buttons[_BUTTON_MAX];
+    float axes[_AXES_MAX];
+};
+
+} // namespace brls
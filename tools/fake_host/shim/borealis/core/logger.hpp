@@ -0,0 +1,61 @@
+#pragma once
+
+// Stand-in for the borealis logger, silent unless enabled
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+namespace brls {
+
+class Logger {
+  public:
+    static inline bool enabled = false;
+
+    template <typename... Args>
+    static void debug(const std::string& format, Args&&... args) {
+        log("DEBUG", format, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    static void info(const std::string& format, Args&&... args) {
+        log("INFO", format, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    static void warning(const std::string& format, Args&&... args) {
+        log("WARNING", format, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    static void error(const std::string& format, Args&&... args) {
+        log("ERROR", format, std::forward<Args>(args)...);
+    }
+
+  private:
+    template <typename... Args>
+    static void log(const char* level, const std::string& format,
+                    Args&&... args) {
+        if (!enabled)
+            return;
+
+        std::ostringstream out;
+        size_t position = 0;
+        (append(out, format, position, args), ...);
+        out << format.substr(position);
+        fprintf(stderr, "[%s] %s\n", level, out.str().c_str());
+    }
+
+    // Replaces the next {} after `position` with `arg`
+    template <typename Arg>
+    static void append(std::ostringstream& out, const std::string& format,
+                       size_t& position, const Arg& arg) {
+        size_t placeholder = format.find("{}", position);
+        if (placeholder == std::string::npos)
+            return;
+        out << format.substr(position, placeholder - position) << arg;
+        position = placeholder + 2;
+    }
+};
+
+} // namespace brls
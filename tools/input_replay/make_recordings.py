@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+# Writes the checked-in input recordings in the format of InputRecorder
+# (app/src/streaming/InputRecorder.cpp), so the sessions can be read and
+# changed here instead of being re-recorded on a device. Run it from any
+# directory; the .golden files next to the recordings are kept by hand.
+
+import os
+import struct
+
+RECORDING_MAGIC = 0x524C4D49  # "IMLR"
+RECORDING_VERSION = 1
+
+# brls::ControllerButton and brls::ControllerAxis
+BUTTONS = [
+    "LT", "LB", "LSB", "UP", "RIGHT", "DOWN", "LEFT", "BACK", "GUIDE",
+    "START", "RSB", "Y", "B", "A", "X", "RB", "RT",
+    "NAV_UP", "NAV_RIGHT", "NAV_DOWN", "NAV_LEFT",
+]
+AXES = ["LEFT_X", "LEFT_Y", "RIGHT_X", "RIGHT_Y", "LEFT_Z", "RIGHT_Z"]
+
+
+def controller(buttons=(), **axes):
+    data = bytes(1 if name in buttons else 0 for name in BUTTONS)
+    return data + b"".join(struct.pack("<f", axes.get(name, 0.0)) for name in AXES)
+
+
+def frame(time_ms, buttons=(), **axes):
+    state = controller(buttons, **axes)
+    data = struct.pack("<QBff", time_ms * 1000, 0, 1280.0, 720.0)
+    # One controller, the unified state is the same
+    data += struct.pack("<I", 1) + state + state
+    # No mouse buttons, touches or events
+    data += struct.pack("<BBBiII", 0, 0, 0, 0, 0, 0)
+    return data
+
+
+def write(name, frames):
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+    with open(path, "wb") as file:
+        file.write(struct.pack("<IIII", RECORDING_MAGIC, RECORDING_VERSION,
+                               len(BUTTONS), len(AXES)))
+        for data in frames:
+            file.write(data)
+
+
+# Button edges, stick and trigger moves, an axis move inside the minimum send
+# interval, and the guide button, with the default settings
+write("controller_basic.input", [
+    frame(0),
+    frame(16, ["A"]),
+    frame(32, ["A"], LEFT_X=0.5, LEFT_Y=0.25),
+    frame(34, ["A"], LEFT_X=0.75, LEFT_Y=0.25),
+    frame(48, [], LEFT_X=0.75, LEFT_Y=0.25),
+    frame(64, [], RIGHT_Z=1.0),
+    frame(80),
+    frame(96, ["GUIDE"]),
+    frame(112, ["A"]),
+    frame(128, ["A"]),
+    frame(144),
+])
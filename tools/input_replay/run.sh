@@ -0,0 +1,46 @@
+#!/bin/sh
+# Replays every recording in this directory that has a .golden file with
+# `<moonlight> --replay-input=<recording>` and fails when the emitted LiSend*
+# stream differs from it.
+#
+#   tools/input_replay/run.sh build/Moonlight
+#
+# Replays run against a fresh home directory, so the default settings are in
+# effect, and in a scratch copy, so the .events and .timing files written
+# next to the recording stay out of the tree. The app opens its window, a
+# display (or xvfb-run) is needed. Goldens are those of desktop builds, the
+# Switch maps A/B and X/Y the other way around.
+
+set -u
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 <moonlight executable>" >&2
+    exit 2
+fi
+
+executable=$1
+source_dir=$(cd "$(dirname "$0")" && pwd)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+
+failed=0
+for golden in "$source_dir"/*.golden; do
+    recording=${golden%.golden}
+    name=$(basename "$recording")
+    mkdir -p "$scratch/home"
+    cp "$recording" "$golden" "$scratch/"
+
+    if HOME="$scratch/home" XDG_CONFIG_HOME="$scratch/home" \
+        "$executable" --replay-input="$scratch/$name" >"$scratch/$name.log" 2>&1; then
+        echo "ok: $name"
+    else
+        echo "FAILED: $name" >&2
+        grep "InputReplay" "$scratch/$name.log" >&2
+        if [ -f "$scratch/$name.events" ]; then
+            diff "$golden" "$scratch/$name.events" >&2
+        fi
+        failed=1
+    fi
+done
+
+exit $failed